@@ -213,7 +213,9 @@ bool AssertiveDisplay::prepare(hwc_context_t *ctx,
     hwc_rect_t dst = crop; //input same as output
 
     if(configMdp(ctx->mOverlay, parg, OVERLAY_TRANSFORM_0, crop, dst, NULL,
-                dest) < 0) {
+                dest) < 0 ||
+            !ctx->mOverlay->validateAndSet(overlay::Overlay::DPY_WRITEBACK,
+                wb->getFbFd())) {
         ALOGE("%s: configMdp failed", __func__);
         mDoable = false;
         return false;
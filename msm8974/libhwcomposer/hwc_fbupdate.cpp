@@ -43,6 +43,13 @@ inline void IFBUpdate::reset() {
     mModeOn = false;
 }
 
+bool IFBUpdate::prepareAndValidate(hwc_context_t *ctx,
+        hwc_display_contents_1 *list, int fbZorder) {
+    mModeOn = prepare(ctx, list, fbZorder) &&
+            ctx->mOverlay->validateAndSet(mDpy, ctx->dpyAttr[mDpy].fd);
+    return mModeOn;
+}
+
 //================= Low res====================================
 FBUpdateLowRes::FBUpdateLowRes(const int& dpy): IFBUpdate(dpy) {}
 
@@ -36,6 +36,9 @@ public:
     // Sets up members and prepares overlay if conditions are met
     virtual bool prepare(hwc_context_t *ctx, hwc_display_contents_1 *list,
                                                        int fbZorder) = 0;
+    // Prepares and validates the display's pipes, when FB is the only client
+    bool prepareAndValidate(hwc_context_t *ctx, hwc_display_contents_1 *list,
+            int fbZorder);
     // Draws layer
     virtual bool draw(hwc_context_t *ctx, private_handle_t *hnd) = 0;
     //Reset values
@@ -883,8 +883,9 @@ int MDPComp::prepare(hwc_context_t *ctx, hwc_display_contents_1_t* list) {
                 return -1;
             }
         }
-        //Acquire and Program MDP pipes
-        if(!programMDP(ctx, list)) {
+        //Acquire and Program MDP pipes, then validate the whole frame
+        if(!programMDP(ctx, list) ||
+                !ctx->mOverlay->validateAndSet(mDpy, ctx->dpyAttr[mDpy].fd)) {
             reset(numLayers, list);
             return -1;
         } else { //Success
@@ -919,7 +920,8 @@ int MDPComp::prepare(hwc_context_t *ctx, hwc_display_contents_1_t* list) {
                 return -1;
             }
         }
-        if(!programYUV(ctx, list)) {
+        if(!programYUV(ctx, list) ||
+                !ctx->mOverlay->validateAndSet(mDpy, ctx->dpyAttr[mDpy].fd)) {
             reset(numLayers, list);
             return -1;
         }
@@ -44,6 +44,13 @@
 #include "overlayUtils.h"
 #include <utils/Trace.h>
 
+/* Kernels exposing MSMFB_OVERLAY_PREPARE can validate and set all pipes of a
+ * display in one shot. Pipe configs are then batched per display instead of
+ * issuing MSMFB_OVERLAY_SET for every pipe. */
+#ifdef MSMFB_OVERLAY_PREPARE
+#define MDP_BATCHED_PREPARE
+#endif
+
 namespace overlay{
 
 namespace mdp_wrapper{
@@ -65,6 +72,11 @@ bool rotate(int fd, msm_rotator_data_info& rot);
 /* MSMFB_OVERLAY_SET */
 bool setOverlay(int fd, mdp_overlay& ov);
 
+#ifdef MDP_BATCHED_PREPARE
+/* MSMFB_OVERLAY_PREPARE */
+int validateAndSet(const int& fd, mdp_overlay_list& list);
+#endif
+
 /* MSM_ROTATOR_IOCTL_FINISH */
 bool endRotator(int fd, int sessionId);
 
@@ -175,6 +187,19 @@ inline bool setOverlay(int fd, mdp_overlay& ov) {
     return true;
 }
 
+#ifdef MDP_BATCHED_PREPARE
+inline int validateAndSet(const int& fd, mdp_overlay_list& list) {
+    ATRACE_CALL();
+    if (ioctl(fd, MSMFB_OVERLAY_PREPARE, &list) < 0) {
+        int err = errno;
+        ALOGD("Failed to call ioctl MSMFB_OVERLAY_PREPARE err=%s",
+                strerror(err));
+        return err;
+    }
+    return 0;
+}
+#endif
+
 inline bool endRotator(int fd, uint32_t sessionId) {
     ATRACE_CALL();
     if (ioctl(fd, MSM_ROTATOR_IOCTL_FINISH, &sessionId) < 0) {
@@ -158,6 +158,34 @@ bool Overlay::commit(utils::eDest dest) {
     return ret;
 }
 
+bool Overlay::validateAndSet(const int& dpy, const int& fbFd) {
+    GenericPipe* pipeArray[PipeBook::NUM_PIPES];
+    memset(pipeArray, 0, sizeof(GenericPipe*)*(PipeBook::NUM_PIPES));
+
+    int num = 0;
+    for(int i = 0; i < PipeBook::NUM_PIPES; i++) {
+        if(PipeBook::isUsed(i) && mPipeBook[i].valid() &&
+                mPipeBook[i].mDisplay == dpy) {
+            pipeArray[num++] = mPipeBook[i].mPipe;
+        }
+    }
+
+    //Protect against misbehaving clients
+    if(!num || GenericPipe::validateAndSet(pipeArray, num, fbFd)) {
+        return true;
+    }
+
+    //Pipes are left as they were programmed last, just release them for
+    //this round without forcing a reconfig.
+    for(int i = 0; i < PipeBook::NUM_PIPES; i++) {
+        if (mPipeBook[i].mDisplay == dpy) {
+            PipeBook::resetAllocation(i);
+            PipeBook::resetUse(i);
+        }
+    }
+    return false;
+}
+
 bool Overlay::queueBuffer(int fd, uint32_t offset,
         utils::eDest dest) {
     int index = (int)dest;
@@ -81,6 +81,12 @@ public:
     void setVisualParams(const MetaData_t& data, utils::eDest dest);
     bool commit(utils::eDest dest);
     bool queueBuffer(int fd, uint32_t offset, utils::eDest dest);
+    /* Validates and sets all pipes committed for the display in one shot.
+     * Must be called after all commit()s for the display in a drawing round.
+     * On failure the pipes keep their last good known config and are released
+     * for this round, so that a fallback can reuse them.
+     */
+    bool validateAndSet(const int& dpy, const int& fbFd);
 
     /* Returns available ("unallocated") pipes for a display's mixer */
     int availablePipes(int dpy, int mixer);
@@ -87,6 +87,8 @@ public:
     void getDump(char *buf, size_t len);
     void forceSet();
 
+    static bool validateAndSet(Ctrl* ctrlArray[], const int& count,
+            const int& fbFd);
 private:
     // mdp ctrl struct(info e.g.)
     MdpCtrl mMdp;
@@ -209,6 +211,18 @@ inline void Ctrl::updateSrcFormat(const uint32_t& rotDstFmt) {
     mMdp.updateSrcFormat(rotDstFmt);
 }
 
+inline bool Ctrl::validateAndSet(Ctrl* ctrlArray[], const int& count,
+        const int& fbFd) {
+    MdpCtrl* mdpCtrlArray[count];
+    memset(&mdpCtrlArray, 0, sizeof(mdpCtrlArray));
+
+    for(int i = 0; i < count; i++) {
+        mdpCtrlArray[i] = &ctrlArray[i]->mMdp;
+    }
+
+    return MdpCtrl::validateAndSet(mdpCtrlArray, count, fbFd);
+}
+
 inline utils::Dim Ctrl::getCrop() const {
     return mMdp.getSrcRectDim();
 }
@@ -163,6 +163,7 @@ bool MdpCtrl::set() {
 
     doDownscale();
 
+#ifndef MDP_BATCHED_PREPARE
     if(this->ovChanged() || mForceSet) {
         mForceSet = false;
         if(!mdp_wrapper::setOverlay(mFd.getFD(), mOVInfo)) {
@@ -175,6 +176,7 @@ bool MdpCtrl::set() {
         }
         this->save();
     }
+#endif
 
     return true;
 }
@@ -190,6 +192,57 @@ bool MdpCtrl::get() {
     return true;
 }
 
+bool MdpCtrl::validateAndSet(MdpCtrl* mdpCtrlArray[], const int& count,
+        const int& fbFd) {
+#ifdef MDP_BATCHED_PREPARE
+    mdp_overlay* ovArray[count];
+    memset(&ovArray, 0, sizeof(ovArray));
+
+    // The driver validates the frame as a whole and treats pipes missing from
+    // the list as unused, so every pipe of the display has to be sent even if
+    // its config did not change since the last round.
+    for(int i = 0; i < count; i++) {
+        ovArray[i] = &mdpCtrlArray[i]->mOVInfo;
+    }
+
+    struct mdp_overlay_list list;
+    memset(&list, 0, sizeof(struct mdp_overlay_list));
+    list.num_overlays = count;
+    list.overlay_list = ovArray;
+
+    // Error value is based on file errno-base.h
+    // 0 - indicates no error.
+    int errVal = mdp_wrapper::validateAndSet(fbFd, list);
+    if(errVal) {
+        /* No dump for failure due to insufficient resource */
+        if(errVal != E2BIG && list.processed_overlays < list.num_overlays) {
+            mdp_wrapper::dump("Bad ov dump: ",
+                *list.overlay_list[list.processed_overlays]);
+        }
+        for(int i = 0; i < count; i++) {
+            if(static_cast<ssize_t>(mdpCtrlArray[i]->mLkgo.id) ==
+                    MSMFB_NEW_REQUEST) {
+                // Driver releases pipes newly allocated by a failed prepare
+                mdpCtrlArray[i]->mOVInfo.id = MSMFB_NEW_REQUEST;
+            } else {
+                mdpCtrlArray[i]->restore();
+            }
+        }
+        return false;
+    }
+
+    for(int i = 0; i < count; i++) {
+        mdpCtrlArray[i]->mForceSet = false;
+        mdpCtrlArray[i]->save();
+    }
+#else
+    (void) mdpCtrlArray;
+    (void) count;
+    (void) fbFd;
+#endif
+    return true;
+}
+
 //Update src format based on rotator's destination format.
 void MdpCtrl::updateSrcFormat(const uint32_t& rotDestFmt) {
     utils::Whf whf = getSrcWhf();
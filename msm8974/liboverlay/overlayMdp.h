@@ -48,7 +48,8 @@ public:
     /* calls overlay set
      * Set would always consult last good known ov instance.
      * Only if it is different, set would actually exectue ioctl.
-     * On a sucess ioctl. last good known ov instance is updated */
+     * On a sucess ioctl. last good known ov instance is updated.
+     * With MDP_BATCHED_PREPARE the ioctl is deferred to validateAndSet */
     bool set();
     /* Sets the source total width, height, format */
     void setSource(const utils::PipeArgs& pargs);
@@ -83,6 +84,11 @@ public:
     bool setVisualParams(const MetaData_t& data);
     void forceSet();
 
+    /* Validates and sets all changed ctrls in one MSMFB_OVERLAY_PREPARE.
+     * On failure every ctrl is restored to its last good known ov */
+    static bool validateAndSet(MdpCtrl* mdpCtrlArray[], const int& count,
+            const int& fbFd);
+
 private:
     /* Perform transformation calculations */
     void doTransform();
@@ -176,4 +176,20 @@ void GenericPipe::forceSet() {
     mCtrlData.ctrl.forceSet();
 }
 
+bool GenericPipe::validateAndSet(GenericPipe* pipeArray[], const int& count,
+        const int& fbFd) {
+    Ctrl* ctrlArray[count];
+    memset(&ctrlArray, 0, sizeof(ctrlArray));
+
+    for(int i = 0; i < count; i++) {
+        ctrlArray[i] = &pipeArray[i]->mCtrlData.ctrl;
+    }
+
+    bool ret = Ctrl::validateAndSet(ctrlArray, count, fbFd);
+    for(int i = 0; i < count; i++) {
+        pipeArray[i]->pipeState = ret ? OPEN : CLOSED;
+    }
+    return ret;
+}
+
 } //namespace overlay
@@ -78,6 +78,10 @@ public:
      */
     void forceSet();
 
+    /* Validates and sets the ctrl of all pipes in one shot */
+    static bool validateAndSet(GenericPipe* pipeArray[], const int& count,
+            const int& fbFd);
+
 private:
     /* set Closed pipe */
     bool setClosed();
@@ -82,12 +82,7 @@ namespace android {
 void HWC2On1Adapter::DisplayContentsDeleter::operator()(
         hwc_display_contents_1_t* contents)
 {
-    if (contents != nullptr) {
-        for (size_t l = 0; l < contents->numHwLayers; ++l) {
-            auto& layer = contents->hwLayers[l];
-            std::free(const_cast<hwc_rect_t*>(layer.visibleRegionScreen.rects));
-        }
-    }
+    // Regions point into layer or display storage and are not owned here
     std::free(contents);
 }
 
@@ -554,8 +549,13 @@ HWC2On1Adapter::Display::Display(HWC2On1Adapter& device, HWC2::DisplayType type)
     mStateMutex(),
     mZIsDirty(false),
     mHwc1RequestedContents(nullptr),
+    mHwc1RequestedCapacity(0),
     mHwc1ReceivedContents(nullptr),
+    mHwc1ReceivedCapacity(0),
+    mHasReceivedContents(false),
+    mFramebufferTargetRect(),
     mRetireFence(),
+    mHasChanges(false),
     mChanges(),
     mHwc1Id(-1),
     mConfigs(),
@@ -575,23 +575,28 @@ Error HWC2On1Adapter::Display::acceptChanges()
 {
     std::unique_lock<std::recursive_mutex> lock(mStateMutex);
 
-    if (!mChanges) {
+    if (!mHasChanges) {
         ALOGV("[%" PRIu64 "] acceptChanges failed, not validated", mId);
         return Error::NotValidated;
     }
 
     ALOGV("[%" PRIu64 "] acceptChanges", mId);
 
-    for (auto& change : mChanges->getTypeChanges()) {
+    for (auto& change : mChanges.getTypeChanges()) {
         auto layerId = change.first;
         auto type = change.second;
-        auto layer = mDevice.mLayers[layerId];
-        layer->setCompositionType(type);
+        auto layer = mDevice.mLayers.find(layerId);
+        if (layer != mDevice.mLayers.end()) {
+            layer->second->setCompositionType(type);
+        }
     }
 
-    mChanges->clearTypeChanges();
+    mChanges.clearTypeChanges();
 
-    mHwc1RequestedContents = std::move(mHwc1ReceivedContents);
+    // Keep the old requested buffer around as the next received buffer
+    std::swap(mHwc1RequestedContents, mHwc1ReceivedContents);
+    std::swap(mHwc1RequestedCapacity, mHwc1ReceivedCapacity);
+    mHasReceivedContents = false;
 
     return Error::None;
 }
@@ -619,6 +624,21 @@ Error HWC2On1Adapter::Display::destroyLayer(hwc2_layer_t layerId)
     }
     const auto layer = mapLayer->second;
     mDevice.mLayers.erase(mapLayer);
+
+    // The HWC1 contents and layer map refer to this layer without owning it,
+    // so drop those references until the next prepare reassigns the ids
+    auto hwc1Id = layer->getHwc1Id();
+    if (hwc1Id < mHwc1LayerMap.size() &&
+            mHwc1LayerMap[hwc1Id] == layer.get()) {
+        mHwc1LayerMap[hwc1Id] = nullptr;
+        for (auto contents : {mHwc1RequestedContents.get(),
+                mHwc1ReceivedContents.get()}) {
+            if (contents != nullptr && hwc1Id < contents->numHwLayers) {
+                contents->hwLayers[hwc1Id].visibleRegionScreen = {0, nullptr};
+            }
+        }
+    }
+
     const auto zRange = mLayers.equal_range(layer);
     for (auto current = zRange.first; current != zRange.second; ++current) {
         if (**current == *layer) {
@@ -666,19 +686,19 @@ Error HWC2On1Adapter::Display::getChangedCompositionTypes(
 {
     std::unique_lock<std::recursive_mutex> lock(mStateMutex);
 
-    if (!mChanges) {
+    if (!mHasChanges) {
         ALOGE("[%" PRIu64 "] getChangedCompositionTypes failed: not validated",
                 mId);
         return Error::NotValidated;
     }
 
     if ((outLayers == nullptr) || (outTypes == nullptr)) {
-        *outNumElements = mChanges->getTypeChanges().size();
+        *outNumElements = mChanges.getTypeChanges().size();
         return Error::None;
     }
 
     uint32_t numWritten = 0;
-    for (const auto& element : mChanges->getTypeChanges()) {
+    for (const auto& element : mChanges.getTypeChanges()) {
         if (numWritten == *outNumElements) {
             break;
         }
@@ -778,11 +798,11 @@ Error HWC2On1Adapter::Display::getReleaseFences(uint32_t* outNumElements,
             break;
         }
 
-        auto releaseFence = layer->getReleaseFence();
-        if (releaseFence != Fence::NO_FENCE) {
+        const auto& releaseFence = layer->getReleaseFence();
+        if (releaseFence.isValid()) {
             if (outputsNonNull) {
                 outLayers[numWritten] = layer->getId();
-                outFences[numWritten] = releaseFence->dup();
+                outFences[numWritten] = releaseFence.dup();
             }
             ++numWritten;
         }
@@ -798,18 +818,18 @@ Error HWC2On1Adapter::Display::getRequests(int32_t* outDisplayRequests,
 {
     std::unique_lock<std::recursive_mutex> lock(mStateMutex);
 
-    if (!mChanges) {
+    if (!mHasChanges) {
         return Error::NotValidated;
     }
 
     if (outLayers == nullptr || outLayerRequests == nullptr) {
-        *outNumElements = mChanges->getNumLayerRequests();
+        *outNumElements = mChanges.getNumLayerRequests();
         return Error::None;
     }
 
-    *outDisplayRequests = mChanges->getDisplayRequests();
+    *outDisplayRequests = mChanges.getDisplayRequests();
     uint32_t numWritten = 0;
-    for (const auto& request : mChanges->getLayerRequests()) {
+    for (const auto& request : mChanges.getLayerRequests()) {
         if (numWritten == *outNumElements) {
             break;
         }
@@ -833,7 +853,7 @@ Error HWC2On1Adapter::Display::present(int32_t* outRetireFence)
 {
     std::unique_lock<std::recursive_mutex> lock(mStateMutex);
 
-    if (mChanges) {
+    if (mHasChanges) {
         Error error = mDevice.setAllDisplays();
         if (error != Error::None) {
             ALOGE("[%" PRIu64 "] present: setAllDisplaysFailed (%s)", mId,
@@ -842,7 +862,7 @@ Error HWC2On1Adapter::Display::present(int32_t* outRetireFence)
         }
     }
 
-    *outRetireFence = mRetireFence.get()->dup();
+    *outRetireFence = mRetireFence.dup();
     ALOGV("[%" PRIu64 "] present returning retire fence %d", mId,
             *outRetireFence);
 
@@ -1030,17 +1050,17 @@ Error HWC2On1Adapter::Display::validate(uint32_t* outNumTypes,
 
     ALOGV("[%" PRIu64 "] Entering validate", mId);
 
-    if (!mChanges) {
+    if (!mHasChanges) {
         if (!mDevice.prepareAllDisplays()) {
             return Error::BadDisplay;
         }
     }
 
-    *outNumTypes = mChanges->getNumTypes();
-    *outNumRequests = mChanges->getNumLayerRequests();
+    *outNumTypes = mChanges.getNumTypes();
+    *outNumRequests = mChanges.getNumLayerRequests();
     ALOGV("[%" PRIu64 "] validate --> %u types, %u requests", mId, *outNumTypes,
             *outNumRequests);
-    for (auto request : mChanges->getTypeChanges()) {
+    for (const auto& request : mChanges.getTypeChanges()) {
         ALOGV("Layer %" PRIu64 " --> %s", request.first,
                 to_string(request.second).c_str());
     }
@@ -1300,44 +1320,35 @@ bool HWC2On1Adapter::Display::prepare()
     return true;
 }
 
-static void cloneHWCRegion(hwc_region_t& region)
-{
-    auto size = sizeof(hwc_rect_t) * region.numRects;
-    auto newRects = static_cast<hwc_rect_t*>(std::malloc(size));
-    std::copy_n(region.rects, region.numRects, newRects);
-    region.rects = newRects;
-}
-
-HWC2On1Adapter::Display::HWC1Contents
-        HWC2On1Adapter::Display::cloneRequestedContents() const
+hwc_display_contents_1_t* HWC2On1Adapter::Display::cloneRequestedContents()
 {
     std::unique_lock<std::recursive_mutex> lock(mStateMutex);
 
+    // The regions are shared with the requested contents rather than deep
+    // copied, since neither buffer owns them
+    auto numLayers = mHwc1RequestedContents->numHwLayers;
+    reserveHwc1Contents(mHwc1ReceivedContents, mHwc1ReceivedCapacity,
+            numLayers);
     size_t size = sizeof(hwc_display_contents_1_t) +
-            sizeof(hwc_layer_1_t) * (mHwc1RequestedContents->numHwLayers);
-    auto contents = static_cast<hwc_display_contents_1_t*>(std::malloc(size));
-    std::memcpy(contents, mHwc1RequestedContents.get(), size);
-    for (size_t layerId = 0; layerId < contents->numHwLayers; ++layerId) {
-        auto& layer = contents->hwLayers[layerId];
-        // Deep copy the regions to avoid double-frees
-        cloneHWCRegion(layer.visibleRegionScreen);
-        cloneHWCRegion(layer.surfaceDamage);
-    }
-    return HWC1Contents(contents);
+            sizeof(hwc_layer_1_t) * numLayers;
+    std::memcpy(mHwc1ReceivedContents.get(), mHwc1RequestedContents.get(),
+            size);
+    mHasReceivedContents = true;
+    return mHwc1ReceivedContents.get();
 }
 
-void HWC2On1Adapter::Display::setReceivedContents(HWC1Contents contents)
+void HWC2On1Adapter::Display::setReceivedContents()
 {
     std::unique_lock<std::recursive_mutex> lock(mStateMutex);
 
-    mHwc1ReceivedContents = std::move(contents);
-
-    mChanges.reset(new Changes);
+    mChanges.clear();
+    mHasChanges = true;
 
     size_t numLayers = mHwc1ReceivedContents->numHwLayers;
     for (size_t hwc1Id = 0; hwc1Id < numLayers; ++hwc1Id) {
         const auto& receivedLayer = mHwc1ReceivedContents->hwLayers[hwc1Id];
-        if (mHwc1LayerMap.count(hwc1Id) == 0) {
+        if (hwc1Id >= mHwc1LayerMap.size() ||
+                mHwc1LayerMap[hwc1Id] == nullptr) {
             ALOGE_IF(receivedLayer.compositionType != HWC_FRAMEBUFFER_TARGET,
                     "setReceivedContents: HWC1 layer %zd doesn't have a"
                     " matching HWC2 layer, and isn't the framebuffer target",
@@ -1354,14 +1365,14 @@ void HWC2On1Adapter::Display::setReceivedContents(HWC1Contents contents)
 bool HWC2On1Adapter::Display::hasChanges() const
 {
     std::unique_lock<std::recursive_mutex> lock(mStateMutex);
-    return mChanges != nullptr;
+    return mHasChanges;
 }
 
 Error HWC2On1Adapter::Display::set(hwc_display_contents_1& hwcContents)
 {
     std::unique_lock<std::recursive_mutex> lock(mStateMutex);
 
-    if (!mChanges || (mChanges->getNumTypes() > 0)) {
+    if (!mHasChanges || (mChanges.getNumTypes() > 0)) {
         ALOGE("[%" PRIu64 "] set failed: not validated", mId);
         return Error::NotValidated;
     }
@@ -1389,7 +1400,7 @@ Error HWC2On1Adapter::Display::set(hwc_display_contents_1& hwcContents)
                 mId);
     }
 
-    mChanges.reset();
+    mHasChanges = false;
 
     return Error::None;
 }
@@ -1408,7 +1419,8 @@ void HWC2On1Adapter::Display::addReleaseFences(
     size_t numLayers = hwcContents.numHwLayers;
     for (size_t hwc1Id = 0; hwc1Id < numLayers; ++hwc1Id) {
         const auto& receivedLayer = hwcContents.hwLayers[hwc1Id];
-        if (mHwc1LayerMap.count(hwc1Id) == 0) {
+        if (hwc1Id >= mHwc1LayerMap.size() ||
+                mHwc1LayerMap[hwc1Id] == nullptr) {
             if (receivedLayer.compositionType != HWC_FRAMEBUFFER_TARGET) {
                 ALOGE("addReleaseFences: HWC1 layer %zd doesn't have a"
                         " matching HWC2 layer, and isn't the framebuffer"
@@ -1653,7 +1665,7 @@ std::string HWC2On1Adapter::Display::dump() const
         output << "    Output buffer: " << mOutputBuffer.getBuffer() << '\n';
     }
 
-    if (mHwc1ReceivedContents) {
+    if (mHasReceivedContents) {
         output << "    Last received HWC1 state\n";
         output << to_string(*mHwc1ReceivedContents, mDevice.mHwc1MinorVersion);
     } else if (mHwc1RequestedContents) {
@@ -1866,26 +1878,41 @@ void HWC2On1Adapter::Display::initializeActiveConfig()
     }
 }
 
+void HWC2On1Adapter::Display::reserveHwc1Contents(HWC1Contents& contents,
+        size_t& capacity, size_t numLayers)
+{
+    if (contents && capacity >= numLayers) {
+        return;
+    }
+
+    // Round up so that a few layers coming and going doesn't reallocate
+    capacity = std::max(numLayers, capacity + capacity / 2);
+    size_t size = sizeof(hwc_display_contents_1_t) +
+            sizeof(hwc_layer_1_t) * capacity;
+    contents.reset(
+            static_cast<hwc_display_contents_1_t*>(std::calloc(size, 1)));
+}
+
 void HWC2On1Adapter::Display::reallocateHwc1Contents()
 {
     // Allocate an additional layer for the framebuffer target
     auto numLayers = mLayers.size() + 1;
-    size_t size = sizeof(hwc_display_contents_1_t) +
-            sizeof(hwc_layer_1_t) * numLayers;
-    ALOGV("[%" PRIu64 "] reallocateHwc1Contents creating %zd layer%s", mId,
+    ALOGV("[%" PRIu64 "] reallocateHwc1Contents using %zd layer%s", mId,
             numLayers, numLayers != 1 ? "s" : "");
-    auto contents =
-            static_cast<hwc_display_contents_1_t*>(std::calloc(size, 1));
+    reserveHwc1Contents(mHwc1RequestedContents, mHwc1RequestedCapacity,
+            numLayers);
+    auto contents = mHwc1RequestedContents.get();
+    std::memset(contents, 0, sizeof(hwc_display_contents_1_t) +
+            sizeof(hwc_layer_1_t) * numLayers);
     contents->numHwLayers = numLayers;
-    mHwc1RequestedContents.reset(contents);
 }
 
 void HWC2On1Adapter::Display::assignHwc1LayerIds()
 {
-    mHwc1LayerMap.clear();
+    mHwc1LayerMap.resize(mLayers.size());
     size_t nextHwc1Id = 0;
     for (auto& layer : mLayers) {
-        mHwc1LayerMap[nextHwc1Id] = layer;
+        mHwc1LayerMap[nextHwc1Id] = layer.get();
         layer->setHwc1Id(nextHwc1Id++);
     }
 }
@@ -1956,13 +1983,9 @@ void HWC2On1Adapter::Display::prepareFramebufferTarget()
     }
     hwc1Target.displayFrame = {0, 0, width, height};
     hwc1Target.planeAlpha = 255;
+    mFramebufferTargetRect = {0, 0, width, height};
     hwc1Target.visibleRegionScreen.numRects = 1;
-    auto rects = static_cast<hwc_rect_t*>(std::malloc(sizeof(hwc_rect_t)));
-    rects[0].left = 0;
-    rects[0].top = 0;
-    rects[0].right = width;
-    rects[0].bottom = height;
-    hwc1Target.visibleRegionScreen.rects = rects;
+    hwc1Target.visibleRegionScreen.rects = &mFramebufferTargetRect;
 
     // We will set this to the correct value in set
     hwc1Target.acquireFenceFd = -1;
@@ -1978,6 +2001,7 @@ HWC2On1Adapter::Layer::Layer(Display& display)
     mDirtyCount(0),
     mBuffer(),
     mSurfaceDamage(),
+    mVisibleRegionScratch(),
     mBlendMode(*this, BlendMode::None),
     mColor(*this, {0, 0, 0, 0}),
     mCompositionType(*this, Composition::Invalid),
@@ -2089,9 +2113,9 @@ Error HWC2On1Adapter::Layer::setTransform(Transform transform)
 
 Error HWC2On1Adapter::Layer::setVisibleRegion(hwc_region_t rawVisible)
 {
-    std::vector<hwc_rect_t> visible(rawVisible.rects,
+    mVisibleRegionScratch.assign(rawVisible.rects,
             rawVisible.rects + rawVisible.numRects);
-    mVisibleRegion.setPending(std::move(visible));
+    mVisibleRegion.setPending(mVisibleRegionScratch);
     return Error::None;
 }
 
@@ -2107,9 +2131,10 @@ void HWC2On1Adapter::Layer::addReleaseFence(int fenceFd)
     mReleaseFence.add(fenceFd);
 }
 
-const sp<Fence>& HWC2On1Adapter::Layer::getReleaseFence() const
+const HWC2On1Adapter::DeferredFence&
+        HWC2On1Adapter::Layer::getReleaseFence() const
 {
-    return mReleaseFence.get();
+    return mReleaseFence;
 }
 
 void HWC2On1Adapter::Layer::applyState(hwc_layer_1_t& hwc1Layer,
@@ -2244,17 +2269,13 @@ void HWC2On1Adapter::Layer::applyCommonState(hwc_layer_1_t& hwc1Layer,
         mTransform.latch();
     }
     if (applyAllState || mVisibleRegion.isDirty()) {
-        auto& hwc1VisibleRegion = hwc1Layer.visibleRegionScreen;
-
-        std::free(const_cast<hwc_rect_t*>(hwc1VisibleRegion.rects));
-
-        auto pending = mVisibleRegion.getPendingValue();
-        hwc_rect_t* newRects = static_cast<hwc_rect_t*>(
-                std::malloc(sizeof(hwc_rect_t) * pending.size()));
-        std::copy(pending.begin(), pending.end(), newRects);
-        hwc1VisibleRegion.rects = const_cast<const hwc_rect_t*>(newRects);
-        hwc1VisibleRegion.numRects = pending.size();
+        // Point HWC1 straight at the latched rects, which stay put until the
+        // next time the visible region is latched
         mVisibleRegion.latch();
+        auto& hwc1VisibleRegion = hwc1Layer.visibleRegionScreen;
+        const auto& visible = mVisibleRegion.getValue();
+        hwc1VisibleRegion.rects = visible.data();
+        hwc1VisibleRegion.numRects = visible.size();
     }
 }
 
@@ -2425,24 +2446,22 @@ bool HWC2On1Adapter::prepareAllDisplays()
         return false;
     }
 
-    // Always push the primary display
-    std::vector<HWC2On1Adapter::Display::HWC1Contents> requestedContents;
+    // Always push the primary display. mHwc1Contents keeps its capacity, so
+    // this doesn't allocate after the first frame.
+    mHwc1Contents.clear();
     auto primaryDisplayId = mHwc1DisplayMap[HWC_DISPLAY_PRIMARY];
     auto& primaryDisplay = mDisplays[primaryDisplayId];
-    auto primaryDisplayContents = primaryDisplay->cloneRequestedContents();
-    requestedContents.push_back(std::move(primaryDisplayContents));
+    mHwc1Contents.push_back(primaryDisplay->cloneRequestedContents());
 
     // Push the external display, if present
     if (mHwc1DisplayMap.count(HWC_DISPLAY_EXTERNAL) != 0) {
         auto externalDisplayId = mHwc1DisplayMap[HWC_DISPLAY_EXTERNAL];
         auto& externalDisplay = mDisplays[externalDisplayId];
-        auto externalDisplayContents =
-                externalDisplay->cloneRequestedContents();
-        requestedContents.push_back(std::move(externalDisplayContents));
+        mHwc1Contents.push_back(externalDisplay->cloneRequestedContents());
     } else {
         // Even if an external display isn't present, we still need to send
         // at least two displays down to HWC1
-        requestedContents.push_back(nullptr);
+        mHwc1Contents.push_back(nullptr);
     }
 
     // Push the hardware virtual display, if supported and present
@@ -2450,22 +2469,19 @@ bool HWC2On1Adapter::prepareAllDisplays()
         if (mHwc1DisplayMap.count(HWC_DISPLAY_VIRTUAL) != 0) {
             auto virtualDisplayId = mHwc1DisplayMap[HWC_DISPLAY_VIRTUAL];
             auto& virtualDisplay = mDisplays[virtualDisplayId];
-            auto virtualDisplayContents =
-                    virtualDisplay->cloneRequestedContents();
-            requestedContents.push_back(std::move(virtualDisplayContents));
+            mHwc1Contents.push_back(virtualDisplay->cloneRequestedContents());
         } else {
-            requestedContents.push_back(nullptr);
+            mHwc1Contents.push_back(nullptr);
         }
     }
 
-    mHwc1Contents.clear();
-    for (auto& displayContents : requestedContents) {
-        mHwc1Contents.push_back(displayContents.get());
+    for (size_t c = 0; c < mHwc1Contents.size(); ++c) {
+        auto& displayContents = mHwc1Contents[c];
         if (!displayContents) {
             continue;
         }
 
-        ALOGV("Display %zd layers:", mHwc1Contents.size() - 1);
+        ALOGV("Display %zd layers:", c);
         for (size_t l = 0; l < displayContents->numHwLayers; ++l) {
             auto& layer = displayContents->hwLayers[l];
             ALOGV("  %zd: %d", l, layer.compositionType);
@@ -2490,7 +2506,7 @@ bool HWC2On1Adapter::prepareAllDisplays()
         }
     }
 
-    // Return the received contents to their respective displays
+    // Let each display pick up what HWC1 changed in its received contents
     for (size_t hwc1Id = 0; hwc1Id < mHwc1Contents.size(); ++hwc1Id) {
         if (mHwc1Contents[hwc1Id] == nullptr) {
             continue;
@@ -2498,7 +2514,7 @@ bool HWC2On1Adapter::prepareAllDisplays()
 
         auto displayId = mHwc1DisplayMap[hwc1Id];
         auto& display = mDisplays[displayId];
-        display->setReceivedContents(std::move(requestedContents[hwc1Id]));
+        display->setReceivedContents();
     }
 
     return true;
@@ -23,13 +23,13 @@
 #undef HWC2_INCLUDE_STRINGIFICATION
 #undef HWC2_USE_CPP11
 
-#include <ui/Fence.h>
+#include <unistd.h>
 
 #include <atomic>
 #include <map>
 #include <mutex>
-#include <queue>
 #include <set>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -131,39 +131,57 @@ private:
             void operator()(struct hwc_display_contents_1* contents);
     };
 
+    // Fences are kept as raw fds rather than sp<Fence> so that handing them
+    // over every frame does not allocate
+
     class DeferredFence {
         public:
             DeferredFence()
-              : mMutex(),
-                mFences({Fence::NO_FENCE, Fence::NO_FENCE}) {}
+              : mFences{-1, -1} {}
+            DeferredFence(const DeferredFence&) = delete;
+            ~DeferredFence() {
+                for (auto fenceFd : mFences) {
+                    if (fenceFd >= 0) {
+                        close(fenceFd);
+                    }
+                }
+            }
 
             void add(int32_t fenceFd) {
-                mFences.emplace(new Fence(fenceFd));
-                mFences.pop();
+                if (mFences[0] >= 0) {
+                    close(mFences[0]);
+                }
+                mFences[0] = mFences[1];
+                mFences[1] = fenceFd;
             }
 
-            const sp<Fence>& get() const {
-                return mFences.front();
-            }
+            bool isValid() const { return mFences[0] >= 0; }
+            int dup() const { return isValid() ? ::dup(mFences[0]) : -1; }
 
         private:
-            mutable std::mutex mMutex;
-            std::queue<sp<Fence>> mFences;
+            int mFences[2];
     };
 
     class FencedBuffer {
         public:
-            FencedBuffer() : mBuffer(nullptr), mFence(Fence::NO_FENCE) {}
+            FencedBuffer() : mBuffer(nullptr), mFence(-1) {}
+            FencedBuffer(const FencedBuffer&) = delete;
+            ~FencedBuffer() { setFence(-1); }
 
             void setBuffer(buffer_handle_t buffer) { mBuffer = buffer; }
-            void setFence(int fenceFd) { mFence = new Fence(fenceFd); }
+            void setFence(int fenceFd) {
+                if (mFence >= 0) {
+                    close(mFence);
+                }
+                mFence = fenceFd;
+            }
 
             buffer_handle_t getBuffer() const { return mBuffer; }
-            int getFence() const { return mFence->dup(); }
+            int getFence() const { return mFence >= 0 ? dup(mFence) : -1; }
 
         private:
             buffer_handle_t mBuffer;
-            sp<Fence> mFence;
+            int mFence;
     };
 
     class Display {
@@ -231,8 +249,10 @@ private:
             void populateConfigs(uint32_t width, uint32_t height);
 
             bool prepare();
-            HWC1Contents cloneRequestedContents() const;
-            void setReceivedContents(HWC1Contents contents);
+            // Copies the requested contents into the received buffer, which
+            // is what gets handed to HWC1 prepare and set
+            hwc_display_contents_1* cloneRequestedContents();
+            void setReceivedContents();
             bool hasChanges() const;
             HWC2::Error set(hwc_display_contents_1& hwcContents);
             void addRetireFence(int fenceFd);
@@ -286,6 +306,8 @@ private:
                     std::unordered_map<android_color_mode_t, uint32_t> mHwc1Ids;
             };
 
+            // Backed by vectors that are cleared rather than freed, so a
+            // steady-state validate does not allocate
             class Changes {
                 public:
                     uint32_t getNumTypes() const {
@@ -296,42 +318,44 @@ private:
                         return static_cast<uint32_t>(mLayerRequests.size());
                     }
 
-                    const std::unordered_map<hwc2_layer_t, HWC2::Composition>&
-                            getTypeChanges() const {
+                    const std::vector<std::pair<hwc2_layer_t,
+                            HWC2::Composition>>& getTypeChanges() const {
                         return mTypeChanges;
                     }
 
-                    const std::unordered_map<hwc2_layer_t, HWC2::LayerRequest>&
-                            getLayerRequests() const {
+                    const std::vector<std::pair<hwc2_layer_t,
+                            HWC2::LayerRequest>>& getLayerRequests() const {
                         return mLayerRequests;
                     }
 
                     int32_t getDisplayRequests() const {
-                        int32_t requests = 0;
-                        for (auto request : mDisplayRequests) {
-                            requests |= static_cast<int32_t>(request);
-                        }
-                        return requests;
+                        return mDisplayRequests;
                     }
 
                     void addTypeChange(hwc2_layer_t layerId,
                             HWC2::Composition type) {
-                        mTypeChanges.insert({layerId, type});
+                        mTypeChanges.emplace_back(layerId, type);
                     }
 
                     void clearTypeChanges() { mTypeChanges.clear(); }
 
                     void addLayerRequest(hwc2_layer_t layerId,
                             HWC2::LayerRequest request) {
-                        mLayerRequests.insert({layerId, request});
+                        mLayerRequests.emplace_back(layerId, request);
+                    }
+
+                    void clear() {
+                        mTypeChanges.clear();
+                        mLayerRequests.clear();
+                        mDisplayRequests = 0;
                     }
 
                 private:
-                    std::unordered_map<hwc2_layer_t, HWC2::Composition>
+                    std::vector<std::pair<hwc2_layer_t, HWC2::Composition>>
                             mTypeChanges;
-                    std::unordered_map<hwc2_layer_t, HWC2::LayerRequest>
+                    std::vector<std::pair<hwc2_layer_t, HWC2::LayerRequest>>
                             mLayerRequests;
-                    std::unordered_set<HWC2::DisplayRequest> mDisplayRequests;
+                    int32_t mDisplayRequests = 0;
             };
 
             std::shared_ptr<const Config>
@@ -340,6 +364,8 @@ private:
             void populateColorModes();
             void initializeActiveConfig();
 
+            static void reserveHwc1Contents(HWC1Contents& contents,
+                    size_t& capacity, size_t numLayers);
             void reallocateHwc1Contents();
             void assignHwc1LayerIds();
 
@@ -368,13 +394,22 @@ private:
             mutable std::recursive_mutex mStateMutex;
 
             bool mZIsDirty;
+
+            // Both buffers only ever grow, and are swapped rather than freed
+            // when changes are accepted. Visible regions point into the
+            // layers' own storage, so neither buffer owns any rects.
             HWC1Contents mHwc1RequestedContents;
+            size_t mHwc1RequestedCapacity;
             HWC1Contents mHwc1ReceivedContents;
+            size_t mHwc1ReceivedCapacity;
+            bool mHasReceivedContents;
+            hwc_rect_t mFramebufferTargetRect;
             DeferredFence mRetireFence;
 
-            // Will only be non-null after the layer has been validated but
-            // before it has been presented
-            std::unique_ptr<Changes> mChanges;
+            // Only valid after the display has been validated but before it
+            // has been presented
+            bool mHasChanges;
+            Changes mChanges;
 
             int32_t mHwc1Id;
 
@@ -393,7 +428,8 @@ private:
             bool mHasColorTransform;
 
             std::multiset<std::shared_ptr<Layer>, SortLayersByZ> mLayers;
-            std::unordered_map<size_t, std::shared_ptr<Layer>> mHwc1LayerMap;
+            // Indexed by HWC1 layer id, the framebuffer target has no entry
+            std::vector<Layer*> mHwc1LayerMap;
     };
 
     template <typename ...Args>
@@ -464,7 +500,7 @@ private:
                 mPendingValue(initialValue),
                 mValue(initialValue) {}
 
-            void setPending(T value) {
+            void setPending(const T& value) {
                 if (value == mPendingValue) {
                     return;
                 }
@@ -476,8 +512,8 @@ private:
                 mPendingValue = value;
             }
 
-            T getValue() const { return mValue; }
-            T getPendingValue() const { return mPendingValue; }
+            const T& getValue() const { return mValue; }
+            const T& getPendingValue() const { return mPendingValue; }
 
             bool isDirty() const { return mPendingValue != mValue; }
 
@@ -532,7 +568,7 @@ private:
             uint32_t getZ() const { return mZ; }
 
             void addReleaseFence(int fenceFd);
-            const sp<Fence>& getReleaseFence() const;
+            const DeferredFence& getReleaseFence() const;
 
             void setHwc1Id(size_t id) { mHwc1Id = id; }
             size_t getHwc1Id() const { return mHwc1Id; }
@@ -559,6 +595,8 @@ private:
 
             FencedBuffer mBuffer;
             std::vector<hwc_rect_t> mSurfaceDamage;
+            // Staging storage for setVisibleRegion, reused across frames
+            std::vector<hwc_rect_t> mVisibleRegionScratch;
 
             LatchedState<HWC2::BlendMode> mBlendMode;
             LatchedState<hwc_color_t> mColor;
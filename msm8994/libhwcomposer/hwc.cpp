@@ -774,6 +774,7 @@ static int hwc_set(hwc_composer_device_1 *dev,
     // This is only indicative of how many times SurfaceFlinger posts
     // frames to the display.
     CALC_FPS();
+    MDPComp::onFrameUpdate();
     MDPComp::resetIdleFallBack();
     ctx->mVideoTransFlag = false;
     //Was locked at the beginning of prepare
@@ -94,7 +94,7 @@ bool FBUpdateNonSplit::preRotateExtDisplay(hwc_context_t *ctx,
     int extOrient = getExtOrientation(ctx);
     ovutils::eTransform orient = static_cast<ovutils::eTransform >(extOrient);
     if(mDpy && (extOrient & HWC_TRANSFORM_ROT_90)) {
-        mRot = ctx->mRotMgr->getNext();
+        mRot = ctx->mRotMgr->getNext(info);
         if(mRot == NULL) return false;
         ctx->mLayerRotMap[mDpy]->add(layer, mRot);
         // Composed FB content will have black bars, if the viewFrame of the
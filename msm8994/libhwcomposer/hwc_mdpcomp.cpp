@@ -113,6 +113,10 @@ void MDPComp::dump(android::String8& buf, hwc_context_t *ctx)
                     (mCurrentFrame.isFBComposed[index] ? mCurrentFrame.fbZ :
     mCurrentFrame.mdpToLayer[mCurrentFrame.layerToMDP[index]].pipeInfo->zOrder));
     dumpsys_log(buf,"\n");
+    if(mDpy == HWC_DISPLAY_PRIMARY && sIdleInvalidator) {
+        sIdleInvalidator->dump(buf);
+        dumpsys_log(buf,"\n");
+    }
 }
 
 bool MDPComp::init(hwc_context_t *ctx) {
@@ -251,6 +255,13 @@ void MDPComp::timeout_handler(void *udata) {
     ctx->proc->invalidate(ctx->proc);
 }
 
+void MDPComp::onFrameUpdate() {
+    // The redraw requested on idle timeout is not a content update
+    if(sIdleInvalidator && !sIdleFallBack) {
+        sIdleInvalidator->onFrameUpdate(systemTime(SYSTEM_TIME_MONOTONIC));
+    }
+}
+
 void MDPComp::setMaxPipesPerMixer(const uint32_t value) {
     qdutils::MDPVersion &mdpVersion = qdutils::MDPVersion::getInstance();
     uint32_t maxSupported = (int)mdpVersion.getBlendStages();
@@ -1198,6 +1209,39 @@ bool MDPComp::cacheBasedComp(hwc_context_t *ctx,
     return true;
 }
 
+void MDPComp::getLayerCompCost(hwc_layer_1_t* layer, LayerCompCost& cost) {
+    private_handle_t *hnd = (private_handle_t *)layer->handle;
+    hwc_rect_t crop = integerizeSourceCrop(layer->sourceCropf);
+    hwc_rect_t dst = layer->displayFrame;
+    uint64_t srcPixels = (uint64_t)(crop.right - crop.left) *
+            (crop.bottom - crop.top);
+    uint64_t dstPixels = (uint64_t)(dst.right - dst.left) *
+            (dst.bottom - dst.top);
+    uint64_t bpp = 4;
+
+    if(hnd) {
+        switch(hnd->format) {
+        case HAL_PIXEL_FORMAT_RGB_565:
+            bpp = 2;
+            break;
+        case HAL_PIXEL_FORMAT_RGB_888:
+            bpp = 3;
+            break;
+        default:
+            break;
+        }
+    }
+
+    //MDP fetches the source once, but a downscale raises the clock needed
+    //to fetch it within the line time, so weigh it by the downscale ratio.
+    cost.mdp = srcPixels * bpp;
+    if(dstPixels and srcPixels > dstPixels) {
+        cost.mdp = cost.mdp * srcPixels / dstPixels;
+    }
+    //GPU samples the source and blends into the FB target (read + write)
+    cost.gpu = srcPixels * bpp + dstPixels * 4 * 2;
+}
+
 bool MDPComp::loadBasedComp(hwc_context_t *ctx,
         hwc_display_contents_1_t* list) {
     if(sSimulationFlags & MDPCOMP_AVOID_LOAD_MDP)
@@ -1211,66 +1255,138 @@ bool MDPComp::loadBasedComp(hwc_context_t *ctx,
     const int numNonDroppedLayers = numAppLayers - mCurrentFrame.dropCount;
     const int stagesForMDP = min(sMaxPipesPerMixer,
             ctx->mOverlay->availablePipes(mDpy, Overlay::MIXER_DEFAULT));
+    //1 stage for FB
+    const int maxMDPBatchSize = min(stagesForMDP - 1, MAX_NUM_BLEND_STAGES - 1);
+    const bool cacheValid = (mCachedFrame.layerCount == numAppLayers);
 
-    int mdpBatchSize = stagesForMDP - 1; //1 stage for FB
-    int fbBatchSize = numNonDroppedLayers - mdpBatchSize;
-    int lastMDPSupportedIndex = numAppLayers;
-    int dropCount = 0;
+    if(maxMDPBatchSize < 1) {
+        ALOGD_IF(isDebug(), "%s: No MDP stages left for load based comp",
+                __FUNCTION__);
+        return false;
+    }
+
+    //Running totals over the non dropped layers, so that any contiguous fb
+    //batch [start, end] can be costed in constant time.
+    uint64_t mdpCost[MAX_NUM_APP_LAYERS + 1];
+    uint64_t gpuCost[MAX_NUM_APP_LAYERS + 1];
+    int updating[MAX_NUM_APP_LAYERS + 1];
+    int unsupported[MAX_NUM_APP_LAYERS + 1];
+    int cachedOnFB[MAX_NUM_APP_LAYERS + 1];
+    int nonDropped[MAX_NUM_APP_LAYERS + 1];
 
-    //Find the minimum MDP batch size
-    for(int i = 0; i < numAppLayers;i++) {
+    mdpCost[0] = gpuCost[0] = 0;
+    updating[0] = unsupported[0] = cachedOnFB[0] = nonDropped[0] = 0;
+    for(int i = 0; i < numAppLayers; i++) {
+        mdpCost[i + 1] = mdpCost[i];
+        gpuCost[i + 1] = gpuCost[i];
+        updating[i + 1] = updating[i];
+        unsupported[i + 1] = unsupported[i];
+        cachedOnFB[i + 1] = cachedOnFB[i];
+        nonDropped[i + 1] = nonDropped[i];
         if(mCurrentFrame.drop[i]) {
-            dropCount++;
             continue;
         }
+
         hwc_layer_1_t* layer = &list->hwLayers[i];
-        if(not isSupportedForMDPComp(ctx, layer)) {
-            lastMDPSupportedIndex = i;
-            mdpBatchSize = min(i - dropCount, stagesForMDP - 1);
-            fbBatchSize = numNonDroppedLayers - mdpBatchSize;
-            break;
+        LayerCompCost cost;
+        getLayerCompCost(layer, cost);
+        mdpCost[i + 1] += cost.mdp;
+        gpuCost[i + 1] += cost.gpu;
+        updating[i + 1] += layerUpdating(layer) ? 1 : 0;
+        unsupported[i + 1] += isSupportedForMDPComp(ctx, layer) ? 0 : 1;
+        cachedOnFB[i + 1] += (cacheValid and
+                mCachedFrame.isFBComposed[i]) ? 1 : 0;
+        nonDropped[i + 1]++;
+    }
+
+    //Find the cheapest fb batch for every mdp batch size in a single pass
+    //over all contiguous fb batch positions, without touching overlay state.
+    LoadCompSplit best[MAX_NUM_BLEND_STAGES];
+    for(int k = 0; k < MAX_NUM_BLEND_STAGES; k++) {
+        best[k].valid = false;
+    }
+
+    for(int start = 0; start < numAppLayers; start++) {
+        if(mCurrentFrame.drop[start]) {
+            continue;
         }
-    }
+        for(int end = start; end < numAppLayers; end++) {
+            if(mCurrentFrame.drop[end]) {
+                continue;
+            }
 
-    ALOGD_IF(isDebug(), "%s:Before optimizing fbBatch, mdpbatch %d, fbbatch %d "
-            "dropped %d", __FUNCTION__, mdpBatchSize, fbBatchSize,
-            mCurrentFrame.dropCount);
+            const int fbBatchSize = nonDropped[end + 1] - nonDropped[start];
+            const int mdpBatchSize = numNonDroppedLayers - fbBatchSize;
+            //The fb batch should at least have 2 layers, for this mode to be
+            //justified, and there should be at least 1 layer for MDP.
+            if(fbBatchSize < 2 or mdpBatchSize > maxMDPBatchSize) {
+                continue;
+            }
+            if(mdpBatchSize < 1) {
+                break;
+            }
+            //Layers MDP cannot handle have to stay in the fb batch
+            if(unsupported[end + 1] - unsupported[start] !=
+                    unsupported[numAppLayers]) {
+                continue;
+            }
 
-    //Start at a point where the fb batch should at least have 2 layers, for
-    //this mode to be justified.
-    while(fbBatchSize < 2) {
-        ++fbBatchSize;
-        --mdpBatchSize;
-    }
+            uint64_t cost = mdpCost[numAppLayers] -
+                    (mdpCost[end + 1] - mdpCost[start]);
+            //A batch that is unchanged and was on FB last frame can reuse
+            //the FB target, so GPU does no work for it.
+            const bool fbReusable =
+                    (updating[end + 1] - updating[start] == 0) and
+                    (cachedOnFB[end + 1] - cachedOnFB[start] == fbBatchSize) and
+                    (cachedOnFB[numAppLayers] == fbBatchSize);
+            if(not fbReusable) {
+                cost += gpuCost[end + 1] - gpuCost[start];
+            }
 
-    //If there are no layers for MDP, this mode doesnt make sense.
-    if(mdpBatchSize < 1) {
-        ALOGD_IF(isDebug(), "%s: No MDP layers after optimizing for fbBatch",
-                __FUNCTION__);
-        return false;
+            LoadCompSplit& split = best[mdpBatchSize];
+            if(not split.valid or cost < split.cost) {
+                split.valid = true;
+                split.cost = cost;
+                split.fbStart = start;
+                split.fbEnd = end;
+            }
+        }
     }
 
     mCurrentFrame.reset(numAppLayers);
 
-    //Try with successively smaller mdp batch sizes until we succeed or reach 1
-    while(mdpBatchSize > 0) {
-        //Mark layers for MDP comp
-        int mdpBatchLeft = mdpBatchSize;
-        for(int i = 0; i < lastMDPSupportedIndex and mdpBatchLeft; i++) {
+    //Program the cheapest split. If it fails, the next attempt only considers
+    //splits with fewer MDP layers, since those need fewer resources.
+    int failedBatchSize = maxMDPBatchSize + 1;
+    while(true) {
+        int mdpBatchSize = -1;
+        for(int k = 1; k < failedBatchSize; k++) {
+            if(best[k].valid and (mdpBatchSize < 0 or
+                    best[k].cost < best[mdpBatchSize].cost)) {
+                mdpBatchSize = k;
+            }
+        }
+        if(mdpBatchSize < 0) {
+            break;
+        }
+
+        const LoadCompSplit& split = best[mdpBatchSize];
+        for(int i = 0; i < numAppLayers; i++) {
             if(mCurrentFrame.drop[i]) {
                 continue;
             }
-            mCurrentFrame.isFBComposed[i] = false;
-            --mdpBatchLeft;
+            mCurrentFrame.isFBComposed[i] =
+                    (i >= split.fbStart and i <= split.fbEnd);
         }
 
-        mCurrentFrame.fbZ = mdpBatchSize;
-        mCurrentFrame.fbCount = fbBatchSize;
+        mCurrentFrame.fbZ = nonDropped[split.fbStart];
+        mCurrentFrame.fbCount = numNonDroppedLayers - mdpBatchSize;
         mCurrentFrame.mdpCount = mdpBatchSize;
 
-        ALOGD_IF(isDebug(), "%s:Trying with: mdpbatch %d fbbatch %d dropped %d",
-                __FUNCTION__, mdpBatchSize, fbBatchSize,
-                mCurrentFrame.dropCount);
+        ALOGD_IF(isDebug(), "%s:Trying with: mdpbatch %d fbbatch %d [%d, %d] "
+                "cost %llu dropped %d", __FUNCTION__, mdpBatchSize,
+                mCurrentFrame.fbCount, split.fbStart, split.fbEnd,
+                (unsigned long long)split.cost, mCurrentFrame.dropCount);
 
         if(postHeuristicsHandling(ctx, list)) {
             ALOGD_IF(isDebug(), "%s: Postheuristics handling succeeded",
@@ -1281,10 +1397,11 @@ bool MDPComp::loadBasedComp(hwc_context_t *ctx,
         }
 
         reset(ctx);
-        --mdpBatchSize;
-        ++fbBatchSize;
+        failedBatchSize = mdpBatchSize;
     }
 
+    ALOGD_IF(isDebug(), "%s: No valid split for load based comp",
+            __FUNCTION__);
     return false;
 }
 
@@ -2880,7 +2997,7 @@ int MDPCompSrcSplit::configure(hwc_context_t *ctx, hwc_layer_1_t *layer,
     }
 
     if((has90Transform(layer) or downscale) and isRotationDoable(ctx, hnd)) {
-        (*rot) = ctx->mRotMgr->getNext();
+        (*rot) = ctx->mRotMgr->getNext(whf);
         if((*rot) == NULL) return -1;
         ctx->mLayerRotMap[mDpy]->add(layer, *rot);
         //If the video is using a single pipe, enable BWC
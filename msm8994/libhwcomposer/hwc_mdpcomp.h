@@ -52,6 +52,8 @@ public:
     /* Initialize MDP comp*/
     static bool init(hwc_context_t *ctx);
     static void resetIdleFallBack() { sIdleFallBack = false; }
+    /* Feeds a frame update to the idle timeout learning */
+    static void onFrameUpdate();
     static bool isIdleFallback() { return sIdleFallBack; }
     static void dynamicDebug(bool enable){ sDebugLogs = enable; }
     static void setIdleTimeout(const uint32_t& timeout);
@@ -182,11 +184,23 @@ protected:
     bool partialMDPComp(hwc_context_t *ctx, hwc_display_contents_1_t* list);
     /* Partial MDP comp that uses caching to save power as primary goal */
     bool cacheBasedComp(hwc_context_t *ctx, hwc_display_contents_1_t* list);
-    /* Partial MDP comp that balances the load between MDP and GPU such that
-     * MDP is loaded to the max of its capacity. The lower z order layers are
-     * fed to MDP, whereas the upper ones to GPU, because the upper ones have
-     * lower number of pixels and can reduce GPU processing time */
+    /* Partial MDP comp that balances the load between MDP and GPU. Every
+     * contiguous FB batch is costed using the estimates below and the
+     * cheapest split the pipes can hold is programmed */
     bool loadBasedComp(hwc_context_t *ctx, hwc_display_contents_1_t* list);
+    /* estimated per frame cost of a layer on MDP or in the FB batch */
+    struct LayerCompCost {
+        uint64_t mdp;
+        uint64_t gpu;
+    };
+    static void getLayerCompCost(hwc_layer_1_t* layer, LayerCompCost& cost);
+    /* cheapest FB batch found for a given MDP batch size */
+    struct LoadCompSplit {
+        bool valid;
+        uint64_t cost;
+        int fbStart;
+        int fbEnd;
+    };
     /* Checks if its worth doing load based partial comp */
     bool isLoadBasedCompDoable(hwc_context_t *ctx);
     /* checks for conditions where only video can be bypassed */
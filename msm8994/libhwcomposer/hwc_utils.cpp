@@ -1525,9 +1525,10 @@ int hwc_sync(hwc_context_t *ctx, hwc_display_contents_1_t* list, int dpy,
     if(dpy)
        isExtAnimating = ctx->listStats[dpy].isDisplayAnimating;
 
-    //Send acquireFenceFds to rotator
+    //Send acquireFenceFds to rotator. MSMFB_BUFFER_SYNC takes a single
+    //session, so this stays one ioctl per uncached rotator session.
+    int rotFd = ctx->mRotMgr->getRotDevFd();
     for(uint32_t i = 0; i < ctx->mLayerRotMap[dpy]->getCount(); i++) {
-        int rotFd = ctx->mRotMgr->getRotDevFd();
         int rotReleaseFd = -1;
         overlay::Rotator* currRot = ctx->mLayerRotMap[dpy]->getRot(i);
         hwc_layer_1_t* currLayer = ctx->mLayerRotMap[dpy]->getLayer(i);
@@ -2010,7 +2011,7 @@ int configureNonSplit(hwc_context_t *ctx, hwc_layer_1_t *layer,
 
     //if 90 component or downscale, use rot
     if((has90Transform(layer) or downscale) and isRotationDoable(ctx, hnd)) {
-        *rot = ctx->mRotMgr->getNext();
+        *rot = ctx->mRotMgr->getNext(whf);
         if(*rot == NULL) return -1;
         ctx->mLayerRotMap[dpy]->add(layer, *rot);
         BwcPM::setBwc(ctx, dpy, hnd, crop, dst, transform, downscale,
@@ -2121,7 +2122,7 @@ int configureSplit(hwc_context_t *ctx, hwc_layer_1_t *layer,
     }
 
     if((has90Transform(layer) or downscale) and isRotationDoable(ctx, hnd)) {
-        (*rot) = ctx->mRotMgr->getNext();
+        (*rot) = ctx->mRotMgr->getNext(whf);
         if((*rot) == NULL) return -1;
         ctx->mLayerRotMap[dpy]->add(layer, *rot);
         //Configure rotator for pre-rotation
@@ -2256,7 +2257,7 @@ int configureSourceSplit(hwc_context_t *ctx, hwc_layer_1_t *layer,
     trimLayer(ctx, dpy, transform, crop, dst);
 
     if(has90Transform(layer) && isRotationDoable(ctx, hnd)) {
-        (*rot) = ctx->mRotMgr->getNext();
+        (*rot) = ctx->mRotMgr->getNext(whf);
         if((*rot) == NULL) return -1;
         ctx->mLayerRotMap[dpy]->add(layer, *rot);
         //Configure rotator for pre-rotation
@@ -208,10 +208,11 @@ bool MdpRot::close() {
     return success;
 }
 
-bool MdpRot::remap(uint32_t numbufs) {
-    // if current size changed, remap
+bool MdpRot::remap() {
+    // if current size or number of buffers changed, remap
     uint32_t opBufSize = calcOutputBufSize();
-    if(opBufSize == mMem.size()) {
+    uint32_t numbufs = mMem.getNumBufs(opBufSize);
+    if(opBufSize == mMem.size() && numbufs == mMem.mem.numBufs()) {
         ALOGE_IF(DEBUG_OVERLAY, "%s: same size %d", __FUNCTION__, opBufSize);
         return true;
     }
@@ -231,6 +232,7 @@ bool MdpRot::remap(uint32_t numbufs) {
     for (uint32_t i = 0; i < numbufs; ++i) {
         mMem.mRotOffset[i] = i * opBufSize;
     }
+    mMem.onRemap();
 
     return true;
 }
@@ -252,7 +254,7 @@ bool MdpRot::queueBuffer(int fd, uint32_t offset) {
         mRotDataInfo.src.memory_id = fd;
         mRotDataInfo.src.offset = offset;
 
-        if(false == remap(RotMem::ROT_NUM_BUFS)) {
+        if(false == remap()) {
             ALOGE("%s Remap failed, not queueing", __FUNCTION__);
             return false;
         }
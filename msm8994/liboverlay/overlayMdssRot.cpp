@@ -192,7 +192,7 @@ bool MdssRot::queueBuffer(int fd, uint32_t offset) {
         mRotData.data.memory_id = fd;
         mRotData.data.offset = offset;
 
-        if(false == remap(RotMem::ROT_NUM_BUFS)) {
+        if(false == remap()) {
             ALOGE("%s Remap failed, not queuing", __FUNCTION__);
             return false;
         }
@@ -235,16 +235,18 @@ bool MdssRot::open_i(uint32_t numbufs, uint32_t bufsz)
     return true;
 }
 
-bool MdssRot::remap(uint32_t numbufs) {
+bool MdssRot::remap() {
     // Calculate the size based on rotator's dst format, w and h.
     uint32_t opBufSize = calcOutputBufSize();
-    // If current size changed, remap
-    if(opBufSize == mMem.size()) {
+    uint32_t numbufs = mMem.getNumBufs(opBufSize);
+    // If current size or number of buffers changed, remap
+    if(opBufSize == mMem.size() && numbufs == mMem.mem.numBufs()) {
         ALOGE_IF(DEBUG_OVERLAY, "%s: same size %d", __FUNCTION__, opBufSize);
         return true;
     }
 
-    ALOGE_IF(DEBUG_OVERLAY, "%s: size changed - remapping", __FUNCTION__);
+    ALOGE_IF(DEBUG_OVERLAY, "%s: size changed - remapping %d bufs",
+            __FUNCTION__, numbufs);
 
     if(!mMem.close()) {
         ALOGE("%s error in closing prev rot mem", __FUNCTION__);
@@ -259,6 +261,7 @@ bool MdssRot::remap(uint32_t numbufs) {
     for (uint32_t i = 0; i < numbufs; ++i) {
         mMem.mRotOffset[i] = i * opBufSize;
     }
+    mMem.onRemap();
 
     return true;
 }
@@ -106,21 +106,91 @@ bool RotMem::close() {
             ret = false;
         }
     }
+    sExtraMemUsed -= mExtraMem;
+    mExtraMem = 0;
     return ret;
 }
 
-RotMem::RotMem() : mCurrIndex(0) {
+bool RotMem::sBudgetInit = false;
+uint32_t RotMem::sMaxBufs = RotMem::ROT_MIN_BUFS;
+uint32_t RotMem::sExtraMemBudget = 0;
+uint32_t RotMem::sExtraMemUsed = 0;
+
+RotMem::RotMem() : mCurrIndex(0), mNumBufs(ROT_MIN_BUFS), mStallCount(0),
+        mExtraMem(0) {
     utils::memset0(mRotOffset);
-    for(int i = 0; i < ROT_NUM_BUFS; i++) {
+    for(int i = 0; i < ROT_MAX_BUFS; i++) {
         mRelFence[i] = -1;
     }
 }
 
 RotMem::~RotMem() {
-    for(int i = 0; i < ROT_NUM_BUFS; i++) {
+    for(int i = 0; i < ROT_MAX_BUFS; i++) {
         ::close(mRelFence[i]);
         mRelFence[i] = -1;
     }
+    sExtraMemUsed -= mExtraMem;
+    mExtraMem = 0;
+}
+
+void RotMem::initBudget() {
+    char property[PROPERTY_VALUE_MAX];
+    sBudgetInit = true;
+    sMaxBufs = ROT_MAX_BUFS;
+    // Default leaves room for two extra 1080p NV12 buffers
+    sExtraMemBudget = 8 * 1024 * 1024;
+
+    if(property_get("persist.hwc.rot.max_bufs", property, NULL) > 0) {
+        int maxBufs = atoi(property);
+        if(maxBufs >= ROT_MIN_BUFS && maxBufs <= ROT_MAX_BUFS) {
+            sMaxBufs = maxBufs;
+        }
+    }
+    if(property_get("persist.hwc.rot.extra_mem_kb", property, NULL) > 0) {
+        sExtraMemBudget = atoi(property) * 1024;
+    }
+}
+
+uint32_t RotMem::getNumBufs(const uint32_t& bufSz) {
+    if(!sBudgetInit) {
+        initBudget();
+    }
+
+    if(mStallCount >= ROT_STALLS_TO_GROW && mNumBufs < sMaxBufs) {
+        mNumBufs++;
+        mStallCount = 0;
+    }
+
+    // Memory of other sessions is fixed here, this one can use the rest.
+    uint32_t others = sExtraMemUsed - mExtraMem;
+    uint32_t available = (sExtraMemBudget > others) ?
+            (sExtraMemBudget - others) : 0;
+    uint32_t numBufs = ROT_MIN_BUFS;
+    while(numBufs < mNumBufs && bufSz &&
+            (numBufs + 1 - ROT_MIN_BUFS) * bufSz <= available) {
+        numBufs++;
+    }
+    return numBufs;
+}
+
+void RotMem::onRemap() {
+    for(int i = 0; i < ROT_MAX_BUFS; i++) {
+        if(mRelFence[i] >= 0) {
+            ::close(mRelFence[i]);
+            mRelFence[i] = -1;
+        }
+    }
+    mCurrIndex = 0;
+
+    sExtraMemUsed -= mExtraMem;
+    mExtraMem = 0;
+    if(mem.numBufs() > ROT_MIN_BUFS) {
+        mExtraMem = (mem.numBufs() - ROT_MIN_BUFS) * mem.bufSz();
+    }
+    sExtraMemUsed += mExtraMem;
+    ALOGD_IF(DEBUG_OVERLAY, "%s: %d bufs of %d, extra mem used %d of %d",
+            __FUNCTION__, mem.numBufs(), mem.bufSz(), sExtraMemUsed,
+            sExtraMemBudget);
 }
 
 void RotMem::setCurrBufReleaseFd(const int& fence) {
@@ -131,6 +201,10 @@ void RotMem::setCurrBufReleaseFd(const int& fence) {
         //Can happen if rotation takes > vsync and a fast producer. i.e queue
         //happens in subsequent vsyncs either because content is 60fps or
         //because the producer is hasty sometimes.
+        //Repeated waits make the ring grow on the next remap.
+        if(sync_wait(mRelFence[mCurrIndex], 0) < 0) {
+            mStallCount++;
+        }
         ret = sync_wait(mRelFence[mCurrIndex], 1000);
         if(ret < 0) {
             ALOGE("%s: sync_wait error!! error no = %d err str = %s",
@@ -168,6 +242,7 @@ RotMgr* RotMgr::getInstance() {
 RotMgr::RotMgr() {
     for(int i = 0; i < MAX_ROT_SESS; i++) {
         mRot[i] = 0;
+        mRotSrc[i] = utils::Whf();
     }
     mUseCount = 0;
     mRotDevFd = -1;
@@ -189,17 +264,29 @@ void RotMgr::configDone() {
             delete mRot[i];
             mRot[i] = 0;
         }
+        mRotSrc[i] = utils::Whf();
     }
 }
 
-Rotator* RotMgr::getNext() {
+Rotator* RotMgr::getNext(const utils::Whf& whf) {
     //Return a rot object, creating one if necessary
     overlay::Rotator *rot = NULL;
     if(mUseCount >= MAX_ROT_SESS) {
         ALOGW("%s, MAX rotator sessions reached, request rejected", __func__);
     } else {
+        //Swap an unused object last configured for the same source to the
+        //top, so that layers keep their rotator when the order changes.
+        for(int i = mUseCount + 1; i < MAX_ROT_SESS; i++) {
+            if(mRot[i] && mRotSrc[i].w == whf.w && mRotSrc[i].h == whf.h &&
+                    mRotSrc[i].format == whf.format) {
+                utils::swap(mRot[i], mRot[mUseCount]);
+                utils::swap(mRotSrc[i], mRotSrc[mUseCount]);
+                break;
+            }
+        }
         if(mRot[mUseCount] == NULL)
             mRot[mUseCount] = overlay::Rotator::getRotator();
+        mRotSrc[mUseCount] = whf;
         rot = mRot[mUseCount++];
     }
     return rot;
@@ -212,6 +299,7 @@ void RotMgr::clear() {
             delete mRot[i];
             mRot[i] = 0;
         }
+        mRotSrc[i] = utils::Whf();
     }
     mUseCount = 0;
     ::close(mRotDevFd);
@@ -45,8 +45,10 @@ namespace overlay {
    we don't need this RotMem wrapper. The inner class is sufficient.
 */
 struct RotMem {
-    // Max rotator buffers
-    enum { ROT_NUM_BUFS = 2 };
+    // Min and max rotator buffers per session. A session starts with
+    // ROT_MIN_BUFS and grows its ring when it keeps waiting on MDP to release
+    // the next buffer, within the memory budget shared by all sessions.
+    enum { ROT_MIN_BUFS = 2, ROT_MAX_BUFS = 4 };
     RotMem();
     ~RotMem();
     bool close();
@@ -54,13 +56,32 @@ struct RotMem {
     uint32_t size() const { return mem.bufSz(); }
     void setCurrBufReleaseFd(const int& fence);
     void setPrevBufReleaseFd(const int& fence);
+    /* Returns the number of buffers to map for the given buffer size */
+    uint32_t getNumBufs(const uint32_t& bufSz);
+    /* Accounts the newly mapped buffers against the budget and drops fences
+     * of the previous buffers */
+    void onRemap();
 
     // rotator data info dst offset
-    uint32_t mRotOffset[ROT_NUM_BUFS];
-    int mRelFence[ROT_NUM_BUFS];
+    uint32_t mRotOffset[ROT_MAX_BUFS];
+    int mRelFence[ROT_MAX_BUFS];
     // current slot being used
     uint32_t mCurrIndex;
+    // buffers wanted in the ring, and waits on a busy buffer since last growth
+    uint32_t mNumBufs;
+    uint32_t mStallCount;
+    // memory mapped beyond ROT_MIN_BUFS buffers
+    uint32_t mExtraMem;
     OvMem mem;
+
+private:
+    // Waits on a busy buffer needed before the ring grows by one buffer
+    enum { ROT_STALLS_TO_GROW = 3 };
+    static void initBudget();
+    static bool sBudgetInit;
+    static uint32_t sMaxBufs;
+    static uint32_t sExtraMemBudget;
+    static uint32_t sExtraMemUsed;
 };
 
 class Rotator
@@ -157,8 +178,8 @@ private:
     bool close();
     void setRotations(uint32_t r);
     bool enabled () const;
-    /* remap rot buffers */
-    bool remap(uint32_t numbufs);
+    /* remap rot buffers, on a change of buffer size or count */
+    bool remap();
     bool open_i(uint32_t numbufs, uint32_t bufsz);
     /* Deferred transform calculations */
     void doTransform();
@@ -229,8 +250,8 @@ private:
     bool close();
     void setRotations(uint32_t r);
     bool enabled () const;
-    /* remap rot buffers */
-    bool remap(uint32_t numbufs);
+    /* remap rot buffers, on a change of buffer size or count */
+    bool remap();
     bool open_i(uint32_t numbufs, uint32_t bufsz);
     /* Deferred transform calculations */
     void doTransform();
@@ -294,7 +315,10 @@ public:
     ~RotMgr();
     void configBegin();
     void configDone();
-    overlay::Rotator *getNext();
+    /* Returns an unused rot object, preferring the one last used for a
+     * source of the same geometry and format, so that its configuration
+     * and buffers can be reused as is */
+    overlay::Rotator *getNext(const utils::Whf& whf);
     void clear(); //Removes all instances
     //Resets the usage of top count objects, making them available for reuse
     void markUnusedTop(const uint32_t& count) { mUseCount -= count; }
@@ -312,6 +336,8 @@ private:
     static RotMgr *sRotMgr;
 
     overlay::Rotator *mRot[MAX_ROT_SESS];
+    // Source of the last configuration of each rot object
+    utils::Whf mRotSrc[MAX_ROT_SESS];
     uint32_t mUseCount;
     int mRotDevFd;
 };
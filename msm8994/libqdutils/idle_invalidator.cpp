@@ -33,18 +33,30 @@
 #include <string.h>
 #include <fcntl.h>
 #include <cutils/properties.h>
+#include <algorithm>
 
 #define II_DEBUG 0
 #define IDLE_NOTIFY_PATH "/sys/devices/virtual/graphics/fb0/idle_notify"
 #define IDLE_TIME_PATH "/sys/devices/virtual/graphics/fb0/idle_time"
 
+// Frame update cadence learning parameters
+#define MIN_INTERVALS 8
+#define HYSTERESIS_UPDATES 4
+#define HYSTERESIS_PERCENT 20
+#define STATIC_INTERVAL_NS 5000000000LL
+#define STATIC_INTERVALS 3
+
 
 static const char *threadName = "IdleInvalidator";
 InvalidatorHandler IdleInvalidator::mHandler = NULL;
 android::sp<IdleInvalidator> IdleInvalidator::sInstance(0);
 
 IdleInvalidator::IdleInvalidator(): Thread(false), mHwcContext(0),
-    mTimeoutEventFd(-1) {
+    mTimeoutEventFd(-1), mAdaptive(false), mBaseTimeout(0), mMaxTimeout(0),
+    mTimeout(0), mHead(0), mCount(0), mLastUpdate(0), mIdleEntry(0),
+    mStaticIntervals(0), mCandidate(0), mCandidateUpdates(0), mInterval(0),
+    mIdleEntries(0), mEarlyExits(0), mTimeoutChanges(0) {
+    memset(mIntervals, 0, sizeof(mIntervals));
     ALOGD_IF(II_DEBUG, "IdleInvalidator::%s", __FUNCTION__);
 }
 
@@ -71,6 +83,12 @@ int IdleInvalidator::init(InvalidatorHandler reg_handler, void* user_data) {
     if((property_get("debug.mdpcomp.idletime", property, NULL) > 0)) {
         defaultIdleTime = atoi(property);
     }
+    mMaxTimeout = 2000; //ms
+    if((property_get("debug.mdpcomp.idletime.max", property, NULL) > 0)) {
+        mMaxTimeout = atoi(property);
+    }
+    mAdaptive = !((property_get("persist.hwc.adaptive_idle.disable",
+            property, NULL) > 0) && (atoi(property) == 1));
     if(not setIdleTimeout(defaultIdleTime)) {
         close(mTimeoutEventFd);
         mTimeoutEventFd = -1;
@@ -83,6 +101,15 @@ int IdleInvalidator::init(InvalidatorHandler reg_handler, void* user_data) {
 }
 
 bool IdleInvalidator::setIdleTimeout(const uint32_t& timeout) {
+    android::Mutex::Autolock lock(mLock);
+    // Explicitly set timeouts reset the learnt one
+    mBaseTimeout = timeout;
+    mTimeout = timeout;
+    mCandidateUpdates = 0;
+    return writeIdleTimeout(timeout);
+}
+
+bool IdleInvalidator::writeIdleTimeout(const uint32_t& timeout) {
     ALOGD_IF(II_DEBUG, "IdleInvalidator::%s timeout %d",
             __FUNCTION__, timeout);
 
@@ -126,12 +153,111 @@ bool IdleInvalidator::threadLoop() {
             ssize_t len = pread(pFd.fd, data, 64, 0);
             ALOGD_IF(II_DEBUG, "IdleInvalidator::%s Idle Timeout fired len %ld",
                 __FUNCTION__, len);
+            {
+                android::Mutex::Autolock lock(mLock);
+                mIdleEntry = systemTime(SYSTEM_TIME_MONOTONIC);
+                mIdleEntries++;
+            }
             mHandler((void*)mHwcContext);
         }
     }
     return true;
 }
 
+void IdleInvalidator::onFrameUpdate(nsecs_t now) {
+    android::Mutex::Autolock lock(mLock);
+    // Timeouts beyond the max are used to disable the idle fallback
+    if(!mAdaptive or mBaseTimeout > mMaxTimeout) {
+        return;
+    }
+
+    if(mIdleEntry) {
+        if((now - mIdleEntry) <= ms2ns(mMaxTimeout)) {
+            mEarlyExits++;
+        }
+        mIdleEntry = 0;
+    }
+
+    if(mLastUpdate) {
+        nsecs_t interval = now - mLastUpdate;
+        if(interval >= STATIC_INTERVAL_NS) {
+            // Long pauses are not part of the cadence, restart the window
+            mStaticIntervals++;
+            mCount = 0;
+        } else {
+            mStaticIntervals = 0;
+            mIntervals[mHead] = interval;
+            mHead = (mHead + 1) % WINDOW_SIZE;
+            if(mCount < WINDOW_SIZE)
+                mCount++;
+        }
+    }
+    mLastUpdate = now;
+
+    uint32_t candidate = getCandidateTimeout();
+    uint32_t margin = (mTimeout * HYSTERESIS_PERCENT) / 100;
+    if((candidate + margin >= mTimeout) && (candidate <= mTimeout + margin)) {
+        mCandidateUpdates = 0;
+        return;
+    }
+
+    uint32_t candidateMargin = (mCandidate * HYSTERESIS_PERCENT) / 100;
+    if(mCandidateUpdates && (candidate + candidateMargin >= mCandidate) &&
+            (candidate <= mCandidate + candidateMargin)) {
+        mCandidateUpdates++;
+    } else {
+        mCandidateUpdates = 1;
+    }
+    mCandidate = candidate;
+
+    if(mCandidateUpdates >= HYSTERESIS_UPDATES) {
+        ALOGD_IF(II_DEBUG, "IdleInvalidator::%s interval %u timeout %u -> %u",
+                __FUNCTION__, mInterval, mTimeout, candidate);
+        if(writeIdleTimeout(candidate)) {
+            mTimeout = candidate;
+            mTimeoutChanges++;
+        }
+        mCandidateUpdates = 0;
+    }
+}
+
+uint32_t IdleInvalidator::getCandidateTimeout() {
+    // Isolated updates on static content, fall back quickly after each
+    if(mStaticIntervals >= STATIC_INTERVALS) {
+        return std::max(mBaseTimeout / 2, 1U);
+    }
+
+    if(mCount < MIN_INTERVALS) {
+        mInterval = 0;
+        return mBaseTimeout;
+    }
+
+    nsecs_t intervals[WINDOW_SIZE];
+    uint32_t oldest = (mHead + WINDOW_SIZE - mCount) % WINDOW_SIZE;
+    for(uint32_t i = 0; i < mCount; i++) {
+        intervals[i] = mIntervals[(oldest + i) % WINDOW_SIZE];
+    }
+    uint32_t rank = (mCount * 9) / 10;
+    std::nth_element(intervals, intervals + rank, intervals + mCount);
+    mInterval = (uint32_t)ns2ms(intervals[rank]);
+
+    // Bridge the interval with some margin for jitter. Longer intervals are
+    // left to the base timeout, the content is idle between those updates.
+    uint32_t bridge = mInterval + mInterval / 4;
+    if(bridge <= mBaseTimeout or bridge > mMaxTimeout) {
+        return mBaseTimeout;
+    }
+    return bridge;
+}
+
+void IdleInvalidator::dump(android::String8& buf) {
+    android::Mutex::Autolock lock(mLock);
+    buf.appendFormat("Idle timeout: base %u ms current %u ms interval %u ms "
+            "adaptive %d\n", mBaseTimeout, mTimeout, mInterval, mAdaptive);
+    buf.appendFormat("Idle entries: %u early exits: %u timeout changes: %u\n",
+            mIdleEntries, mEarlyExits, mTimeoutChanges);
+}
+
 int IdleInvalidator::readyToRun() {
     ALOGD_IF(II_DEBUG, "IdleInvalidator::%s", __FUNCTION__);
     return 0; /*NO_ERROR*/
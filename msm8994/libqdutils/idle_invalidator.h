@@ -32,22 +32,52 @@
 
 #include <cutils/log.h>
 #include <utils/threads.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
 #include <gr.h>
 
 typedef void (*InvalidatorHandler)(void*);
 
 class IdleInvalidator : public android::Thread {
+    enum { WINDOW_SIZE = 32 };
+
     IdleInvalidator();
     void *mHwcContext;
     int mTimeoutEventFd;
     static InvalidatorHandler mHandler;
     static android::sp<IdleInvalidator> sInstance;
 
+    /* Adaptive timeout, learnt from the interval between frame updates */
+    android::Mutex mLock;
+    bool mAdaptive;
+    uint32_t mBaseTimeout;
+    uint32_t mMaxTimeout;
+    uint32_t mTimeout;
+    nsecs_t mIntervals[WINDOW_SIZE];
+    uint32_t mHead;
+    uint32_t mCount;
+    nsecs_t mLastUpdate;
+    nsecs_t mIdleEntry;
+    uint32_t mStaticIntervals;
+    uint32_t mCandidate;
+    uint32_t mCandidateUpdates;
+    uint32_t mInterval;
+    uint32_t mIdleEntries;
+    uint32_t mEarlyExits;
+    uint32_t mTimeoutChanges;
+
+    bool writeIdleTimeout(const uint32_t& timeout);
+    uint32_t getCandidateTimeout();
+
 public:
     ~IdleInvalidator();
     /* init timer obj */
     int init(InvalidatorHandler reg_handler, void* user_data);
+    /* Sets the timeout the adaptive timeout is learnt around */
     bool setIdleTimeout(const uint32_t& timeout);
+    /* Called for each frame update, adapts the timeout to the cadence */
+    void onFrameUpdate(nsecs_t now);
+    void dump(android::String8& buf);
 
     /*Overrides*/
     virtual bool        threadLoop();
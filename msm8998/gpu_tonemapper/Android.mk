@@ -23,6 +23,7 @@ LOCAL_CFLAGS              := $(version_flag) -Wno-missing-field-initializers -Wa
 
 LOCAL_SRC_FILES           := TonemapFactory.cpp \
                              glengine.cpp \
+                             EngineCache.cpp \
                              EGLImageBuffer.cpp \
                              EGLImageWrapper.cpp \
                              Tonemapper.cpp
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2017, The Linux Foundation. All rights reserved.
+ * Not a Contribution.
+ *
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <utils/Log.h>
+
+#include "EngineCache.h"
+#include "Tonemapper.h"
+#include "forward_tonemap.inl"
+#include "fullscreen_vertex_shader.inl"
+#include "rgba_inverse_tonemap.inl"
+
+// 3D and 1D LUTs are uploaded as GL_UNSIGNED_INT_2_10_10_10_REV texels
+#define LUT_TEXEL_SIZE 4
+
+//-----------------------------------------------------------------------------
+static uint64_t hashData(const void *data, int size)
+//-----------------------------------------------------------------------------
+{
+  // FNV-1a
+  const unsigned char *bytes = (const unsigned char *)data;
+  uint64_t hash = 14695981039346656037ULL;
+  for (int i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+}
+
+//-----------------------------------------------------------------------------
+bool EngineCache::TextureKey::operator<(const TextureKey &other) const
+//-----------------------------------------------------------------------------
+{
+  if (dimensions != other.dimensions) {
+    return dimensions < other.dimensions;
+  }
+  if (size != other.size) {
+    return size < other.size;
+  }
+
+  return hash < other.hash;
+}
+
+//-----------------------------------------------------------------------------
+EngineCache::EngineCache(EngineInterface *engine, bool isSecure)
+//-----------------------------------------------------------------------------
+  : engine(engine), isSecure(isSecure), engineContext(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+EngineCache *EngineCache::getInstance(bool isSecure)
+//-----------------------------------------------------------------------------
+{
+  static EngineInterface glEngine;
+  static EngineCache nonSecureCache(&glEngine, false);
+  static EngineCache secureCache(&glEngine, true);
+
+  return isSecure ? &secureCache : &nonSecureCache;
+}
+
+//-----------------------------------------------------------------------------
+void* EngineCache::bind()
+//-----------------------------------------------------------------------------
+{
+  void* callerContext = engine->backup();
+  if (!engineContext) {
+    // engine_initialize leaves the new context current
+    engineContext = engine->initialize(isSecure);
+  } else {
+    engine->bind(engineContext);
+  }
+
+  return callerContext;
+}
+
+//-----------------------------------------------------------------------------
+void EngineCache::unbind(void* callerContext)
+//-----------------------------------------------------------------------------
+{
+  engine->bind(callerContext);
+  engine->freeBackup(callerContext);
+}
+
+//-----------------------------------------------------------------------------
+unsigned int EngineCache::getProgram(int type, bool useXform)
+//-----------------------------------------------------------------------------
+{
+  int key = (type << 1) | (useXform ? 1 : 0);
+  std::map<int, unsigned int>::iterator it = programs.find(key);
+  if (it != programs.end()) {
+    return it->second;
+  }
+
+  const char *fragmentShaders[3];
+  int fragmentShaderCount = 0;
+  const char *version = "#version 300 es\n";
+  const char *define = "#define USE_NONUNIFORM_SAMPLING\n";
+
+  fragmentShaders[fragmentShaderCount++] = version;
+
+  // non-uniform sampling
+  if (useXform) {
+    fragmentShaders[fragmentShaderCount++] = define;
+  }
+
+  if (type == TONEMAP_INVERSE) {  // inverse tonemapping
+    fragmentShaders[fragmentShaderCount++] = rgba_inverse_tonemap_shader;
+  } else {  // forward tonemapping
+    fragmentShaders[fragmentShaderCount++] = forward_tonemap_shader;
+  }
+
+  unsigned int programID =
+      engine->loadProgram(1, &fullscreen_vertex_shader, fragmentShaderCount, fragmentShaders);
+  if (programID) {
+    programs[key] = programID;
+  }
+
+  return programID;
+}
+
+//-----------------------------------------------------------------------------
+unsigned int EngineCache::acquireTexture(int dimensions, void *data, int sz, int dataSize)
+//-----------------------------------------------------------------------------
+{
+  TextureKey key = {dimensions, sz, hashData(data, dataSize)};
+  std::map<TextureKey, TextureEntry>::iterator it = textures.find(key);
+  if (it != textures.end()) {
+    it->second.refCount++;
+    return it->second.id;
+  }
+
+  unsigned int id = (dimensions == 3) ? engine->load3DTexture(data, sz, 0) :
+                                        engine->load1DTexture(data, sz, 0);
+  if (id) {
+    TextureEntry entry = {id, 1};
+    textures[key] = entry;
+  }
+
+  return id;
+}
+
+//-----------------------------------------------------------------------------
+unsigned int EngineCache::acquire3DTexture(void *data, int sz)
+//-----------------------------------------------------------------------------
+{
+  return acquireTexture(3, data, sz, sz * sz * sz * LUT_TEXEL_SIZE);
+}
+
+//-----------------------------------------------------------------------------
+unsigned int EngineCache::acquire1DTexture(void *data, int sz)
+//-----------------------------------------------------------------------------
+{
+  if ((data == 0) || (sz == 0)) {
+    return 0;
+  }
+
+  return acquireTexture(1, data, sz, sz * LUT_TEXEL_SIZE);
+}
+
+//-----------------------------------------------------------------------------
+void EngineCache::releaseTexture(unsigned int id)
+//-----------------------------------------------------------------------------
+{
+  if (id == 0) {
+    return;
+  }
+
+  for (std::map<TextureKey, TextureEntry>::iterator it = textures.begin(); it != textures.end();
+       it++) {
+    if (it->second.id == id) {
+      if (--it->second.refCount == 0) {
+        engine->deleteInputBuffer(id);
+        textures.erase(it);
+      }
+      return;
+    }
+  }
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2017, The Linux Foundation. All rights reserved.
+ * Not a Contribution.
+ *
+ * Copyright 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TONEMAPPER_ENGINECACHE_H__
+#define __TONEMAPPER_ENGINECACHE_H__
+
+#include <stdint.h>
+#include <utils/Mutex.h>
+#include <map>
+
+#include "engine.h"
+
+// Seam over the engine calls that create and destroy GL objects, lets the cache be exercised on
+// a host with a recording fake.
+class EngineInterface {
+ public:
+  virtual ~EngineInterface() {}
+  virtual void* initialize(bool isSecure) { return engine_initialize(isSecure); }
+  virtual void bind(void* context) { engine_bind(context); }
+  virtual void* backup() { return engine_backup(); }
+  virtual void freeBackup(void* context) { engine_free_backup(context); }
+  virtual unsigned int loadProgram(int vertexEntries, const char **vertex, int fragmentEntries,
+                                   const char **fragment) {
+    return engine_loadProgram(vertexEntries, vertex, fragmentEntries, fragment);
+  }
+  virtual unsigned int load3DTexture(void *data, int sz, int format) {
+    return engine_load3DTexture(data, sz, format);
+  }
+  virtual unsigned int load1DTexture(void *data, int sz, int format) {
+    return engine_load1DTexture(data, sz, format);
+  }
+  virtual void deleteInputBuffer(unsigned int id) { engine_deleteInputBuffer(id); }
+};
+
+// One engine context per secure/non-secure domain, shared by all tonemappers of that domain.
+// Linked programs are cached per shader variant for the lifetime of the context, so building a
+// tonemapper does not compile shaders after the first use of a variant. LUT textures are shared
+// between tonemappers uploading identical tables and deleted with their last user.
+// All other methods must be called with the mutex returned by getMutex() held.
+class EngineCache {
+ private:
+  struct TextureKey {
+    int dimensions;
+    int size;
+    uint64_t hash;
+    bool operator<(const TextureKey &other) const;
+  };
+  struct TextureEntry {
+    unsigned int id;
+    int refCount;
+  };
+
+  EngineInterface *engine;
+  bool isSecure;
+  void* engineContext;
+  android::Mutex mutex;
+  std::map<int, unsigned int> programs;
+  std::map<TextureKey, TextureEntry> textures;
+
+  unsigned int acquireTexture(int dimensions, void *data, int sz, int dataSize);
+
+ public:
+  EngineCache(EngineInterface *engine, bool isSecure);
+  static EngineCache *getInstance(bool isSecure);
+
+  android::Mutex& getMutex() { return mutex; }
+  // Makes the domain context current, creating it on first use. Returns the caller context to be
+  // passed to unbind().
+  void* bind();
+  void unbind(void* callerContext);
+  unsigned int getProgram(int type, bool useXform);
+  unsigned int acquire3DTexture(void *data, int sz);
+  unsigned int acquire1DTexture(void *data, int sz);
+  void releaseTexture(unsigned int id);
+};
+
+#endif  //__TONEMAPPER_ENGINECACHE_H__
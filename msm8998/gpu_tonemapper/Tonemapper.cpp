@@ -19,16 +19,15 @@
 #include <utils/Log.h>
 
 #include "EGLImageWrapper.h"
+#include "EngineCache.h"
 #include "Tonemapper.h"
 #include "engine.h"
-#include "forward_tonemap.inl"
-#include "fullscreen_vertex_shader.inl"
-#include "rgba_inverse_tonemap.inl"
 
 //-----------------------------------------------------------------------------
 Tonemapper::Tonemapper()
 //-----------------------------------------------------------------------------
 {
+  engineCache = 0;
   tonemapTexture = 0;
   lutXformTexture = 0;
   programID = 0;
@@ -45,11 +44,11 @@ Tonemapper::Tonemapper()
 Tonemapper::~Tonemapper()
 //-----------------------------------------------------------------------------
 {
-  void* caller_context = engine_backup();
-  engine_bind(engineContext);
-  engine_deleteInputBuffer(tonemapTexture);
-  engine_deleteInputBuffer(lutXformTexture);
-  engine_deleteProgram(programID);
+  // the program and the domain context are kept by the cache for later tonemappers
+  android::Mutex::Autolock lock(engineCache->getMutex());
+  void* caller_context = engineCache->bind();
+  engineCache->releaseTexture(tonemapTexture);
+  engineCache->releaseTexture(lutXformTexture);
 
   // clear EGLImage mappings
   if (eglImageWrapper != 0) {
@@ -57,10 +56,8 @@ Tonemapper::~Tonemapper()
     eglImageWrapper = 0;
   }
 
-  engine_shutdown(engineContext);
   // restore the caller context
-  engine_bind(caller_context);
-  engine_free_backup(caller_context);
+  engineCache->unbind(caller_context);
 }
 
 //-----------------------------------------------------------------------------
@@ -76,18 +73,18 @@ Tonemapper *Tonemapper::build(int type, void *colorMap, int colorMapSize, void *
   // build new tonemapper
   Tonemapper *tonemapper = new Tonemapper();
 
-  tonemapper->engineContext = engine_initialize(isSecure);
+  tonemapper->engineCache = EngineCache::getInstance(isSecure);
 
-  void* caller_context = engine_backup();
-  engine_bind(tonemapper->engineContext);
+  android::Mutex::Autolock lock(tonemapper->engineCache->getMutex());
+  void* caller_context = tonemapper->engineCache->bind();
 
   // load the 3d lut
-  tonemapper->tonemapTexture = engine_load3DTexture(colorMap, colorMapSize, 0);
+  tonemapper->tonemapTexture = tonemapper->engineCache->acquire3DTexture(colorMap, colorMapSize);
   tonemapper->tonemapScaleOffset[0] = ((float)(colorMapSize-1))/((float)(colorMapSize));
   tonemapper->tonemapScaleOffset[1] = 1.0f/(2.0f*colorMapSize);
 
   // load the non-uniform xform
-  tonemapper->lutXformTexture = engine_load1DTexture(lutXform, lutXformSize, 0);
+  tonemapper->lutXformTexture = tonemapper->engineCache->acquire1DTexture(lutXform, lutXformSize);
   bool bUseXform = (tonemapper->lutXformTexture != 0) && (lutXformSize != 0);
   if( bUseXform )
   {
@@ -95,31 +92,11 @@ Tonemapper *Tonemapper::build(int type, void *colorMap, int colorMapSize, void *
       tonemapper->lutXformScaleOffset[1] = 1.0f/(2.0f*lutXformSize);
   }
 
-  // create the program
-  const char *fragmentShaders[3];
-  int fragmentShaderCount = 0;
-  const char *version = "#version 300 es\n";
-  const char *define = "#define USE_NONUNIFORM_SAMPLING\n";
-
-  fragmentShaders[fragmentShaderCount++] = version;
-
-  // non-uniform sampling
-  if (bUseXform) {
-    fragmentShaders[fragmentShaderCount++] = define;
-  }
-
-  if (type == TONEMAP_INVERSE) {  // inverse tonemapping
-    fragmentShaders[fragmentShaderCount++] = rgba_inverse_tonemap_shader;
-  } else {  // forward tonemapping
-    fragmentShaders[fragmentShaderCount++] = forward_tonemap_shader;
-  }
-
-  tonemapper->programID =
-      engine_loadProgram(1, &fullscreen_vertex_shader, fragmentShaderCount, fragmentShaders);
+  // get the program, compiled on first use of the variant
+  tonemapper->programID = tonemapper->engineCache->getProgram(type, bUseXform);
 
   // restore the caller context
-  engine_bind(caller_context);
-  engine_free_backup(caller_context);
+  tonemapper->engineCache->unbind(caller_context);
 
   return tonemapper;
 }
@@ -128,10 +105,10 @@ Tonemapper *Tonemapper::build(int type, void *colorMap, int colorMapSize, void *
 int Tonemapper::blit(const void *dst, const void *src, int srcFenceFd)
 //-----------------------------------------------------------------------------
 {
-  void* caller_context = engine_backup();
+  // the domain context is shared with tonemappers blitting from other threads
+  android::Mutex::Autolock lock(engineCache->getMutex());
   // make current
-  engine_bind(engineContext);
-
+  void* caller_context = engineCache->bind();
   // create eglimages if required
   EGLImageBuffer *dst_buffer = eglImageWrapper->wrap(dst);
   EGLImageBuffer *src_buffer = eglImageWrapper->wrap(src);
@@ -160,9 +137,7 @@ int Tonemapper::blit(const void *dst, const void *src, int srcFenceFd)
   int fenceFD = engine_blit(srcFenceFd);
 
   // restore the caller context
-  engine_bind(caller_context);
-  engine_free_backup(caller_context);
-
+  engineCache->unbind(caller_context);
 
   return fenceFD;
 }
@@ -24,11 +24,11 @@
 #define TONEMAP_INVERSE 1
 
 #include "EGLImageWrapper.h"
-#include "engine.h"
+#include "EngineCache.h"
 
 class Tonemapper {
  private:
-  void* engineContext;
+  EngineCache* engineCache;
   unsigned int tonemapTexture;
   unsigned int lutXformTexture;
   unsigned int programID;
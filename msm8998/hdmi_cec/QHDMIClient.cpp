@@ -48,10 +48,10 @@ void QHDMIClient::onHdmiHotplug(int connected)
     cec_hdmi_hotplug(mCtx, connected);
 }
 
-void QHDMIClient::onCECMessageRecieved(char *msg, ssize_t len)
+void QHDMIClient::onCECMessageRecieved(char *msg __unused, ssize_t len)
 {
-    ALOGD_IF(DEBUG, "%s: CEC message received len: %zd", __FUNCTION__, len);
-    cec_receive_message(mCtx, msg, len);
+    // The HAL reads cec/rd_msg itself, the composer doesn't forward messages
+    ALOGD_IF(DEBUG, "%s: Ignoring CEC message len: %zd", __FUNCTION__, len);
 }
 
 void QHDMIClient::registerClient(sp<QHDMIClient>& client)
@@ -32,8 +32,14 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/prctl.h>
+#include <unistd.h>
 
+#include <atomic>
 #include <cstdlib>
+#include <thread>
 
 #include <log/log.h>
 #include <utils/Trace.h>
@@ -48,6 +54,8 @@ const int NUM_HDMI_PORTS = 1;
 const int MAX_SYSFS_DATA = 128;
 const int MAX_CEC_FRAME_SIZE = 20;
 const int MAX_SEND_MESSAGE_RETRIES = 1;
+// Received frames waiting for the framework, a power of two
+const uint32_t RX_QUEUE_SIZE = 16;
 
 enum {
     LOGICAL_ADDRESS_SET   =  1,
@@ -66,8 +74,42 @@ enum {
     CEC_OFFSET_RETRANSMIT,
 };
 
+static const char *const cec_node_names[CEC_NODE_MAX] = {
+    "cec/enable",
+    "cec/logical_addr",
+    "cec/wr_msg",
+    "cec/rd_msg",
+    "connected",
+    "pa",
+};
+
+static const int cec_node_flags[CEC_NODE_MAX] = {
+    O_WRONLY,
+    O_WRONLY,
+    O_WRONLY,
+    O_RDONLY,
+    O_RDONLY,
+    O_RDONLY,
+};
+
+// Reads cec/rd_msg and hands parsed frames to the framework from another
+// thread, so that a slow callback does not hold back reading the driver.
+// The queue has a single producer (receive_thread) and a single consumer
+// (dispatch_thread).
+struct cec_rx_pipeline_t {
+    cec_message_t queue[RX_QUEUE_SIZE];
+    std::atomic<uint32_t> head{0};  // Next frame to deliver
+    std::atomic<uint32_t> tail{0};  // Next free slot
+    std::atomic<bool> exit{false};
+    uint32_t dropped = 0;
+    int exit_fd = -1;               // Wakes up the receive thread on close
+    int dispatch_fd = -1;           // Counts frames queued for dispatch
+    std::thread receive_thread;
+    std::thread dispatch_thread;
+};
+
 //Forward declarations
-static void cec_close_context(cec_context_t* ctx __unused);
+static void cec_close_context(cec_context_t* ctx);
 static int cec_enable(cec_context_t *ctx, int enable);
 static int cec_is_connected(const struct hdmi_cec_device* dev, int port_id);
 
@@ -86,38 +128,75 @@ static ssize_t read_node(const char *path, char *data)
     return err;
 }
 
-static ssize_t write_node(const char *path, const char *data, size_t len)
+static void cec_open_nodes(cec_context_t *ctx)
 {
-    ssize_t err = 0;
-    int fd = -1;
-    err = access(path, W_OK);
-    if (!err) {
-        fd = open(path, O_WRONLY);
-        errno = 0;
-        err = write(fd, data, len);
-        if (err < 0) {
-            err = -errno;
+    char path[MAX_PATH_LENGTH];
+    if (!ctx->fb_sysfs_path[0]) {
+        ALOGE("%s: No HDMI framebuffer node", __FUNCTION__);
+        return;
+    }
+    for (int node = 0; node < CEC_NODE_MAX; node++) {
+        snprintf(path, sizeof(path), "%s/%s", ctx->fb_sysfs_path,
+                cec_node_names[node]);
+        ctx->node_fd[node] = open(path, cec_node_flags[node] | O_CLOEXEC);
+        if (ctx->node_fd[node] < 0) {
+            ALOGE("%s: Failed to open %s error: %s", __FUNCTION__, path,
+                    strerror(errno));
+        }
+    }
+}
+
+static void cec_close_nodes(cec_context_t *ctx)
+{
+    for (int node = 0; node < CEC_NODE_MAX; node++) {
+        if (ctx->node_fd[node] >= 0) {
+            close(ctx->node_fd[node]);
+            ctx->node_fd[node] = -1;
         }
-        close(fd);
-    } else {
-        ALOGE("%s: Failed to access path: %s error: %s",
-                __FUNCTION__, path, strerror(errno));
-        err = -errno;
     }
+}
+
+// Reads at most len - 1 bytes of the node and null terminates them
+static ssize_t read_cec_node(cec_context_t *ctx, int node, char *data,
+        size_t len)
+{
+    memset(data, 0, len);
+    if (ctx->node_fd[node] < 0)
+        return -ENODEV;
+    ssize_t err = pread(ctx->node_fd[node], data, len - 1, 0);
+    if (err < 0)
+        err = -errno;
     return err;
 }
 
-// Helper function to write integer values to the full sysfs path
-static ssize_t write_int_to_node(cec_context_t *ctx,
-        const char *path_postfix,
+static ssize_t write_cec_node(cec_context_t *ctx, int node, const char *data,
+        size_t len)
+{
+    if (ctx->node_fd[node] < 0)
+        return -ENODEV;
+    ssize_t err = pwrite(ctx->node_fd[node], data, len, 0);
+    if (err < 0)
+        err = -errno;
+    return err;
+}
+
+// Helper function to write integer values to a sysfs node
+static ssize_t write_int_to_node(cec_context_t *ctx, int node,
         const int value)
 {
-    char sysfs_full_path[MAX_PATH_LENGTH];
     char sysfs_data[MAX_SYSFS_DATA];
     snprintf(sysfs_data, sizeof(sysfs_data), "%d",value);
-    snprintf(sysfs_full_path,sizeof(sysfs_full_path), "%s/%s",
-            ctx->fb_sysfs_path, path_postfix);
-    ssize_t err = write_node(sysfs_full_path, sysfs_data, strlen(sysfs_data));
+    ssize_t err = write_cec_node(ctx, node, sysfs_data, strlen(sysfs_data));
+    return err;
+}
+
+// The driver holds a single logical address, only changes are written
+static ssize_t cec_set_driver_logical_address(cec_context_t *ctx, int addr)
+{
+    if (ctx->driver_logical_address == addr)
+        return 0;
+    ssize_t err = write_int_to_node(ctx, CEC_NODE_LOGICAL_ADDR, addr);
+    ctx->driver_logical_address = err < 0 ? -1 : addr;
     return err;
 }
 
@@ -175,9 +254,9 @@ static int cec_add_logical_address(const struct hdmi_cec_device* dev,
 
     //XXX: We can get multiple logical addresses here but we can only send one
     //to the driver. Store locally for now
-    ssize_t err = write_int_to_node(ctx, "cec/logical_addr", addr);
+    ssize_t err = cec_set_driver_logical_address(ctx, addr);
     ALOGI("%s: Allocated logical address: %d ", __FUNCTION__, addr);
-    return (int) err;
+    return err < 0 ? (int) err : 0;
 }
 
 static void cec_clear_logical_address(const struct hdmi_cec_device* dev)
@@ -186,7 +265,7 @@ static void cec_clear_logical_address(const struct hdmi_cec_device* dev)
     memset(ctx->logical_address, LOGICAL_ADDRESS_UNSET,
             sizeof(ctx->logical_address));
     //XXX: Find logical_addr that needs to be reset
-    write_int_to_node(ctx, "cec/logical_addr", 15);
+    cec_set_driver_logical_address(ctx, 15);
     ALOGD_IF(DEBUG, "%s: Cleared logical addresses", __FUNCTION__);
 }
 
@@ -194,11 +273,8 @@ static int cec_get_physical_address(const struct hdmi_cec_device* dev,
         uint16_t* addr)
 {
     cec_context_t* ctx = (cec_context_t*)(dev);
-    char pa_path[MAX_PATH_LENGTH];
     char pa_data[MAX_SYSFS_DATA];
-    snprintf (pa_path, sizeof(pa_path),"%s/pa",
-            ctx->fb_sysfs_path);
-    int err = (int) read_node(pa_path, pa_data);
+    int err = (int) read_cec_node(ctx, CEC_NODE_PA, pa_data, sizeof(pa_data));
     *addr = (uint16_t) atoi(pa_data);
     ALOGD_IF(DEBUG, "%s: Physical Address: 0x%x", __FUNCTION__, *addr);
     if (err < 0)
@@ -226,7 +302,6 @@ static int cec_send_message(const struct hdmi_cec_device* dev,
         ALOGD_IF(DEBUG, "%s: message from framework: %s", __FUNCTION__, dump);
     }
 
-    char write_msg_path[MAX_PATH_LENGTH];
     char write_msg[MAX_CEC_FRAME_SIZE];
     memset(write_msg, 0, sizeof(write_msg));
     // See definition of struct hdmi_cec_msg in driver code
@@ -245,13 +320,11 @@ static int cec_send_message(const struct hdmi_cec_device* dev,
     write_msg[CEC_OFFSET_FRAME_LENGTH] = (unsigned char) (msg->length + 1);
     hex_to_string(write_msg, sizeof(write_msg), dump);
     ALOGD_IF(DEBUG, "%s: message to driver: %s", __FUNCTION__, dump);
-    snprintf(write_msg_path, sizeof(write_msg_path), "%s/cec/wr_msg",
-            ctx->fb_sysfs_path);
     int retry_count = 0;
     ssize_t err = 0;
     //HAL spec requires us to retry at least once.
     while (true) {
-        err = write_node(write_msg_path, write_msg, sizeof(write_msg));
+        err = write_cec_node(ctx, CEC_NODE_WR_MSG, write_msg, sizeof(write_msg));
         retry_count++;
         if (err == -EAGAIN && retry_count <= MAX_SEND_MESSAGE_RETRIES) {
             ALOGE("%s: CEC line busy, retrying", __FUNCTION__);
@@ -281,31 +354,168 @@ static int cec_send_message(const struct hdmi_cec_device* dev,
     }
 }
 
-void cec_receive_message(cec_context_t *ctx, char *msg, ssize_t len)
+static bool cec_parse_message(cec_context_t *ctx, const char *msg, ssize_t len,
+        hdmi_event_t *event)
+{
+    char dump[128];
+    if(len <= CEC_OFFSET_FRAME_LENGTH || msg[CEC_OFFSET_FRAME_LENGTH] < 1) {
+        ALOGE("%s: Invalid frame from driver, len: %zd", __FUNCTION__, len);
+        return false;
+    }
+
+    hex_to_string(msg, len, dump);
+    ALOGD_IF(DEBUG, "%s: Message from driver: %s", __FUNCTION__, dump);
+
+    event->type = HDMI_EVENT_CEC_MESSAGE;
+    event->dev = (hdmi_cec_device *) ctx;
+    // Remove initiator/destination from this calculation
+    event->cec.length = msg[CEC_OFFSET_FRAME_LENGTH] - 1;
+    event->cec.initiator = (cec_logical_address_t) msg[CEC_OFFSET_SENDER_ID];
+    event->cec.destination = (cec_logical_address_t) msg[CEC_OFFSET_RECEIVER_ID];
+    //Copy opcode and operand
+    size_t copy_size = event->cec.length > sizeof(event->cec.body) ?
+                       sizeof(event->cec.body) : event->cec.length;
+    memcpy(event->cec.body, &msg[CEC_OFFSET_OPCODE],copy_size);
+    hex_to_string((char *) event->cec.body, copy_size, dump);
+    ALOGD_IF(DEBUG, "%s: Message to framework: %s", __FUNCTION__, dump);
+    return true;
+}
+
+static void cec_queue_message(cec_context_t *ctx, const char *msg, ssize_t len)
 {
-    if(!ctx->system_control)
+    cec_rx_pipeline_t *rx = ctx->rx;
+    hdmi_event_t event;
+    if(!cec_parse_message(ctx, msg, len, &event))
         return;
 
-    char dump[128];
-    if(len > 0) {
-        hex_to_string(msg, len, dump);
-        ALOGD_IF(DEBUG, "%s: Message from driver: %s", __FUNCTION__, dump);
+    uint32_t tail = rx->tail.load(std::memory_order_relaxed);
+    if(tail - rx->head.load(std::memory_order_acquire) == RX_QUEUE_SIZE) {
+        rx->dropped++;
+        ALOGW("%s: Queue full, dropped %u messages", __FUNCTION__,
+                rx->dropped);
+        return;
     }
+    rx->queue[tail & (RX_QUEUE_SIZE - 1)] = event.cec;
+    rx->tail.store(tail + 1, std::memory_order_release);
+
+    uint64_t count = 1;
+    if(write(rx->dispatch_fd, &count, sizeof(count)) != sizeof(count)) {
+        ALOGE("%s: Failed to wake up dispatch thread: %s", __FUNCTION__,
+                strerror(errno));
+    }
+}
 
+static void cec_receive_thread(cec_context_t *ctx)
+{
+    cec_rx_pipeline_t *rx = ctx->rx;
+    char data[MAX_SYSFS_DATA];
+    struct pollfd fds[2] = {};
+    fds[0].fd = ctx->node_fd[CEC_NODE_RD_MSG];
+    fds[0].events = POLLPRI | POLLERR;
+    fds[1].fd = rx->exit_fd;
+    fds[1].events = POLLIN;
+
+    prctl(PR_SET_NAME, "cec_receive", 0, 0, 0);
+
+    // sysfs_notify is only seen after a read of the node, clear any existing
+    // data as the composer does
+    ssize_t len = read_cec_node(ctx, CEC_NODE_RD_MSG, data, sizeof(data));
+
+    while(!rx->exit) {
+        if(poll(fds, 2, -1) < 0) {
+            if(errno == EINTR)
+                continue;
+            ALOGE("%s: poll failed: %s", __FUNCTION__, strerror(errno));
+            break;
+        }
+
+        if(fds[1].revents & POLLIN)
+            break;
+
+        if(fds[0].revents & (POLLPRI | POLLERR)) {
+            len = read_cec_node(ctx, CEC_NODE_RD_MSG, data, sizeof(data));
+            if(len > 0)
+                cec_queue_message(ctx, data, len);
+        }
+    }
+}
+
+static void cec_dispatch_thread(cec_context_t *ctx)
+{
+    cec_rx_pipeline_t *rx = ctx->rx;
+    uint64_t count = 0;
     hdmi_event_t event;
     event.type = HDMI_EVENT_CEC_MESSAGE;
     event.dev = (hdmi_cec_device *) ctx;
-    // Remove initiator/destination from this calculation
-    event.cec.length = msg[CEC_OFFSET_FRAME_LENGTH] - 1;
-    event.cec.initiator = (cec_logical_address_t) msg[CEC_OFFSET_SENDER_ID];
-    event.cec.destination = (cec_logical_address_t) msg[CEC_OFFSET_RECEIVER_ID];
-    //Copy opcode and operand
-    size_t copy_size = event.cec.length > sizeof(event.cec.body) ?
-                       sizeof(event.cec.body) : event.cec.length;
-    memcpy(event.cec.body, &msg[CEC_OFFSET_OPCODE],copy_size);
-    hex_to_string((char *) event.cec.body, copy_size, dump);
-    ALOGD_IF(DEBUG, "%s: Message to framework: %s", __FUNCTION__, dump);
-    ctx->callback.callback_func(&event, ctx->callback.callback_arg);
+
+    prctl(PR_SET_NAME, "cec_dispatch", 0, 0, 0);
+
+    while(read(rx->dispatch_fd, &count, sizeof(count)) == sizeof(count) &&
+            !rx->exit) {
+        uint32_t head = rx->head.load(std::memory_order_relaxed);
+        uint32_t tail = rx->tail.load(std::memory_order_acquire);
+        while(head != tail) {
+            event.cec = rx->queue[head & (RX_QUEUE_SIZE - 1)];
+            rx->head.store(++head, std::memory_order_release);
+            if(ctx->system_control && ctx->callback.callback_func)
+                ctx->callback.callback_func(&event, ctx->callback.callback_arg);
+        }
+    }
+}
+
+static void cec_start_receive(cec_context_t *ctx)
+{
+    // The composer does not read cec/rd_msg, the HAL is its only reader
+    if(ctx->node_fd[CEC_NODE_RD_MSG] < 0) {
+        ALOGE("%s: cec/rd_msg is not available, can't receive CEC messages",
+                __FUNCTION__);
+        return;
+    }
+
+    cec_rx_pipeline_t *rx = new cec_rx_pipeline_t();
+    rx->exit_fd = eventfd(0, EFD_CLOEXEC);
+    rx->dispatch_fd = eventfd(0, EFD_CLOEXEC);
+    if(rx->exit_fd < 0 || rx->dispatch_fd < 0) {
+        ALOGE("%s: Failed to create eventfds: %s", __FUNCTION__,
+                strerror(errno));
+        if(rx->exit_fd >= 0)
+            close(rx->exit_fd);
+        if(rx->dispatch_fd >= 0)
+            close(rx->dispatch_fd);
+        delete rx;
+        return;
+    }
+
+    ctx->rx = rx;
+    rx->dispatch_thread = std::thread(cec_dispatch_thread, ctx);
+    rx->receive_thread = std::thread(cec_receive_thread, ctx);
+}
+
+static void cec_stop_receive(cec_context_t *ctx)
+{
+    cec_rx_pipeline_t *rx = ctx->rx;
+    if(!rx)
+        return;
+
+    uint64_t count = 1;
+    rx->exit = true;
+    // Wake up each thread on its own so that a failure on one fd does not
+    // leave the other thread blocked in join below
+    if(write(rx->exit_fd, &count, sizeof(count)) != sizeof(count)) {
+        ALOGE("%s: Failed to wake up receive thread: %s", __FUNCTION__,
+                strerror(errno));
+    }
+    if(write(rx->dispatch_fd, &count, sizeof(count)) != sizeof(count)) {
+        ALOGE("%s: Failed to wake up dispatch thread: %s", __FUNCTION__,
+                strerror(errno));
+    }
+    rx->receive_thread.join();
+    rx->dispatch_thread.join();
+
+    close(rx->exit_fd);
+    close(rx->dispatch_fd);
+    ctx->rx = NULL;
+    delete rx;
 }
 
 void cec_hdmi_hotplug(cec_context_t *ctx, int connected)
@@ -387,11 +597,9 @@ static int cec_is_connected(const struct hdmi_cec_device* dev, int port_id)
     // Ignore port_id since we have only one port
     int connected = 0;
     cec_context_t* ctx = (cec_context_t*)(dev);
-    char connected_path[MAX_PATH_LENGTH];
     char connected_data[MAX_SYSFS_DATA];
-    snprintf (connected_path, sizeof(connected_path),"%s/connected",
-            ctx->fb_sysfs_path);
-    ssize_t err = read_node(connected_path, connected_data);
+    ssize_t err = read_cec_node(ctx, CEC_NODE_CONNECTED, connected_data,
+            sizeof(connected_data));
     connected = atoi(connected_data);
 
     ALOGD_IF(DEBUG, "%s: HDMI at port %d is - %s", __FUNCTION__, port_id,
@@ -420,7 +628,7 @@ static int cec_enable(cec_context_t *ctx, int enable)
     ssize_t err;
     // Enable CEC
     int value = enable ? 0x3 : 0x0;
-    err = write_int_to_node(ctx, "cec/enable", value);
+    err = write_int_to_node(ctx, CEC_NODE_ENABLE, value);
     if(err < 0) {
         ALOGE("%s: Failed to toggle CEC: enable: %d",
                 __FUNCTION__, enable);
@@ -433,7 +641,11 @@ static int cec_enable(cec_context_t *ctx, int enable)
 static void cec_init_context(cec_context_t *ctx)
 {
     ALOGD_IF(DEBUG, "%s: Initializing context", __FUNCTION__);
+    for (int node = 0; node < CEC_NODE_MAX; node++)
+        ctx->node_fd[node] = -1;
+    ctx->driver_logical_address = -1;
     cec_get_fb_node_number(ctx);
+    cec_open_nodes(ctx);
 
     //Initialize ports - We support only one output port
     ctx->port_info = new hdmi_port_info[NUM_HDMI_PORTS];
@@ -454,15 +666,20 @@ static void cec_init_context(cec_context_t *ctx)
     ctx->disp_client->setCECContext(ctx);
     ctx->disp_client->registerClient(ctx->disp_client);
 
+    //Start reading before enabling CEC so that no message is missed
+    cec_start_receive(ctx);
+
     //Enable CEC - framework expects it to be enabled by default
     cec_enable(ctx, true);
 
     ALOGD("%s: CEC enabled", __FUNCTION__);
 }
 
-static void cec_close_context(cec_context_t* ctx __unused)
+static void cec_close_context(cec_context_t* ctx)
 {
     ALOGD("%s: Closing context", __FUNCTION__);
+    cec_stop_receive(ctx);
+    cec_close_nodes(ctx);
 }
 
 static int cec_device_open(const struct hw_module_t* module,
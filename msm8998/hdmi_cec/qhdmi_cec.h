@@ -41,6 +41,19 @@ namespace qhdmicec {
 #define SYSFS_BASE  "/sys/class/graphics/fb"
 #define MAX_PATH_LENGTH  128
 
+// Sysfs nodes of the HDMI framebuffer, opened once the node is found
+enum {
+    CEC_NODE_ENABLE,
+    CEC_NODE_LOGICAL_ADDR,
+    CEC_NODE_WR_MSG,
+    CEC_NODE_RD_MSG,
+    CEC_NODE_CONNECTED,
+    CEC_NODE_PA,
+    CEC_NODE_MAX,
+};
+
+struct cec_rx_pipeline_t;
+
 struct cec_callback_t {
     // Function in HDMI service to call back on CEC messages
     event_callback_t callback_func;
@@ -65,9 +78,12 @@ struct cec_context_t {
     int version;
     uint32_t vendor_id;
     android::sp<qClient::QHDMIClient> disp_client;
+
+    int node_fd[CEC_NODE_MAX];   // Persistent descriptors of the sysfs nodes
+    int driver_logical_address;  // Logical address last written to the driver
+    cec_rx_pipeline_t *rx;       // Reads cec/rd_msg, NULL if it can't be set up
 };
 
-void cec_receive_message(cec_context_t *ctx, char *msg, ssize_t len);
 void cec_hdmi_hotplug(cec_context_t *ctx, int connected);
 
 }; //namespace
@@ -29,7 +29,6 @@
 
 #include <errno.h>
 #include <fcntl.h>
-#include <sys/stat.h>
 #include <unistd.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
@@ -39,6 +38,7 @@
 #include <drm/msm_drm.h>
 #include <algorithm>
 #include <iterator>
+#include <tuple>
 
 #include "drm_master.h"
 
@@ -50,6 +50,9 @@ using std::begin;
 using std::copy;
 using std::end;
 using std::fill;
+using std::equal;
+using std::lexicographical_compare;
+using std::tie;
 
 namespace drm_utils {
 
@@ -94,12 +97,55 @@ DRMMaster::~DRMMaster() {
   dev_fd_ = -1;
 }
 
+bool DRMMaster::FbKey::operator<(const FbKey &other) const {
+  auto lhs = tie(gem_handle, width, height, drm_format, drm_format_modifier, num_planes);
+  auto rhs = tie(other.gem_handle, other.width, other.height, other.drm_format,
+                 other.drm_format_modifier, other.num_planes);
+  if (lhs != rhs) {
+    return lhs < rhs;
+  }
+
+  if (!equal(begin(stride), end(stride), begin(other.stride))) {
+    return lexicographical_compare(begin(stride), end(stride), begin(other.stride),
+                                   end(other.stride));
+  }
+
+  return lexicographical_compare(begin(offset), end(offset), begin(other.offset),
+                                 end(other.offset));
+}
+
 int DRMMaster::CreateFbId(const DRMBuffer &drm_buffer, uint32_t *gem_handle, uint32_t *fb_id) {
+  lock_guard<mutex> obj(fb_lock_);
+
+  // PRIME returns the handle already open for the dma-buf, which identifies the buffer across fds
+  // for as long as the handle stays open.
   int ret = drmPrimeFDToHandle(dev_fd_, drm_buffer.fd, gem_handle);
   if (ret) {
     DRM_LOGE("drmPrimeFDToHandle failed with error %d", ret);
     return ret;
   }
+  stats_.gem_imports++;
+
+  FbKey key = {};
+  key.gem_handle = *gem_handle;
+  key.width = drm_buffer.width;
+  key.height = drm_buffer.height;
+  key.drm_format = drm_buffer.drm_format;
+  key.drm_format_modifier = drm_buffer.drm_format_modifier;
+  copy(begin(drm_buffer.stride), end(drm_buffer.stride), begin(key.stride));
+  copy(begin(drm_buffer.offset), end(drm_buffer.offset), begin(key.offset));
+  key.num_planes = drm_buffer.num_planes;
+
+  auto fb = fb_ids_.find(key);
+  if (fb != fb_ids_.end()) {
+    fbs_[fb->second].ref_count++;
+    *fb_id = fb->second;
+    stats_.gem_reuses++;
+    stats_.fb_reuses++;
+    return 0;
+  }
+
+  AcquireGemHandle(*gem_handle);
 
   struct drm_mode_fb_cmd2 cmd2 {};
   cmd2.width = drm_buffer.width;
@@ -114,40 +160,94 @@ int DRMMaster::CreateFbId(const DRMBuffer &drm_buffer, uint32_t *gem_handle, uin
 
   if ((ret = drmIoctl(dev_fd_, DRM_IOCTL_MODE_ADDFB2, &cmd2))) {
     DRM_LOGE("DRM_IOCTL_MODE_ADDFB2 failed with error %d", ret);
-    struct drm_gem_close gem_close = {};
-    gem_close.handle = *gem_handle;
-    int ret1 = drmIoctl(dev_fd_, DRM_IOCTL_GEM_CLOSE, &gem_close);
-    if (ret1) {
-      DRM_LOGE("drmIoctl::DRM_IOCTL_GEM_CLOSE failed with error %d", ret1);
-      return ret1;
-    }
+    ReleaseGemHandle(*gem_handle);
     return ret;
   }
+  stats_.fb_adds++;
+
+  FbEntry entry = {};
+  entry.key = key;
+  entry.ref_count = 1;
+  fbs_[cmd2.fb_id] = entry;
+  fb_ids_[key] = cmd2.fb_id;
 
   *fb_id = cmd2.fb_id;
   return 0;
 }
 
-int DRMMaster::RemoveFbId(uint32_t gem_handle, uint32_t fb_id) {
+void DRMMaster::AcquireGemHandle(uint32_t gem_handle) {
+  GemEntry &entry = gem_handles_[gem_handle];
+  if (entry.ref_count) {
+    // Another fb of the same dma-buf uses the handle, a GEM_CLOSE for either of them would pull
+    // it from under the other.
+    stats_.gem_reuses++;
+  }
+  entry.handle = gem_handle;
+  entry.ref_count++;
+}
+
+void DRMMaster::ReleaseGemHandle(uint32_t gem_handle) {
+  auto gem = gem_handles_.find(gem_handle);
+  if (gem != gem_handles_.end() && --gem->second.ref_count) {
+    return;
+  }
+
   struct drm_gem_close gem_close = {};
   gem_close.handle = gem_handle;
   int ret = drmIoctl(dev_fd_, DRM_IOCTL_GEM_CLOSE, &gem_close);
   if (ret) {
     DRM_LOGE("drmIoctl::DRM_IOCTL_GEM_CLOSE failed with error %d", errno);
   }
+  stats_.gem_closes++;
+  if (gem != gem_handles_.end()) {
+    gem_handles_.erase(gem);
+  }
+}
+
+int DRMMaster::RemoveFbId(uint32_t gem_handle, uint32_t fb_id) {
+  lock_guard<mutex> obj(fb_lock_);
+
+  auto fb = fbs_.find(fb_id);
+  if (fb == fbs_.end()) {
+    DRM_LOGE("Unknown fb_id %d", fb_id);
+    return -EINVAL;
+  }
+
+  if (fb->second.key.gem_handle != gem_handle) {
+    DRM_LOGW("GEM handle %d does not match fb_id %d", gem_handle, fb_id);
+  }
+
+  if (--fb->second.ref_count) {
+    return 0;
+  }
 
 #ifdef DRM_IOCTL_MSM_RMFB2
-  ret = drmIoctl(dev_fd_, DRM_IOCTL_MSM_RMFB2, &fb_id);
+  int ret = drmIoctl(dev_fd_, DRM_IOCTL_MSM_RMFB2, &fb_id);
   if (ret) {
     DRM_LOGE("drmIoctl::DRM_IOCTL_MSM_RMFB2 failed for fb_id %d with error %d", fb_id, errno);
   }
 #else
-  ret = drmModeRmFB(dev_fd_, fb_id);
+  int ret = drmModeRmFB(dev_fd_, fb_id);
   if (ret) {
     DRM_LOGE("drmModeRmFB failed for fb_id %d with error %d", fb_id, ret);
   }
 #endif
-  return ret;
+  stats_.fb_removes++;
+
+  // The GEM handle goes after the last fb using it
+  uint32_t fb_gem_handle = fb->second.key.gem_handle;
+  fb_ids_.erase(fb->second.key);
+  fbs_.erase(fb);
+  ReleaseGemHandle(fb_gem_handle);
+
+  return 0;
+}
+
+void DRMMaster::GetFbStats(DRMFbStats *stats) {
+  lock_guard<mutex> obj(fb_lock_);
+  *stats = stats_;
+  stats->gem_handles = static_cast<uint32_t>(gem_handles_.size());
+  stats->fbs = static_cast<uint32_t>(fbs_.size());
 }
 
 }  // namespace drm_utils
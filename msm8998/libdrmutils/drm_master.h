@@ -30,6 +30,7 @@
 #ifndef __DRM_MASTER_H__
 #define __DRM_MASTER_H__
 
+#include <map>
 #include <mutex>
 
 #include "drm_logger.h"
@@ -47,25 +48,46 @@ struct DRMBuffer {
   uint32_t num_planes = 1;
 };
 
+struct DRMFbStats {
+  uint64_t gem_imports = 0;  // drmPrimeFDToHandle calls
+  uint64_t gem_reuses = 0;   // Imports which returned an already open GEM handle
+  uint64_t gem_closes = 0;   // DRM_IOCTL_GEM_CLOSE calls
+  uint64_t fb_adds = 0;      // DRM_IOCTL_MODE_ADDFB2 calls
+  uint64_t fb_reuses = 0;    // CreateFbId calls served by an existing fb
+  uint64_t fb_removes = 0;   // RmFB calls
+  uint32_t gem_handles = 0;  // Currently open GEM handles
+  uint32_t fbs = 0;          // Currently added fbs
+};
+
 class DRMMaster {
  public:
   ~DRMMaster();
   /* Converts from ION fd --> Prime Handle --> FB_ID.
+   * GEM handles are shared by all fbs of the same dma-buf, and an fb identical to a live one is
+   * shared instead of added again. Each successful call must be paired with a RemoveFbId.
    * Input:
    *   drm_buffer: A DRMBuffer obj that packages description of buffer
    * Output:
+   *   gem_handle: Pointer to store the GEM handle of the buffer into
    *   fb_id: Pointer to store DRM framebuffer id into
    * Returns:
    *   ioctl error code
    */
   int CreateFbId(const DRMBuffer &drm_buffer, uint32_t *gem_handle, uint32_t *fb_id);
-  /* Removes the fb_id from DRM
+  /* Releases a reference to the fb_id. The last reference removes the fb from DRM, and the GEM
+   * handle too once no other fb uses it.
    * Input:
+   *   gem_handle: GEM handle returned along with the fb_id
    *   fb_id: DRM FB to be removed
    * Returns:
-   *   ioctl error code
+   *   -EINVAL if the fb_id is not known, 0 otherwise
    */
   int RemoveFbId(uint32_t gem_handle, uint32_t fb_id);
+  /* Populates the fb and GEM handle counters
+   * Input:
+   *   stats: Pointer to store the counters into
+   */
+  void GetFbStats(DRMFbStats *stats);
   /* Poplulates master DRM fd
    * Input:
    *   fd: Pointer to store master fd into
@@ -82,10 +104,39 @@ class DRMMaster {
   static void DestroyInstance();
 
  private:
+  struct GemEntry {
+    uint32_t handle = 0;
+    uint32_t ref_count = 0;  // Fbs using the handle
+  };
+
+  struct FbKey {
+    uint32_t gem_handle = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t drm_format = 0;
+    uint64_t drm_format_modifier = 0;
+    uint32_t stride[4] = {};
+    uint32_t offset[4] = {};
+    uint32_t num_planes = 0;
+    bool operator<(const FbKey &other) const;
+  };
+
+  struct FbEntry {
+    FbKey key;
+    uint32_t ref_count = 0;  // CreateFbId calls not yet paired with RemoveFbId
+  };
+
   DRMMaster() {}
   int Init();
+  void AcquireGemHandle(uint32_t gem_handle);
+  void ReleaseGemHandle(uint32_t gem_handle);
 
   int dev_fd_ = -1;              // Master fd for DRM
+  std::mutex fb_lock_;
+  std::map<uint32_t, GemEntry> gem_handles_;  // Open GEM handles
+  std::map<FbKey, uint32_t> fb_ids_;
+  std::map<uint32_t, FbEntry> fbs_;           // fb_id to fb
+  DRMFbStats stats_ = {};
   static DRMMaster *s_instance;  // Singleton instance
   static std::mutex s_lock;
 };
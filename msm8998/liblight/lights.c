@@ -41,11 +41,37 @@
 /******************************************************************************/
 
 static pthread_once_t g_init = PTHREAD_ONCE_INIT;
-static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+// Each light only contends with updates of the same light. The battery,
+// notification and attention lights all drive the speaker LED.
+static pthread_mutex_t g_backlight_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t g_speaker_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t g_buttons_lock = PTHREAD_MUTEX_INITIALIZER;
 static struct light_state_t g_notification;
 static struct light_state_t g_battery;
 static int g_last_backlight_mode = BRIGHTNESS_MODE_USER;
 static int g_attention = 0;
+// Backlight coalescing, see set_light_backlight()
+static int g_backlight_pending = 0;
+static int g_backlight_dirty = 0;
+static int g_backlight_writing = 0;
+
+enum {
+    RED_LED,
+    GREEN_LED,
+    BLUE_LED,
+    RED_BLINK,
+    GREEN_BLINK,
+    BLUE_BLINK,
+    LCD,
+    BUTTON,
+    PERSISTENCE,
+    NUM_LIGHT_FILES,
+};
+
+// Opened once and kept for the lifetime of the process
+static char const* g_paths[NUM_LIGHT_FILES];
+static int g_fds[NUM_LIGHT_FILES];
+static int g_warned[NUM_LIGHT_FILES];
 
 char const*const RED_LED_FILE
         = "/sys/class/leds/red/brightness";
@@ -83,30 +109,50 @@ char const*const PERSISTENCE_FILE
 
 void init_globals(void)
 {
-    // init the mutex
-    pthread_mutex_init(&g_lock, NULL);
+    int i;
+
+    g_paths[RED_LED] = RED_LED_FILE;
+    g_paths[GREEN_LED] = GREEN_LED_FILE;
+    g_paths[BLUE_LED] = BLUE_LED_FILE;
+    g_paths[RED_BLINK] = RED_BLINK_FILE;
+    g_paths[GREEN_BLINK] = GREEN_BLINK_FILE;
+    g_paths[BLUE_BLINK] = BLUE_BLINK_FILE;
+    g_paths[LCD] = access(LCD_FILE, F_OK) ? LCD_FILE2 : LCD_FILE;
+    g_paths[BUTTON] = BUTTON_FILE;
+    g_paths[PERSISTENCE] = PERSISTENCE_FILE;
+
+    // Nodes missing here are retried on first write
+    for (i = 0; i < NUM_LIGHT_FILES; i++) {
+        g_fds[i] = open(g_paths[i], O_WRONLY | O_CLOEXEC);
+    }
 }
 
+/*
+ * Writes value to the light file. Must be called with the lock of the light
+ * owning the file held, except for LCD which is owned by the backlight writer.
+ */
 static int
-write_int(char const* path, int value)
+write_int(int file, int value)
 {
-    int fd;
-    static int already_warned = 0;
-
-    fd = open(path, O_RDWR);
-    if (fd >= 0) {
-        char buffer[20];
-        int bytes = snprintf(buffer, sizeof(buffer), "%d\n", value);
-        ssize_t amt = write(fd, buffer, (size_t)bytes);
-        close(fd);
-        return amt == -1 ? -errno : 0;
-    } else {
-        if (already_warned == 0) {
-            ALOGE("write_int failed to open %s\n", path);
-            already_warned = 1;
+    char buffer[20];
+    int bytes;
+    ssize_t amt;
+
+    if (g_fds[file] < 0) {
+        g_fds[file] = open(g_paths[file], O_WRONLY | O_CLOEXEC);
+        if (g_fds[file] < 0) {
+            int err = -errno;
+            if (g_warned[file] == 0) {
+                ALOGE("write_int failed to open %s\n", g_paths[file]);
+                g_warned[file] = 1;
+            }
+            return err;
         }
-        return -errno;
     }
+
+    bytes = snprintf(buffer, sizeof(buffer), "%d\n", value);
+    amt = pwrite(g_fds[file], buffer, (size_t)bytes, 0);
+    return amt == -1 ? -errno : 0;
 }
 
 static int
@@ -135,14 +181,14 @@ set_light_backlight(struct light_device_t* dev,
         return -1;
     }
 
-    pthread_mutex_lock(&g_lock);
+    pthread_mutex_lock(&g_backlight_lock);
     // Toggle low persistence mode state
     if ((g_last_backlight_mode != state->brightnessMode && lpEnabled) ||
         (!lpEnabled &&
          g_last_backlight_mode == BRIGHTNESS_MODE_LOW_PERSISTENCE)) {
-        if ((err = write_int(PERSISTENCE_FILE, lpEnabled)) != 0) {
+        if ((err = write_int(PERSISTENCE, lpEnabled)) != 0) {
             ALOGE("%s: Failed to write to %s: %s\n", __FUNCTION__,
-                   PERSISTENCE_FILE, strerror(errno));
+                   PERSISTENCE_FILE, strerror(-err));
         }
         if (lpEnabled != 0) {
             brightness = DEFAULT_LOW_PERSISTENCE_MODE_BRIGHTNESS;
@@ -151,15 +197,35 @@ set_light_backlight(struct light_device_t* dev,
 
     g_last_backlight_mode = state->brightnessMode;
 
-    if (!err) {
-        if (!access(LCD_FILE, F_OK)) {
-            err = write_int(LCD_FILE, brightness);
-        } else {
-            err = write_int(LCD_FILE2, brightness);
-        }
+    if (err) {
+        pthread_mutex_unlock(&g_backlight_lock);
+        return err;
+    }
+
+    /*
+     * Latest value wins. Brightness ramps arrive faster than the panel
+     * applies them, so a caller finding a write in flight only leaves its
+     * value behind for that writer to apply next, dropping any value it
+     * replaces. The write itself happens outside the lock.
+     */
+    g_backlight_pending = brightness;
+    g_backlight_dirty = 1;
+    if (g_backlight_writing) {
+        pthread_mutex_unlock(&g_backlight_lock);
+        return 0;
+    }
+
+    g_backlight_writing = 1;
+    while (g_backlight_dirty && !err) {
+        brightness = g_backlight_pending;
+        g_backlight_dirty = 0;
+        pthread_mutex_unlock(&g_backlight_lock);
+        err = write_int(LCD, brightness);
+        pthread_mutex_lock(&g_backlight_lock);
     }
+    g_backlight_writing = 0;
 
-    pthread_mutex_unlock(&g_lock);
+    pthread_mutex_unlock(&g_backlight_lock);
     return err;
 }
 
@@ -216,21 +282,21 @@ set_speaker_light_locked(struct light_device_t* dev,
 
     if (blink) {
         if (red) {
-            if (write_int(RED_BLINK_FILE, blink))
-                write_int(RED_LED_FILE, 0);
+            if (write_int(RED_BLINK, blink))
+                write_int(RED_LED, 0);
 	}
         if (green) {
-            if (write_int(GREEN_BLINK_FILE, blink))
-                write_int(GREEN_LED_FILE, 0);
+            if (write_int(GREEN_BLINK, blink))
+                write_int(GREEN_LED, 0);
 	}
         if (blue) {
-            if (write_int(BLUE_BLINK_FILE, blink))
-                write_int(BLUE_LED_FILE, 0);
+            if (write_int(BLUE_BLINK, blink))
+                write_int(BLUE_LED, 0);
 	}
     } else {
-        write_int(RED_LED_FILE, red);
-        write_int(GREEN_LED_FILE, green);
-        write_int(BLUE_LED_FILE, blue);
+        write_int(RED_LED, red);
+        write_int(GREEN_LED, green);
+        write_int(BLUE_LED, blue);
     }
 
     return 0;
@@ -250,10 +316,10 @@ static int
 set_light_battery(struct light_device_t* dev,
         struct light_state_t const* state)
 {
-    pthread_mutex_lock(&g_lock);
+    pthread_mutex_lock(&g_speaker_lock);
     g_battery = *state;
     handle_speaker_battery_locked(dev);
-    pthread_mutex_unlock(&g_lock);
+    pthread_mutex_unlock(&g_speaker_lock);
     return 0;
 }
 
@@ -261,10 +327,10 @@ static int
 set_light_notifications(struct light_device_t* dev,
         struct light_state_t const* state)
 {
-    pthread_mutex_lock(&g_lock);
+    pthread_mutex_lock(&g_speaker_lock);
     g_notification = *state;
     handle_speaker_battery_locked(dev);
-    pthread_mutex_unlock(&g_lock);
+    pthread_mutex_unlock(&g_speaker_lock);
     return 0;
 }
 
@@ -272,14 +338,14 @@ static int
 set_light_attention(struct light_device_t* dev,
         struct light_state_t const* state)
 {
-    pthread_mutex_lock(&g_lock);
+    pthread_mutex_lock(&g_speaker_lock);
     if (state->flashMode == LIGHT_FLASH_HARDWARE) {
         g_attention = state->flashOnMS;
     } else if (state->flashMode == LIGHT_FLASH_NONE) {
         g_attention = 0;
     }
     handle_speaker_battery_locked(dev);
-    pthread_mutex_unlock(&g_lock);
+    pthread_mutex_unlock(&g_speaker_lock);
     return 0;
 }
 
@@ -291,9 +357,9 @@ set_light_buttons(struct light_device_t* dev,
     if(!dev) {
         return -1;
     }
-    pthread_mutex_lock(&g_lock);
-    err = write_int(BUTTON_FILE, state->color & 0xFF);
-    pthread_mutex_unlock(&g_lock);
+    pthread_mutex_lock(&g_buttons_lock);
+    err = write_int(BUTTON, state->color & 0xFF);
+    pthread_mutex_unlock(&g_buttons_lock);
     return err;
 }
 
@@ -15,10 +15,15 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <hardware/memtrack.h>
 
@@ -27,6 +32,15 @@
 #define ARRAY_SIZE(x) (sizeof(x)/sizeof(x[0]))
 #define min(x, y) ((x) < (y) ? (x) : (y))
 
+/* Results are reused for this long so that back to back queries for the same
+ * process (dumpsys meminfo, lmk scans) do not re-parse the debugfs node. One
+ * pass over the node fills the GL and GRAPHICS totals, which the framework
+ * queries one after the other.
+ */
+#define KGSL_CACHE_TTL_NS   (250 * 1000 * 1000LL)
+#define KGSL_CACHE_ENTRIES  256
+#define KGSL_READ_CHUNK     16384
+
 struct memtrack_record record_templates[] = {
     {
         .flags = MEMTRACK_FLAG_SMAPS_ACCOUNTED |
@@ -40,105 +54,325 @@ struct memtrack_record record_templates[] = {
     },
 };
 
-int kgsl_memtrack_get_memory(pid_t pid, enum memtrack_type type,
-                             struct memtrack_record *records,
-                             size_t *num_records)
+enum kgsl_usage_index {
+    KGSL_USAGE_GL,
+    KGSL_USAGE_GRAPHICS,
+    KGSL_USAGE_MAX,
+};
+
+struct kgsl_usage {
+    int error;
+    size_t accounted_size;
+    size_t unaccounted_size;
+};
+
+struct kgsl_cache_entry {
+    pid_t pid;
+    bool valid;
+    long long timestamp_ns;
+    struct kgsl_usage usage[KGSL_USAGE_MAX];
+};
+
+static pthread_mutex_t kgsl_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct kgsl_cache_entry kgsl_cache[KGSL_CACHE_ENTRIES];
+/* Read buffer shared by all queries, grown on demand and never shrunk */
+static char *kgsl_buf = NULL;
+static size_t kgsl_buf_size = 0;
+
+static long long now_ns(void)
 {
-    size_t allocated_records = min(*num_records, ARRAY_SIZE(record_templates));
-    FILE *fp;
-    char line[1024];
-    char tmp[128];
-    size_t accounted_size = 0;
-    size_t unaccounted_size = 0;
+    struct timespec ts;
 
-    *num_records = ARRAY_SIZE(record_templates);
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
-    /* fastpath to return the necessary number of records */
-    if (allocated_records == 0) {
-        return 0;
-    }
+static struct kgsl_cache_entry *cache_slot(pid_t pid)
+{
+    return &kgsl_cache[(unsigned int)pid % KGSL_CACHE_ENTRIES];
+}
 
-    memcpy(records, record_templates,
-           sizeof(struct memtrack_record) * allocated_records);
+/* Reads the whole file into kgsl_buf and NUL terminates it. debugfs nodes do
+ * not report a size, so keep reading until EOF.
+ */
+static ssize_t read_file(const char *path)
+{
+    size_t len = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
 
-    snprintf(tmp, sizeof(tmp), "/d/kgsl/proc/%d/mem", pid);
-    fp = fopen(tmp, "r");
-    if (fp == NULL) {
+    if (fd < 0) {
         return -errno;
     }
 
-    /* Go through each line of <pid>/mem file and for every entry of type "gpumem"
-     * check if the gpubuffer entry is usermapped or not. If the entry is usermapped
-     * count the entry as accounted else count the entry as unaccounted.
-     */
     while (1) {
-        unsigned long size, mapsize;
-        char line_type[7];
-        char flags[10];
-        char line_usage[19];
-        int ret, egl_surface_count = 0, egl_image_count = 0;
+        ssize_t ret;
 
-        if (fgets(line, sizeof(line), fp) == NULL) {
+        if (kgsl_buf_size - len < KGSL_READ_CHUNK + 1) {
+            size_t new_size = kgsl_buf_size ? kgsl_buf_size * 2 : 4 * KGSL_READ_CHUNK;
+            char *new_buf = realloc(kgsl_buf, new_size);
+
+            if (new_buf == NULL) {
+                close(fd);
+                return -ENOMEM;
+            }
+            kgsl_buf = new_buf;
+            kgsl_buf_size = new_size;
+        }
+
+        ret = read(fd, kgsl_buf + len, kgsl_buf_size - len - 1);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ret = -errno;
+            close(fd);
+            return ret;
+        }
+        if (ret == 0) {
             break;
         }
+        len += (size_t)ret;
+    }
+
+    close(fd);
+    kgsl_buf[len] = '\0';
+
+    return (ssize_t)len;
+}
+
+/* Minimal tokenizer for the fixed column layout of <pid>/mem. Each helper
+ * skips leading blanks, consumes one field and returns false on mismatch.
+ */
+static inline const char *skip_blanks(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    return p;
+}
+
+static bool next_token(const char **p, const char *end,
+                       const char **tok, size_t *tok_len)
+{
+    const char *s = skip_blanks(*p, end);
+    const char *e = s;
+
+    while (e < end && *e != ' ' && *e != '\t') {
+        e++;
+    }
+    if (e == s) {
+        return false;
+    }
+
+    *tok = s;
+    *tok_len = (size_t)(e - s);
+    *p = e;
+    return true;
+}
+
+static bool next_hex(const char **p, const char *end)
+{
+    const char *s = skip_blanks(*p, end);
+    const char *e = s;
+
+    if (end - s > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        s += 2;
+        e = s;
+    }
+    while (e < end && ((*e >= '0' && *e <= '9') ||
+                       (*e >= 'a' && *e <= 'f') || (*e >= 'A' && *e <= 'F'))) {
+        e++;
+    }
+    if (e == s) {
+        return false;
+    }
+
+    *p = e;
+    return true;
+}
+
+static bool next_ulong(const char **p, const char *end, unsigned long *val)
+{
+    const char *s = skip_blanks(*p, end);
+    const char *e = s;
+    unsigned long v = 0;
+
+    while (e < end && *e >= '0' && *e <= '9') {
+        v = v * 10 + (unsigned long)(*e - '0');
+        e++;
+    }
+    if (e == s) {
+        return false;
+    }
+
+    *val = v;
+    *p = e;
+    return true;
+}
+
+static bool next_int(const char **p, const char *end, int *val)
+{
+    const char *s = skip_blanks(*p, end);
+    unsigned long v;
+    bool negative = false;
+
+    if (s < end && (*s == '-' || *s == '+')) {
+        negative = (*s == '-');
+        s++;
+    }
+    if (!next_ulong(&s, end, &v)) {
+        return false;
+    }
+
+    *val = negative ? -(int)v : (int)v;
+    *p = s;
+    return true;
+}
+
+static inline bool token_equals(const char *tok, size_t tok_len, const char *str)
+{
+    size_t len = strlen(str);
+
+    return tok_len == len && memcmp(tok, str, len) == 0;
+}
+
+/* Adds size to *total, or records -ERANGE in usage->error on overflow */
+static inline void add_size(struct kgsl_usage *usage, size_t *total, size_t size)
+{
+    if (*total + size < size) {
+        usage->error = -ERANGE;
+        return;
+    }
+    *total += size;
+}
+
+static void parse_mem(const char *buf, size_t len, struct kgsl_usage *usage)
+{
+    struct kgsl_usage *gl = &usage[KGSL_USAGE_GL];
+    struct kgsl_usage *graphics = &usage[KGSL_USAGE_GRAPHICS];
+    const char *line = buf;
+    const char *buf_end = buf + len;
+
+    memset(usage, 0, sizeof(struct kgsl_usage) * KGSL_USAGE_MAX);
+
+    /* Go through each line of <pid>/mem file. For every entry of type "gpumem"
+     * check if the gpubuffer entry is usermapped or not. If the entry is usermapped
+     * count the entry as accounted else count the entry as unaccounted. Entries
+     * of type "ion" count towards graphics. A type stops counting at its first
+     * error, the other one carries on.
+     */
+    while (line < buf_end && (!gl->error || !graphics->error)) {
+        const char *end = memchr(line, '\n', (size_t)(buf_end - line));
+        const char *p = line;
+        const char *flags, *line_type, *line_usage;
+        size_t flags_len, type_len, usage_len;
+        unsigned long size, mapsize, unused;
+        int id, egl_surface_count, egl_image_count;
+
+        if (end == NULL) {
+            end = buf_end;
+        }
+        line = end + 1;
 
         /* Format:
          *  gpuaddr useraddr     size    id flags       type            usage sglen mapsize eglsrf eglimg
          * 545ba000 545ba000     4096     1 -----pY     gpumem      arraybuffer     1  4096      0      0
          */
-        ret = sscanf(line, "%*x %*x %lu %*d %9s %6s %18s %*d %lu %6d %6d\n",
-                       &size, flags, line_type, line_usage, &mapsize,
-                       &egl_surface_count, &egl_image_count);
-        if (ret != 7) {
+        if (!next_hex(&p, end) || !next_hex(&p, end) ||
+            !next_ulong(&p, end, &size) || !next_int(&p, end, &id) ||
+            !next_token(&p, end, &flags, &flags_len) ||
+            !next_token(&p, end, &line_type, &type_len) ||
+            !next_token(&p, end, &line_usage, &usage_len) ||
+            !next_ulong(&p, end, &unused) || !next_ulong(&p, end, &mapsize) ||
+            !next_int(&p, end, &egl_surface_count) ||
+            !next_int(&p, end, &egl_image_count)) {
             continue;
         }
 
         if (size == 0) {
-            fclose(fp);
-            return -EINVAL;
-        }
-
-        if (unaccounted_size + size < size) {
-            fclose(fp);
-            return -ERANGE;
+            gl->error = graphics->error = -EINVAL;
+            break;
         }
 
-        if (type == MEMTRACK_TYPE_GL && strcmp(line_type, "gpumem") == 0) {
-
-            if (flags[6] == 'Y') {
-                if (accounted_size + mapsize < accounted_size) {
-                    fclose(fp);
-                    return -ERANGE;
-                }
-
-                accounted_size += mapsize;
-
+        if (!gl->error && token_equals(line_type, type_len, "gpumem")) {
+            if (flags_len > 6 && flags[6] == 'Y') {
                 if (mapsize > size) {
-                    fclose(fp);
-                    return -EINVAL;
+                    gl->error = -EINVAL;
+                    continue;
                 }
-                unaccounted_size += size - mapsize;
+                add_size(gl, &gl->accounted_size, mapsize);
+                add_size(gl, &gl->unaccounted_size, size - mapsize);
             } else {
-                unaccounted_size += size;
+                add_size(gl, &gl->unaccounted_size, size);
             }
-        } else if (type == MEMTRACK_TYPE_GRAPHICS && strcmp(line_type, "ion") == 0) {
-            if (strcmp(line_usage, "egl_surface") == 0) {
-                unaccounted_size += size;
+        } else if (!graphics->error && token_equals(line_type, type_len, "ion")) {
+            if (token_equals(line_usage, usage_len, "egl_surface")) {
+                add_size(graphics, &graphics->unaccounted_size, size);
             }
             else if (egl_surface_count == 0) {
-                unaccounted_size += size / (egl_image_count ? egl_image_count : 1);
+                add_size(graphics, &graphics->unaccounted_size,
+                         size / (unsigned long)(egl_image_count ? egl_image_count : 1));
             }
         }
     }
+}
+
+int kgsl_memtrack_get_memory(pid_t pid, enum memtrack_type type,
+                             struct memtrack_record *records,
+                             size_t *num_records)
+{
+    size_t allocated_records = min(*num_records, ARRAY_SIZE(record_templates));
+    enum kgsl_usage_index index = (type == MEMTRACK_TYPE_GL) ?
+                                  KGSL_USAGE_GL : KGSL_USAGE_GRAPHICS;
+    struct kgsl_cache_entry *entry;
+    struct kgsl_usage usage;
+    char tmp[128];
+    long long now;
+    ssize_t len;
+
+    *num_records = ARRAY_SIZE(record_templates);
+
+    /* fastpath to return the necessary number of records */
+    if (allocated_records == 0) {
+        return 0;
+    }
+
+    memcpy(records, record_templates,
+           sizeof(struct memtrack_record) * allocated_records);
+
+    pthread_mutex_lock(&kgsl_lock);
+
+    now = now_ns();
+    entry = cache_slot(pid);
+    if (!entry->valid || entry->pid != pid ||
+        now - entry->timestamp_ns >= KGSL_CACHE_TTL_NS) {
+        snprintf(tmp, sizeof(tmp), "/d/kgsl/proc/%d/mem", pid);
+        len = read_file(tmp);
+        if (len < 0) {
+            entry->valid = false;
+            pthread_mutex_unlock(&kgsl_lock);
+            return (int)len;
+        }
+
+        parse_mem(kgsl_buf, (size_t)len, entry->usage);
+        entry->pid = pid;
+        entry->valid = true;
+        entry->timestamp_ns = now;
+    }
+    usage = entry->usage[index];
+
+    pthread_mutex_unlock(&kgsl_lock);
+
+    if (usage.error < 0) {
+        return usage.error;
+    }
 
     if (allocated_records > 0) {
-        records[0].size_in_bytes = accounted_size;
+        records[0].size_in_bytes = usage.accounted_size;
     }
     if (allocated_records > 1) {
-        records[1].size_in_bytes = unaccounted_size;
+        records[1].size_in_bytes = usage.unaccounted_size;
     }
 
-    fclose(fp);
-
     return 0;
 }
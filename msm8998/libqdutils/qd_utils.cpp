@@ -28,6 +28,7 @@
  */
 
 #include <unistd.h>
+#include <pthread.h>
 #include <gralloc_priv.h>
 #include "qd_utils.h"
 
@@ -107,36 +108,28 @@ static int querySDEInfoDRM(HWQueryType type, int *value) {
     return 0;
 }
 
-static int querySDEInfoFB(HWQueryType type, int *value) {
-    FILE *fileptr = NULL;
-    const char *featureName;
-    char stringBuffer[MAX_STRING_LENGTH];
+// mdp caps do not change at runtime, so the features line is parsed once per process
+static pthread_once_t sFBFeaturesOnce = PTHREAD_ONCE_INIT;
+static bool sFBFeaturesValid = false;
+static bool sFBHasUBWC = false;
+static bool sFBHasWBUBWC = false;
+
+static void readSDEFeaturesFB() {
+    const char *capsPath = "/sys/devices/virtual/graphics/fb0/mdp/caps";
     uint32_t tokenCount = 0;
     const uint32_t maxCount = 10;
     char *tokens[maxCount] = { NULL };
 
-    switch(type) {
-    case HAS_UBWC:
-        featureName = "ubwc";
-        break;
-    case HAS_WB_UBWC:
-        featureName = "wb_ubwc";
-        break;
-    default:
-        ALOGE("Invalid query type %d", type);
-        return -EINVAL;
-    }
-
-    fileptr = fopen("/sys/devices/virtual/graphics/fb0/mdp/caps", "rb");
+    FILE *fileptr = fopen(capsPath, "rb");
     if (!fileptr) {
-        ALOGE("File '%s' not found", stringBuffer);
-        return -EINVAL;
+        ALOGE("File '%s' not found", capsPath);
+        return;
     }
 
-    size_t len = MAX_STRING_LENGTH;
-    ssize_t read;
-    char *line = stringBuffer;
-    while ((read = getline(&line, &len, fileptr)) != -1) {
+    // getline grows the buffer as needed, the features line can be long
+    char *line = NULL;
+    size_t len = 0;
+    while (getline(&line, &len, fileptr) != -1) {
         // parse the line and update information accordingly
         if (parseLine(line, tokens, maxCount, &tokenCount)) {
             continue;
@@ -147,13 +140,41 @@ static int querySDEInfoFB(HWQueryType type, int *value) {
         }
 
         for (uint32_t i = 0; i < tokenCount; i++) {
-            if (!strncmp(tokens[i], featureName, strlen(featureName))) {
-              *value = 1;
+            if (!strncmp(tokens[i], "wb_ubwc", strlen("wb_ubwc"))) {
+                sFBHasWBUBWC = true;
+            } else if (!strncmp(tokens[i], "ubwc", strlen("ubwc"))) {
+                sFBHasUBWC = true;
             }
         }
     }
+    free(line);
     fclose(fileptr);
 
+    sFBFeaturesValid = true;
+}
+
+static int querySDEInfoFB(HWQueryType type, int *value) {
+    pthread_once(&sFBFeaturesOnce, readSDEFeaturesFB);
+    if (!sFBFeaturesValid) {
+        return -EINVAL;
+    }
+
+    switch(type) {
+    case HAS_UBWC:
+        if (sFBHasUBWC) {
+            *value = 1;
+        }
+        break;
+    case HAS_WB_UBWC:
+        if (sFBHasWBUBWC) {
+            *value = 1;
+        }
+        break;
+    default:
+        ALOGE("Invalid query type %d", type);
+        return -EINVAL;
+    }
+
     return 0;
 }
 
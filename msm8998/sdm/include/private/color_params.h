@@ -598,6 +598,13 @@ class PPFeaturesConfig {
   // Consumer to call this to retrieve all the TFeatureInfo<T> on the list to be programmed.
   DisplayError RetrieveNextFeature(PPFeatureInfo **feature);
 
+  // Consumer to call this to take over a retrieved TFeatureInfo<T>, Reset() will not destroy it.
+  inline void DetachFeature(uint32_t feature_id) {
+    if (feature_id < kMaxNumPPFeatures) {
+      feature_[feature_id] = NULL;
+    }
+  }
+
   inline bool IsDirty() { return dirty_; }
   inline void MarkAsDirty() { dirty_ = true; }
 
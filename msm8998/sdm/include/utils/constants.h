@@ -34,6 +34,7 @@
 
 #define INT(exp) static_cast<int>(exp)
 #define FLOAT(exp) static_cast<float>(exp)
+#define DOUBLE(exp) static_cast<double>(exp)
 #define UINT8(exp) static_cast<uint8_t>(exp)
 #define UINT16(exp) static_cast<uint16_t>(exp)
 #define UINT32(exp) static_cast<uint32_t>(exp)
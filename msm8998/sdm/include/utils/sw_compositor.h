@@ -0,0 +1,87 @@
+/*
+* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __SW_COMPOSITOR_H__
+#define __SW_COMPOSITOR_H__
+
+#include <core/layer_stack.h>
+#include <core/sdm_types.h>
+#include <stdint.h>
+#include <condition_variable>   // NOLINT
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sdm {
+
+struct SWComposeJob;
+
+// CPU implementation of client composition. Layers are blended bottom to top into a linear RGB
+// output, honouring crop, bilinear scaling, the 90/180/270 transforms, plane alpha and the
+// premultiplied, coverage and opaque blending modes. Every output row is computed independently
+// with integer math, so the result is bit exact for any thread count and between the NEON and
+// C paths. Acquire fences of the input buffers must have signaled before composing.
+class SWCompositor {
+ public:
+  // A thread count of 0 uses one thread per online CPU.
+  explicit SWCompositor(uint32_t num_threads = 0);
+  ~SWCompositor();
+
+  static bool IsInputFormatSupported(LayerBufferFormat format);
+  static bool IsOutputFormatSupported(LayerBufferFormat format);
+
+  // Maps the input and output buffers through their plane fds for the duration of the call.
+  DisplayError Compose(const std::vector<Layer *> &layers, LayerBuffer *output);
+
+  // Composes buffers the caller has already mapped. bases[i] holds the mapping of
+  // layers[i]->input_buffer and is ignored for solid fill layers.
+  DisplayError Compose(const std::vector<Layer *> &layers, const std::vector<uint8_t *> &bases,
+                       const LayerBuffer &output, uint8_t *output_base);
+
+ private:
+  static const uint32_t kBandHeight = 16;
+
+  void WorkerThread(uint32_t index);
+  void ComposeBands(const SWComposeJob &job, uint32_t index);
+
+  uint32_t num_threads_ = 1;
+  std::vector<std::thread> workers_;
+  std::vector<std::vector<uint8_t>> scratch_;
+  std::mutex mutex_;
+  std::condition_variable job_cv_;
+  std::condition_variable done_cv_;
+  const SWComposeJob *job_ = nullptr;
+  uint64_t job_id_ = 0;
+  uint32_t pending_workers_ = 0;
+  bool exit_ = false;
+};
+
+}  // namespace sdm
+
+#endif  // __SW_COMPOSITOR_H__
@@ -35,6 +35,7 @@ LOCAL_SRC_FILES               := core_interface.cpp \
                                  display_hdmi.cpp \
                                  display_virtual.cpp \
                                  comp_manager.cpp \
+                                 cost_model.cpp \
                                  strategy.cpp \
                                  resource_default.cpp \
                                  dump_impl.cpp \
@@ -46,6 +47,8 @@ LOCAL_SRC_FILES               := core_interface.cpp \
                                  $(LOCAL_HW_INTF_PATH_1)/hw_device.cpp \
                                  $(LOCAL_HW_INTF_PATH_1)/hw_primary.cpp \
                                  $(LOCAL_HW_INTF_PATH_1)/hw_hdmi.cpp \
+                                 $(LOCAL_HW_INTF_PATH_1)/hw_hdmi_mode_cache.cpp \
+                                 $(LOCAL_HW_INTF_PATH_1)/hw_caps_cache.cpp \
                                  $(LOCAL_HW_INTF_PATH_1)/hw_virtual.cpp \
                                  $(LOCAL_HW_INTF_PATH_1)/hw_color_manager.cpp \
                                  $(LOCAL_HW_INTF_PATH_1)/hw_scale.cpp \
@@ -55,6 +58,7 @@ ifneq ($(TARGET_IS_HEADLESS), true)
     LOCAL_SRC_FILES           += $(LOCAL_HW_INTF_PATH_2)/hw_info_drm.cpp \
                                  $(LOCAL_HW_INTF_PATH_2)/hw_device_drm.cpp \
                                  $(LOCAL_HW_INTF_PATH_2)/hw_events_drm.cpp \
+                                 $(LOCAL_HW_INTF_PATH_2)/hw_vsync_model.cpp \
                                  $(LOCAL_HW_INTF_PATH_2)/hw_color_manager_drm.cpp
 endif
 
@@ -25,6 +25,7 @@
 #include <utils/constants.h>
 #include <utils/debug.h>
 #include <core/buffer_allocator.h>
+#include <algorithm>
 
 #include "comp_manager.h"
 #include "strategy.h"
@@ -125,6 +126,7 @@ DisplayError CompManager::RegisterDisplay(DisplayType type,
   }
 
   registered_displays_[type] = 1;
+  display_comp_ctx->cost_model.Init(hw_res_info_, display_attributes);
   display_comp_ctx->is_primary_panel = hw_panel_info.is_primary_panel;
   display_comp_ctx->display_type = type;
   *display_ctx = display_comp_ctx;
@@ -161,6 +163,7 @@ DisplayError CompManager::UnregisterDisplay(Handle display_ctx) {
 
   registered_displays_[display_comp_ctx->display_type] = 0;
   configured_displays_[display_comp_ctx->display_type] = 0;
+  committed_bw_[display_comp_ctx->display_type] = 0;
 
   if (display_comp_ctx->display_type == kHDMI) {
     max_layers_ = kMaxSDELayers;
@@ -214,6 +217,7 @@ DisplayError CompManager::ReconfigureDisplay(Handle comp_handle,
     }
   }
 
+  display_comp_ctx->cost_model.Init(hw_res_info_, display_attributes);
   display_comp_ctx->scaled_composition = NeedsScaledComposition(fb_config, mixer_attributes);
 
   return error;
@@ -298,7 +302,11 @@ DisplayError CompManager::Prepare(Handle display_ctx, HWLayers *hw_layers) {
 
     if (!exit) {
       error = resource_intf_->Prepare(display_resource_ctx, hw_layers);
-      // Exit if successfully prepared resource, else try next strategy.
+      if (error == kErrorNone) {
+        error = ValidateCost(display_comp_ctx, hw_layers);
+      }
+      // Exit if successfully prepared resource within the bandwidth and clock limits, else try
+      // next strategy.
       exit = (error == kErrorNone);
     }
   }
@@ -312,6 +320,58 @@ DisplayError CompManager::Prepare(Handle display_ctx, HWLayers *hw_layers) {
   return error;
 }
 
+DisplayError CompManager::ValidateCost(DisplayCompositionContext *display_comp_ctx,
+                                       HWLayers *hw_layers) {
+  CompositionCost &cost = display_comp_ctx->cost;
+  DisplayType display_type = display_comp_ctx->display_type;
+
+  display_comp_ctx->cost_model.Calculate(*hw_layers, &cost);
+  hw_layers->bandwidth = UINT32(std::min(cost.bandwidth, UINT64(UINT32_MAX)));
+  hw_layers->clock = UINT32(std::min(cost.clock, UINT64(UINT32_MAX)));
+
+  // The default entry of the dynamic bandwidth table is the low limit as well.
+  uint64_t total_bw_limit = hw_res_info_.max_bandwidth_low;
+  uint64_t pipe_bw_limit = hw_res_info_.max_pipe_bw;
+  if (hw_res_info_.has_dyn_bw_support) {
+    total_bw_limit = hw_res_info_.dyn_bw_info.total_bw_limit[bw_mode_];
+    pipe_bw_limit = hw_res_info_.dyn_bw_info.pipe_bw_limit[bw_mode_];
+  }
+
+  // DDR bandwidth is shared by all displays, budget against what the others committed last.
+  uint64_t bw_budget = 0;
+  if (total_bw_limit) {
+    uint64_t other_bw = 0;
+    for (int i = 0; i < kDisplayMax; i++) {
+      if (i != display_type) {
+        other_bw += committed_bw_[i];
+      }
+    }
+    bw_budget = (total_bw_limit > other_bw) ? (total_bw_limit - other_bw) : 1;
+  }
+
+  if (display_comp_ctx->cost_model.Fits(cost, bw_budget, pipe_bw_limit)) {
+    return kErrorNone;
+  }
+
+  // GPU composition is the last resort, it has to be programmed even when it does not fit.
+  if (IsGPUOnlyComposition(hw_layers->info)) {
+    DLOGW("GPU composition exceeds limits on display %d: bw = %" PRIu64 " budget = %" PRIu64
+          " clk = %" PRIu64, display_type, cost.bandwidth, bw_budget, cost.clock);
+    return kErrorNone;
+  }
+
+  DLOGV_IF(kTagCompManager, "Rejected strategy on display %d: bw = %" PRIu64 " prefill = %"
+           PRIu64 " budget = %" PRIu64 " pipe bw = %" PRIu64 " clk = %" PRIu64, display_type,
+           cost.fetch_bw, cost.prefill_bw, bw_budget, cost.max_pipe_bw, cost.clock);
+
+  return kErrorResources;
+}
+
+bool CompManager::IsGPUOnlyComposition(const HWLayersInfo &layer_info) {
+  return (layer_info.hw_layers.size() == 1) &&
+         (layer_info.hw_layers.at(0).composition == kCompositionGPUTarget);
+}
+
 DisplayError CompManager::PostPrepare(Handle display_ctx, HWLayers *hw_layers) {
   SCOPE_LOCK(locker_);
   DisplayCompositionContext *display_comp_ctx =
@@ -368,6 +428,7 @@ DisplayError CompManager::PostCommit(Handle display_ctx, HWLayers *hw_layers) {
   DisplayCompositionContext *display_comp_ctx =
                              reinterpret_cast<DisplayCompositionContext *>(display_ctx);
   configured_displays_[display_comp_ctx->display_type] = 1;
+  committed_bw_[display_comp_ctx->display_type] = display_comp_ctx->cost.bandwidth;
   if (configured_displays_ == registered_displays_) {
     safe_mode_ = false;
   }
@@ -524,7 +585,12 @@ DisplayError CompManager::SetMaxBandwidthMode(HWBwModes mode) {
     return kErrorNotSupported;
   }
 
-  return resource_intf_->SetMaxBandwidthMode(mode);
+  DisplayError error = resource_intf_->SetMaxBandwidthMode(mode);
+  if (error == kErrorNone) {
+    bw_mode_ = mode;
+  }
+
+  return error;
 }
 
 DisplayError CompManager::GetScaleLutConfig(HWScaleLutInfo *lut_info) {
@@ -567,6 +633,7 @@ bool CompManager::SetDisplayState(Handle display_ctx,
   case kStateOff:
     Purge(display_ctx);
     configured_displays_.reset(display_type);
+    committed_bw_[display_type] = 0;
     DLOGV_IF(kTagCompManager, "configured_displays_ = 0x%x", configured_displays_);
     break;
 
@@ -32,6 +32,7 @@
 
 #include "strategy.h"
 #include "resource_default.h"
+#include "cost_model.h"
 #include "hw_interface.h"
 #include "dump_impl.h"
 
@@ -99,13 +100,20 @@ class CompManager : public DumpImpl {
     bool valid_cursor = false;
     PUConstraints pu_constraints = {};
     bool scaled_composition = false;
+    CostModel cost_model;
+    CompositionCost cost = {};  // Cost of the last prepared composition
   };
 
+  DisplayError ValidateCost(DisplayCompositionContext *display_comp_ctx, HWLayers *hw_layers);
+  bool IsGPUOnlyComposition(const HWLayersInfo &layer_info);
+
   Locker locker_;
   ResourceInterface *resource_intf_ = NULL;
   std::bitset<kDisplayMax> registered_displays_;  // Bit mask of registered displays
   std::bitset<kDisplayMax> configured_displays_;  // Bit mask of sucessfully configured displays
   uint32_t display_state_[kDisplayMax] = {};
+  uint64_t committed_bw_[kDisplayMax] = {};  // Bandwidth of the last commit on each display in KBps
+  HWBwModes bw_mode_ = kBwDefault;
   bool safe_mode_ = false;              // Flag to notify all displays to be in resource crunch
                                         // mode, where strategy manager chooses the best strategy
                                         // that uses optimal number of pipes for each display
@@ -0,0 +1,174 @@
+/*
+* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <utils/constants.h>
+#include <algorithm>
+
+#include "cost_model.h"
+
+namespace sdm {
+
+void CostModel::Init(const HWResourceInfo &hw_res_info,
+                     const HWDisplayAttributes &display_attributes) {
+  max_sde_clk_ = hw_res_info.max_sde_clk;
+  clk_fudge_factor_ = std::max(hw_res_info.clk_fudge_factor, 1.0f);
+  system_overhead_lines_ = hw_res_info.system_overhead_lines;
+
+  // Timing details are not reported for every interface, fall back to the active region.
+  uint32_t fps = display_attributes.fps ? display_attributes.fps : 60;
+  uint32_t v_total = std::max(display_attributes.v_total, display_attributes.y_pixels);
+  uint32_t h_total = std::max(display_attributes.h_total, display_attributes.x_pixels);
+  uint32_t num_mixers = display_attributes.is_device_split ? 2 : 1;
+
+  line_rate_ = UINT64(v_total) * fps;
+  mixer_clock_ = UINT64(h_total / num_mixers) * line_rate_;
+  vblank_lines_ = v_total - display_attributes.y_pixels;
+}
+
+void CostModel::CalculatePipe(const Layer &layer, const HWPipeInfo &pipe, float compression,
+                              CompositionCost *cost, uint64_t *prefill_bytes) const {
+  if (!pipe.valid) {
+    return;
+  }
+
+  double src_w = pipe.src_roi.right - pipe.src_roi.left;
+  double src_h = pipe.src_roi.bottom - pipe.src_roi.top;
+  double dst_w = pipe.dst_roi.right - pipe.dst_roi.left;
+  double dst_h = pipe.dst_roi.bottom - pipe.dst_roi.top;
+  if (src_w <= 0.0 || src_h <= 0.0 || dst_w <= 0.0 || dst_h <= 0.0) {
+    return;
+  }
+
+  bool scaled = (src_w != dst_w) || (src_h != dst_h);
+  src_w /= (1 << pipe.horizontal_decimation);
+  src_h /= (1 << pipe.vertical_decimation);
+
+  // Solid fill pipes do not fetch from memory, but still occupy the core clock.
+  double bpp = layer.flags.solid_fill ? 0.0 : GetBytesPerPixel(layer.input_buffer.format);
+  double v_ratio = std::max(src_h / dst_h, 1.0);
+  double line_bytes = src_w * bpp / std::max(compression, 1.0f);
+
+  // All source lines have to be fetched while the destination lines are being scanned out, so a
+  // vertical downscale raises the peak bandwidth over the frame average.
+  uint64_t pipe_bw = UINT64(line_bytes * src_h * DOUBLE(line_rate_) / dst_h / 1000.0);
+  cost->fetch_bw += pipe_bw;
+  cost->max_pipe_bw = std::max(cost->max_pipe_bw, pipe_bw);
+
+  uint32_t lines = scaled ? kScalerPrefillLines : kPrefillLines;
+  *prefill_bytes += UINT64(line_bytes * lines * v_ratio);
+
+  uint64_t pipe_clock = UINT64(dst_w * v_ratio * DOUBLE(line_rate_));
+  cost->clock = std::max(cost->clock, pipe_clock);
+}
+
+void CostModel::Calculate(const HWLayers &hw_layers, CompositionCost *cost) const {
+  const HWLayersInfo &layer_info = hw_layers.info;
+  uint64_t prefill_bytes = 0;
+
+  *cost = CompositionCost();
+  for (uint32_t i = 0; i < layer_info.hw_layers.size(); i++) {
+    const Layer &layer = layer_info.hw_layers.at(i);
+    const HWLayerConfig &layer_config = hw_layers.config[i];
+
+    CalculatePipe(layer, layer_config.left_pipe, layer_config.compression, cost, &prefill_bytes);
+    CalculatePipe(layer, layer_config.right_pipe, layer_config.compression, cost, &prefill_bytes);
+  }
+
+  // Prefill has to complete within the blanking lines left after the fixed system overhead.
+  // Interfaces without blanking information fetch on demand and have no prefill window.
+  if (vblank_lines_) {
+    uint64_t prefill_lines = 1;
+    if (vblank_lines_ > system_overhead_lines_) {
+      prefill_lines = vblank_lines_ - system_overhead_lines_;
+    }
+    cost->prefill_bw = prefill_bytes * line_rate_ / prefill_lines / 1000;
+  }
+
+  cost->bandwidth = std::max(cost->fetch_bw, cost->prefill_bw);
+  cost->clock = UINT64(FLOAT(std::max(cost->clock, mixer_clock_)) * clk_fudge_factor_);
+}
+
+bool CostModel::Fits(const CompositionCost &cost, uint64_t bw_budget,
+                     uint64_t pipe_bw_limit) const {
+  if (bw_budget && cost.bandwidth > bw_budget) {
+    return false;
+  }
+
+  if (pipe_bw_limit && cost.max_pipe_bw > pipe_bw_limit) {
+    return false;
+  }
+
+  // A mode the driver accepted can always be scanned out, only reject the clock the pipes add.
+  uint64_t clk_limit = std::max(UINT64(max_sde_clk_),
+                                UINT64(FLOAT(mixer_clock_) * clk_fudge_factor_));
+  if (max_sde_clk_ && cost.clock > clk_limit) {
+    return false;
+  }
+
+  return true;
+}
+
+float CostModel::GetBytesPerPixel(LayerBufferFormat format) {
+  switch (format) {
+  case kFormatRGB888:
+  case kFormatBGR888:
+    return 3.0f;
+
+  case kFormatRGBA5551:
+  case kFormatRGBA4444:
+  case kFormatRGB565:
+  case kFormatBGR565:
+  case kFormatBGR565Ubwc:
+  case kFormatYCbCr422H1V2SemiPlanar:
+  case kFormatYCrCb422H1V2SemiPlanar:
+  case kFormatYCbCr422H2V1SemiPlanar:
+  case kFormatYCrCb422H2V1SemiPlanar:
+  case kFormatYCbCr422H2V1Packed:
+  case kFormatCbYCrY422H2V1Packed:
+    return 2.0f;
+
+  case kFormatYCbCr420Planar:
+  case kFormatYCrCb420Planar:
+  case kFormatYCrCb420PlanarStride16:
+  case kFormatYCbCr420SemiPlanar:
+  case kFormatYCrCb420SemiPlanar:
+  case kFormatYCbCr420SemiPlanarVenus:
+  case kFormatYCrCb420SemiPlanarVenus:
+  case kFormatYCbCr420SPVenusUbwc:
+    return 1.5f;
+
+  case kFormatYCbCr420P010:
+    return 3.0f;
+
+  case kFormatYCbCr420TP10Ubwc:
+    // Three 10 bit samples packed in 4 bytes.
+    return 2.0f;
+
+  default:
+    // 32 bit RGB layouts, and anything unknown is costed as the widest single plane format.
+    return 4.0f;
+  }
+}
+
+}  // namespace sdm
@@ -0,0 +1,70 @@
+/*
+* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __COST_MODEL_H__
+#define __COST_MODEL_H__
+
+#include <core/layer_stack.h>
+#include <private/hw_info_types.h>
+
+namespace sdm {
+
+// Estimated MDP load of one composition candidate. Bandwidths are in KBps and the clock in Hz, the
+// same units the driver exposes the platform limits in.
+struct CompositionCost {
+  uint64_t fetch_bw = 0;     // Peak fetch bandwidth of all pipes while they are scanning out.
+  uint64_t prefill_bw = 0;   // Bandwidth needed to prefill all pipes within vertical blanking.
+  uint64_t max_pipe_bw = 0;  // Highest fetch bandwidth of a single pipe.
+  uint64_t bandwidth = 0;    // Bandwidth vote, larger of fetch and prefill bandwidth.
+  uint64_t clock = 0;        // Core clock needed to keep up with the pipes and the mixer.
+};
+
+// Computes the DDR bandwidth and MDP clock a set of pipe configurations needs on one display, so
+// that candidates exceeding the platform limits can be rejected before they reach the driver.
+class CostModel {
+ public:
+  void Init(const HWResourceInfo &hw_res_info, const HWDisplayAttributes &display_attributes);
+  void Calculate(const HWLayers &hw_layers, CompositionCost *cost) const;
+  bool Fits(const CompositionCost &cost, uint64_t bw_budget, uint64_t pipe_bw_limit) const;
+
+  static float GetBytesPerPixel(LayerBufferFormat format);
+
+ private:
+  static const uint32_t kPrefillLines = 2;        // Lines fetched ahead by an unscaled pipe.
+  static const uint32_t kScalerPrefillLines = 4;  // Lines the scaler needs before first output.
+
+  void CalculatePipe(const Layer &layer, const HWPipeInfo &pipe, float compression,
+                     CompositionCost *cost, uint64_t *prefill_bytes) const;
+
+  uint64_t max_sde_clk_ = 0;
+  float clk_fudge_factor_ = 1.0f;
+  uint32_t system_overhead_lines_ = 0;
+  uint64_t line_rate_ = 0;      // Lines scanned out per second, including blanking.
+  uint64_t mixer_clock_ = 0;    // Pixel rate of one layer mixer, including blanking.
+  uint32_t vblank_lines_ = 0;
+};
+
+}  // namespace sdm
+
+#endif  // __COST_MODEL_H__
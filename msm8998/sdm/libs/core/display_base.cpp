@@ -245,6 +245,24 @@ DisplayError DisplayBase::Prepare(LayerStack *layer_stack) {
     disable_pu_one_frame_ = false;
   }
 
+  error = PrepareStrategy();
+  if (mixer_trial_pending_ && error != kErrorShutDown) {
+    error = ValidateMixerReconfiguration(layer_stack, error);
+  }
+  mixer_trial_pending_ = false;
+
+  if (error == kErrorNone && IsGPUFallback(layer_stack)) {
+    gpu_fallback_frames_++;
+  }
+
+  comp_manager_->PostPrepare(display_comp_ctx_, &hw_layers_);
+
+  return error;
+}
+
+DisplayError DisplayBase::PrepareStrategy() {
+  DisplayError error = kErrorNone;
+
   comp_manager_->PrePrepare(display_comp_ctx_, &hw_layers_);
   while (true) {
     error = comp_manager_->Prepare(display_comp_ctx_, &hw_layers_);
@@ -259,16 +277,64 @@ DisplayError DisplayBase::Prepare(LayerStack *layer_stack) {
       break;
     }
     if (error == kErrorShutDown) {
-      comp_manager_->PostPrepare(display_comp_ctx_, &hw_layers_);
-      return error;
+      break;
     }
   }
 
+  return error;
+}
+
+DisplayError DisplayBase::ValidateMixerReconfiguration(LayerStack *layer_stack,
+                                                       DisplayError error) {
+  if (error == kErrorNone && !IsGPUFallback(layer_stack)) {
+    mixer_switch_count_++;
+    return kErrorNone;
+  }
+
+  // The new mixer could not be composed on MDP, go back to the mixer which composed the previous
+  // frames for this frame.
+  uint32_t new_mixer_width = mixer_attributes_.width;
+  uint32_t new_mixer_height = mixer_attributes_.height;
   comp_manager_->PostPrepare(display_comp_ctx_, &hw_layers_);
+  if (ReconfigureMixer(prev_mixer_attributes_.width, prev_mixer_attributes_.height) !=
+      kErrorNone) {
+    return error;
+  }
+
+  needs_validate_.set(display_type_);
+  error = PrepareStrategy();
+
+  // Idle, thermal or safe mode fallback compose the frame on GPU whatever the mixer is. Only when
+  // the previous mixer does better on the same frame, the new one is not tried again until the
+  // layer count changes.
+  if (error == kErrorNone && !IsGPUFallback(layer_stack)) {
+    DLOGI("Mixer %dx%d needs GPU fallback, restoring %dx%d", new_mixer_width, new_mixer_height,
+          mixer_attributes_.width, mixer_attributes_.height);
+    rejected_mixer_width_ = new_mixer_width;
+    rejected_mixer_height_ = new_mixer_height;
+    rejected_mixer_layer_count_ = UINT32(layer_stack->layers.size());
+    mixer_reject_count_++;
+  }
 
   return error;
 }
 
+bool DisplayBase::IsGPUFallback(LayerStack *layer_stack) {
+  // Skip layers force GPU composition regardless of the mixer, and without app layers there is
+  // nothing to fall back.
+  if (layer_stack->flags.skip_present || !hw_layers_.info.app_layer_count) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < hw_layers_.info.app_layer_count; i++) {
+    if (layer_stack->layers.at(i)->composition != kCompositionGPU) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 DisplayError DisplayBase::Commit(LayerStack *layer_stack) {
   lock_guard<recursive_mutex> obj(recursive_mutex_);
   DisplayError error = kErrorNone;
@@ -529,6 +595,10 @@ void DisplayBase::AppendDump(char *buffer, uint32_t length) {
                          state_, INT(vsync_enable_), max_mixer_stages_);
   DumpImpl::AppendString(buffer, length, "\nnum configs: %u, active config index: %u",
                          num_modes, active_index);
+  DumpImpl::AppendString(buffer, length, "\nmixer: %ux%u, mixer switches: %u, rejected: %u, "
+                         "GPU fallback frames: %u", mixer_attributes_.width,
+                         mixer_attributes_.height, mixer_switch_count_, mixer_reject_count_,
+                         gpu_fallback_frames_);
 
   DisplayConfigVariableInfo &info = attrib;
 
@@ -1037,6 +1107,11 @@ DisplayError DisplayBase::ReconfigureDisplay() {
     return kErrorNone;
   }
 
+  if (display_attributes != display_attributes_) {
+    rejected_mixer_width_ = 0;
+    rejected_mixer_height_ = 0;
+  }
+
   error = comp_manager_->ReconfigureDisplay(display_comp_ctx_, display_attributes, hw_panel_info,
                                             mixer_attributes, fb_config_);
   if (error != kErrorNone) {
@@ -1064,6 +1139,8 @@ DisplayError DisplayBase::SetMixerResolution(uint32_t width, uint32_t height) {
 
   req_mixer_width_ = width;
   req_mixer_height_ = height;
+  rejected_mixer_width_ = 0;
+  rejected_mixer_height_ = 0;
 
   return kErrorNone;
 }
@@ -1100,6 +1177,50 @@ DisplayError DisplayBase::ReconfigureMixer(uint32_t width, uint32_t height) {
   return ReconfigureDisplay();
 }
 
+void DisplayBase::PrepareMixerReconfiguration(LayerStack *layer_stack) {
+  uint32_t new_mixer_width = 0;
+  uint32_t new_mixer_height = 0;
+  uint32_t layer_count = UINT32(layer_stack->layers.size());
+
+  mixer_trial_pending_ = false;
+  if (!NeedsMixerReconfiguration(layer_stack, &new_mixer_width, &new_mixer_height)) {
+    return;
+  }
+
+  // A mixer requested by the client is applied as is, it is neither tried nor rejected
+  if (req_mixer_width_ && req_mixer_height_) {
+    if (ReconfigureMixer(new_mixer_width, new_mixer_height) != kErrorNone) {
+      ReconfigureMixer(display_attributes_.x_pixels, display_attributes_.y_pixels);
+    }
+    return;
+  }
+
+  if (layer_count != rejected_mixer_layer_count_) {
+    rejected_mixer_width_ = 0;
+    rejected_mixer_height_ = 0;
+  }
+
+  if (new_mixer_width == rejected_mixer_width_ && new_mixer_height == rejected_mixer_height_) {
+    return;
+  }
+
+  HWMixerAttributes mixer_attributes = mixer_attributes_;
+  DisplayError error = ReconfigureMixer(new_mixer_width, new_mixer_height);
+  if (error != kErrorNone) {
+    rejected_mixer_width_ = new_mixer_width;
+    rejected_mixer_height_ = new_mixer_height;
+    rejected_mixer_layer_count_ = layer_count;
+    mixer_reject_count_++;
+    ReconfigureMixer(display_attributes_.x_pixels, display_attributes_.y_pixels);
+    return;
+  }
+
+  if (mixer_attributes != mixer_attributes_) {
+    prev_mixer_attributes_ = mixer_attributes;
+    mixer_trial_pending_ = true;
+  }
+}
+
 bool DisplayBase::NeedsDownScale(const LayerRect &src_rect, const LayerRect &dst_rect,
                                  bool needs_rotation) {
   float src_width = FLOAT(src_rect.right - src_rect.left);
@@ -1226,6 +1347,8 @@ DisplayError DisplayBase::SetFrameBufferConfig(const DisplayConfigVariableInfo &
 
   fb_config_.x_pixels = width;
   fb_config_.y_pixels = height;
+  rejected_mixer_width_ = 0;
+  rejected_mixer_height_ = 0;
 
   DLOGI("New framebuffer resolution (%dx%d)", fb_config_.x_pixels, fb_config_.y_pixels);
 
@@ -130,6 +130,10 @@ class DisplayBase : public DisplayInterface, DumpImpl {
   bool NeedsMixerReconfiguration(LayerStack *layer_stack, uint32_t *new_mixer_width,
                                  uint32_t *new_mixer_height);
   DisplayError ReconfigureMixer(uint32_t width, uint32_t height);
+  void PrepareMixerReconfiguration(LayerStack *layer_stack);
+  DisplayError PrepareStrategy();
+  DisplayError ValidateMixerReconfiguration(LayerStack *layer_stack, DisplayError error);
+  bool IsGPUFallback(LayerStack *layer_stack);
   bool NeedsDownScale(const LayerRect &src_rect, const LayerRect &dst_rect, bool needs_rotation);
   DisplayError InitializeColorModes();
   DisplayError SetColorModeInternal(const std::string &color_mode);
@@ -170,6 +174,18 @@ class DisplayBase : public DisplayInterface, DumpImpl {
   DisplayConfigVariableInfo fb_config_ = {};
   uint32_t req_mixer_width_ = 0;
   uint32_t req_mixer_height_ = 0;
+  // A mixer switch is tried on the frame that needs it and kept only if that frame composes
+  // without falling back to GPU, otherwise the previous mixer is restored for the same frame.
+  // It is rejected only if the previous mixer composes that frame on MDP. Mixers requested
+  // through SetMixerResolution are not tried.
+  bool mixer_trial_pending_ = false;
+  HWMixerAttributes prev_mixer_attributes_ = {};
+  uint32_t rejected_mixer_width_ = 0;
+  uint32_t rejected_mixer_height_ = 0;
+  uint32_t rejected_mixer_layer_count_ = 0;
+  uint32_t mixer_switch_count_ = 0;
+  uint32_t mixer_reject_count_ = 0;
+  uint32_t gpu_fallback_frames_ = 0;
   std::string current_color_mode_ = "hal_native";
   bool hdr_playback_mode_ = false;
   int disable_hdr_lut_gen_ = 0;
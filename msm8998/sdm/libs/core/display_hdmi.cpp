@@ -24,6 +24,7 @@
 
 #include <utils/constants.h>
 #include <utils/debug.h>
+#include <algorithm>
 #include <map>
 #include <utility>
 #include <vector>
@@ -86,6 +87,10 @@ DisplayError DisplayHDMI::Init() {
   s3d_format_to_mode_.insert(std::pair<LayerBufferS3DFormat, HWS3DMode>
                             (kS3dFormatFramePacking, kS3DModeFP));
 
+  // The CEC HAL reads the messages itself, a second reader would steal them
+  event_list_.erase(std::remove(event_list_.begin(), event_list_.end(),
+                                HWEvent::CEC_READ_MESSAGE), event_list_.end());
+
   error = HWEventsInterface::Create(INT(display_type_), this, event_list_, &hw_events_intf_);
   if (error != kErrorNone) {
     DisplayBase::Deinit();
@@ -98,18 +103,8 @@ DisplayError DisplayHDMI::Init() {
 
 DisplayError DisplayHDMI::Prepare(LayerStack *layer_stack) {
   lock_guard<recursive_mutex> obj(recursive_mutex_);
-  DisplayError error = kErrorNone;
-  uint32_t new_mixer_width = 0;
-  uint32_t new_mixer_height = 0;
-  uint32_t display_width = display_attributes_.x_pixels;
-  uint32_t display_height = display_attributes_.y_pixels;
-
-  if (NeedsMixerReconfiguration(layer_stack, &new_mixer_width, &new_mixer_height)) {
-    error = ReconfigureMixer(new_mixer_width, new_mixer_height);
-    if (error != kErrorNone) {
-      ReconfigureMixer(display_width, display_height);
-    }
-  }
+
+  PrepareMixerReconfiguration(layer_stack);
 
   SetS3DMode(layer_stack);
 
@@ -78,6 +78,11 @@ using sde_drm::DRMTopology;
 
 namespace sdm {
 
+static bool IsSameRect(const DRMRect &lhs, const DRMRect &rhs) {
+  return (lhs.left == rhs.left) && (lhs.top == rhs.top) && (lhs.right == rhs.right) &&
+         (lhs.bottom == rhs.bottom);
+}
+
 HWDeviceDRM::HWDeviceDRM(BufferSyncHandler *buffer_sync_handler, HWInfoInterface *hw_info_intf)
     : hw_info_intf_(hw_info_intf), buffer_sync_handler_(buffer_sync_handler) {
   device_type_ = kDevicePrimary;
@@ -129,6 +134,7 @@ DisplayError HWDeviceDRM::Init() {
 }
 
 DisplayError HWDeviceDRM::Deinit() {
+  plane_cache_.clear();
   drm_mgr_intf_->DestroyAtomicReq(drm_atomic_intf_);
   drm_atomic_intf_ = {};
   drm_mgr_intf_->UnregisterDisplay(token_);
@@ -390,25 +396,55 @@ void HWDeviceDRM::SetupAtomic(HWLayers *hw_layers, bool validate) {
 
       if (pipe_info->valid) {
         uint32_t pipe_id = pipe_info->pipe_id;
+        DRMPlaneCache &plane = plane_cache_[pipe_id];
+        // Planes are set in every request they are used in, but only with what changed
+        bool first_in_request = !plane.in_request;
+        if (first_in_request) {
+          plane.pending = plane.committed;
+          plane.pending_valid = plane.committed_valid;
+          plane.in_request = true;
+        }
+        DRMPlaneState &state = plane.pending;
+        bool valid = plane.pending_valid;
+
         if (input_buffer->fb_id == 0) {
           // We set these to 0 to clear any previous cycle's state from another buffer.
           // Unfortunately this layer will be skipped from validation because it's dimensions are
           // tied to fb_id which is not available yet.
-          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_FB_ID, pipe_id, 0);
-          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_CRTC, pipe_id, 0);
+          if (first_in_request || !valid || state.fb_id || state.crtc_id) {
+            drm_atomic_intf_->Perform(DRMOps::PLANE_SET_FB_ID, pipe_id, 0);
+            drm_atomic_intf_->Perform(DRMOps::PLANE_SET_CRTC, pipe_id, 0);
+            state.fb_id = 0;
+            state.crtc_id = 0;
+          }
           continue;
         }
-        drm_atomic_intf_->Perform(DRMOps::PLANE_SET_ALPHA, pipe_id, layer.plane_alpha);
-        drm_atomic_intf_->Perform(DRMOps::PLANE_SET_ZORDER, pipe_id, pipe_info->z_order);
+        if (!valid || state.alpha != layer.plane_alpha) {
+          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_ALPHA, pipe_id, layer.plane_alpha);
+          state.alpha = layer.plane_alpha;
+        }
+        if (!valid || state.z_order != pipe_info->z_order) {
+          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_ZORDER, pipe_id, pipe_info->z_order);
+          state.z_order = pipe_info->z_order;
+        }
         DRMBlendType blending = {};
         SetBlending(layer.blending, &blending);
-        drm_atomic_intf_->Perform(DRMOps::PLANE_SET_BLEND_TYPE, pipe_id, blending);
+        if (!valid || state.blending != blending) {
+          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_BLEND_TYPE, pipe_id, blending);
+          state.blending = blending;
+        }
         DRMRect src = {};
         SetRect(pipe_info->src_roi, &src);
-        drm_atomic_intf_->Perform(DRMOps::PLANE_SET_SRC_RECT, pipe_id, src);
+        if (!valid || !IsSameRect(state.src, src)) {
+          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_SRC_RECT, pipe_id, src);
+          state.src = src;
+        }
         DRMRect dst = {};
         SetRect(pipe_info->dst_roi, &dst);
-        drm_atomic_intf_->Perform(DRMOps::PLANE_SET_DST_RECT, pipe_id, dst);
+        if (!valid || !IsSameRect(state.dst, dst)) {
+          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_DST_RECT, pipe_id, dst);
+          state.dst = dst;
+        }
 
         uint32_t rot_bit_mask = 0;
         // In case of rotation, rotator handles flips
@@ -421,13 +457,29 @@ void HWDeviceDRM::SetupAtomic(HWLayers *hw_layers, bool validate) {
           }
         }
 
-        drm_atomic_intf_->Perform(DRMOps::PLANE_SET_ROTATION, pipe_id, rot_bit_mask);
-        drm_atomic_intf_->Perform(DRMOps::PLANE_SET_H_DECIMATION, pipe_id,
-                                  pipe_info->horizontal_decimation);
-        drm_atomic_intf_->Perform(DRMOps::PLANE_SET_V_DECIMATION, pipe_id,
-                                  pipe_info->vertical_decimation);
-        drm_atomic_intf_->Perform(DRMOps::PLANE_SET_FB_ID, pipe_id, input_buffer->fb_id);
-        drm_atomic_intf_->Perform(DRMOps::PLANE_SET_CRTC, pipe_id, token_.crtc_id);
+        if (!valid || state.rotation != rot_bit_mask) {
+          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_ROTATION, pipe_id, rot_bit_mask);
+          state.rotation = rot_bit_mask;
+        }
+        if (!valid || state.h_decimation != pipe_info->horizontal_decimation) {
+          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_H_DECIMATION, pipe_id,
+                                    pipe_info->horizontal_decimation);
+          state.h_decimation = pipe_info->horizontal_decimation;
+        }
+        if (!valid || state.v_decimation != pipe_info->vertical_decimation) {
+          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_V_DECIMATION, pipe_id,
+                                    pipe_info->vertical_decimation);
+          state.v_decimation = pipe_info->vertical_decimation;
+        }
+        if (first_in_request || !valid || state.fb_id != input_buffer->fb_id) {
+          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_FB_ID, pipe_id, input_buffer->fb_id);
+          state.fb_id = input_buffer->fb_id;
+        }
+        if (first_in_request || !valid || state.crtc_id != token_.crtc_id) {
+          drm_atomic_intf_->Perform(DRMOps::PLANE_SET_CRTC, pipe_id, token_.crtc_id);
+          state.crtc_id = token_.crtc_id;
+        }
+        plane.pending_valid = true;
         if (!validate && input_buffer->acquire_fence_fd >= 0) {
           drm_atomic_intf_->Perform(DRMOps::PLANE_SET_INPUT_FENCE, pipe_id,
                                     input_buffer->acquire_fence_fd);
@@ -436,7 +488,32 @@ void HWDeviceDRM::SetupAtomic(HWLayers *hw_layers, bool validate) {
     }
 
     // TODO(user): Remove this and enable the one in Init() onces underruns are fixed
-    drm_atomic_intf_->Perform(DRMOps::CRTC_SET_ACTIVE, token_.crtc_id, 1);
+    if (!crtc_active_in_request_) {
+      drm_atomic_intf_->Perform(DRMOps::CRTC_SET_ACTIVE, token_.crtc_id, 1);
+      crtc_active_in_request_ = true;
+    }
+  }
+}
+
+void HWDeviceDRM::UpdatePlaneCache(bool committed) {
+  crtc_active_in_request_ = false;
+  if (!committed) {
+    // Neither the request nor the kernel state can be relied upon, set everything on next frame
+    plane_cache_.clear();
+    return;
+  }
+
+  for (auto it = plane_cache_.begin(); it != plane_cache_.end();) {
+    DRMPlaneCache &plane = it->second;
+    if (!plane.in_request) {
+      // Not used in this commit, the plane may be reset or handed to another display
+      it = plane_cache_.erase(it);
+      continue;
+    }
+    plane.committed = plane.pending;
+    plane.committed_valid = plane.pending_valid;
+    plane.in_request = false;
+    it++;
   }
 }
 
@@ -447,6 +524,7 @@ DisplayError HWDeviceDRM::Validate(HWLayers *hw_layers) {
   int ret = drm_atomic_intf_->Validate();
   if (ret) {
     DLOGE("%s failed with error %d", __FUNCTION__, ret);
+    UpdatePlaneCache(false /* committed */);
     return kErrorHardware;
   }
 
@@ -516,6 +594,7 @@ DisplayError HWDeviceDRM::AtomicCommit(HWLayers *hw_layers) {
   SetupAtomic(hw_layers, false /* validate */);
 
   int ret = drm_atomic_intf_->Commit(false /* synchronous */);
+  UpdatePlaneCache(ret == 0 /* committed */);
   if (ret) {
     DLOGE("%s failed with error %d", __FUNCTION__, ret);
     return kErrorHardware;
@@ -34,6 +34,7 @@
 #include <errno.h>
 #include <pthread.h>
 #include <xf86drmMode.h>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -100,6 +101,31 @@ class HWDeviceDRM : public HWInterface {
   static const int kNumPhysicalDisplays = 2;
   static const int kMaxSysfsCommandLength = 12;
 
+  // Plane properties pushed through drm_atomic_intf_
+  struct DRMPlaneState {
+    uint32_t alpha = 0;
+    uint32_t z_order = 0;
+    sde_drm::DRMBlendType blending = {};
+    sde_drm::DRMRect src = {};
+    sde_drm::DRMRect dst = {};
+    uint32_t rotation = 0;
+    uint32_t h_decimation = 0;
+    uint32_t v_decimation = 0;
+    uint32_t fb_id = 0;
+    uint32_t crtc_id = 0;
+  };
+
+  // The atomic request keeps the properties set for Validate until it is committed, and the kernel
+  // keeps plane properties across commits. Tracking both lets SetupAtomic only perform what
+  // differs, so Commit after an unchanged Validate just adds the input fences.
+  struct DRMPlaneCache {
+    DRMPlaneState committed = {};  // State of the plane after the last commit
+    DRMPlaneState pending = {};    // Committed state updated with the pending request
+    bool committed_valid = false;
+    bool pending_valid = false;
+    bool in_request = false;       // Plane has been set in the pending request
+  };
+
   DisplayError SetFormat(const LayerBufferFormat &source, uint32_t *target);
   DisplayError SetStride(HWDeviceType device_type, LayerBufferFormat format, uint32_t width,
                          uint32_t *target);
@@ -116,6 +142,7 @@ class HWDeviceDRM : public HWInterface {
   DisplayError DefaultCommit(HWLayers *hw_layers);
   DisplayError AtomicCommit(HWLayers *hw_layers);
   void SetupAtomic(HWLayers *hw_layers, bool validate);
+  void UpdatePlaneCache(bool committed);
 
   HWResourceInfo hw_resource_ = {};
   HWPanelInfo hw_panel_info_ = {};
@@ -128,6 +155,8 @@ class HWDeviceDRM : public HWInterface {
   HWMixerAttributes mixer_attributes_ = {};
   sde_drm::DRMManagerInterface *drm_mgr_intf_ = {};
   sde_drm::DRMAtomicReqInterface *drm_atomic_intf_ = {};
+  std::map<uint32_t, DRMPlaneCache> plane_cache_;
+  bool crtc_active_in_request_ = false;
   sde_drm::DRMDisplayToken token_ = {};
   drmModeModeInfo current_mode_ = {};
   bool default_mode_ = false;
@@ -36,13 +36,16 @@
 #include <stdlib.h>
 #include <sys/prctl.h>
 #include <sys/resource.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
+#include <time.h>
 #include <utils/debug.h>
 #include <utils/sys.h>
 #include <xf86drm.h>
 
 #include <algorithm>
 #include <map>
+#include <mutex>
 #include <utility>
 #include <vector>
 
@@ -53,6 +56,16 @@
 namespace sdm {
 
 using drm_utils::DRMMaster;
+using std::lock_guard;
+using std::mutex;
+
+static const int64_t kNsPerSec = 1000000000LL;
+
+static int64_t GetTimeNs() {
+  struct timespec ts = {};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * kNsPerSec + ts.tv_nsec;
+}
 
 DisplayError HWEventsDRM::InitializePollFd() {
   for (uint32_t i = 0; i < event_data_list_.size(); i++) {
@@ -71,6 +84,12 @@ DisplayError HWEventsDRM::InitializePollFd() {
         }
         master->GetHandle(&poll_fds_[i].fd);
         vsync_index_ = i;
+        if (!Debug::IsSWVSyncDisabled()) {
+          sw_vsync_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+          if (sw_vsync_fd_ < 0) {
+            DLOGW("timerfd_create failed, error = %s", strerror(errno));
+          }
+        }
       } break;
       case HWEvent::EXIT: {
         // Create an eventfd to be used to unblock the poll system call when
@@ -90,6 +109,14 @@ DisplayError HWEventsDRM::InitializePollFd() {
     }
   }
 
+  if (sw_vsync_fd_ >= 0) {
+    pollfd poll_fd = {};
+    poll_fd.fd = sw_vsync_fd_;
+    poll_fd.events = POLLIN;
+    poll_fds_.push_back(poll_fd);
+    sw_vsync_index_ = UINT32(poll_fds_.size() - 1);
+  }
+
   return kErrorNone;
 }
 
@@ -180,6 +207,12 @@ DisplayError HWEventsDRM::Deinit() {
 }
 
 DisplayError HWEventsDRM::CloseFds() {
+  if (sw_vsync_fd_ >= 0) {
+    Sys::close_(sw_vsync_fd_);
+    poll_fds_[sw_vsync_index_].fd = -1;
+    sw_vsync_fd_ = -1;
+  }
+
   for (uint32_t i = 0; i < event_data_list_.size(); i++) {
     switch (event_data_list_[i].event_type) {
       case HWEvent::VSYNC:
@@ -218,7 +251,7 @@ void *HWEventsDRM::DisplayEventHandler() {
   setpriority(PRIO_PROCESS, 0, kThreadPriorityUrgent);
 
   while (!exit_threads_) {
-    if (RegisterVSync() != kErrorNone) {
+    if (ArmVSync() != kErrorNone) {
       pthread_exit(0);
       return nullptr;
     }
@@ -254,6 +287,10 @@ void *HWEventsDRM::DisplayEventHandler() {
           break;
       }
     }
+
+    if (sw_vsync_fd_ >= 0 && (poll_fds_[sw_vsync_index_].revents & POLLIN)) {
+      HandleSWVSync();
+    }
   }
 
   pthread_exit(0);
@@ -261,6 +298,50 @@ void *HWEventsDRM::DisplayEventHandler() {
   return nullptr;
 }
 
+DisplayError HWEventsDRM::ArmVSync() {
+  lock_guard<mutex> lock(vsync_lock_);
+
+  // Once the model is locked, vsyncs come from the timer. Every kSWVSyncResyncInterval frames one
+  // hardware vblank is requested instead, which keeps the model in phase or resets it on drift.
+  if (sw_vsync_fd_ >= 0 && vsync_model_.IsLocked() && sw_vsync_count_ < kSWVSyncResyncInterval) {
+    if (!sw_vsync_expiry_ns_) {
+      SetSWVSyncTimer(vsync_model_.GetNextVSync(GetTimeNs(), last_vsync_ns_));
+    }
+    if (sw_vsync_expiry_ns_) {
+      return kErrorNone;
+    }
+  }
+
+  if (sw_vsync_expiry_ns_) {
+    SetSWVSyncTimer(0);
+  }
+
+  // Only one vblank request is kept outstanding, wakeups for other events do not re-arm it.
+  if (vblank_pending_) {
+    return kErrorNone;
+  }
+
+  DisplayError error = RegisterVSync();
+  vblank_pending_ = (error == kErrorNone);
+
+  return error;
+}
+
+void HWEventsDRM::SetSWVSyncTimer(int64_t expiry_ns) {
+  // An expiry of zero disarms the timer.
+  itimerspec timer = {};
+  timer.it_value.tv_sec = expiry_ns / kNsPerSec;
+  timer.it_value.tv_nsec = expiry_ns % kNsPerSec;
+  if (timerfd_settime(sw_vsync_fd_, TFD_TIMER_ABSTIME, &timer, NULL) < 0) {
+    DLOGW("timerfd_settime failed, error = %s. Falling back to hardware vsync", strerror(errno));
+    Sys::close_(sw_vsync_fd_);
+    poll_fds_[sw_vsync_index_].fd = -1;
+    sw_vsync_fd_ = -1;
+    expiry_ns = 0;
+  }
+  sw_vsync_expiry_ns_ = expiry_ns;
+}
+
 DisplayError HWEventsDRM::RegisterVSync() {
   drmVBlank vblank{};
   vblank.request.type = (drmVBlankSeqType)(DRM_VBLANK_RELATIVE | DRM_VBLANK_EVENT);
@@ -292,7 +373,41 @@ void HWEventsDRM::HandleVSync(char *data) {
 void HWEventsDRM::VSyncHandlerCallback(int fd, unsigned int sequence, unsigned int tv_sec,
                                        unsigned int tv_usec, void *data) {
   int64_t timestamp = (int64_t)(tv_sec)*1000000000 + (int64_t)(tv_usec)*1000;
-  reinterpret_cast<HWEventsDRM *>(data)->event_handler_->VSync(timestamp);
+  reinterpret_cast<HWEventsDRM *>(data)->HandleHWVSync(sequence, timestamp);
+}
+
+void HWEventsDRM::HandleHWVSync(uint32_t sequence, int64_t timestamp) {
+  {
+    lock_guard<mutex> lock(vsync_lock_);
+    vblank_pending_ = false;
+    if (sw_vsync_fd_ >= 0) {
+      vsync_model_.AddSample(sequence, timestamp);
+      sw_vsync_count_ = 0;
+    }
+    last_vsync_ns_ = timestamp;
+  }
+
+  event_handler_->VSync(timestamp);
+}
+
+void HWEventsDRM::HandleSWVSync() {
+  int64_t timestamp = 0;
+  {
+    lock_guard<mutex> lock(vsync_lock_);
+    uint64_t expirations = 0;
+    if (Sys::read_(sw_vsync_fd_, &expirations, sizeof(expirations)) != sizeof(expirations) ||
+        !sw_vsync_expiry_ns_) {
+      return;
+    }
+
+    // Report the predicted vsync time rather than the wakeup time.
+    timestamp = sw_vsync_expiry_ns_;
+    sw_vsync_expiry_ns_ = 0;
+    last_vsync_ns_ = timestamp;
+    sw_vsync_count_++;
+  }
+
+  event_handler_->VSync(timestamp);
 }
 
 void HWEventsDRM::HandleIdleTimeout(char *data) {
@@ -32,12 +32,14 @@
 
 #include <sys/poll.h>
 #include <map>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "hw_events_interface.h"
 #include "hw_interface.h"
+#include "hw_vsync_model.h"
 
 namespace sdm {
 
@@ -51,6 +53,8 @@ class HWEventsDRM : public HWEventsInterface {
 
  private:
   static const int kMaxStringLength = 1024;
+  // Software vsyncs delivered between two hardware vblanks used to check the model for drift
+  static const uint32_t kSWVSyncResyncInterval = 60;
 
   typedef void (HWEventsDRM::*EventParser)(char *);
 
@@ -71,11 +75,15 @@ class HWEventsDRM : public HWEventsInterface {
   void HandleThermal(char *data) {}
   void HandleBlank(char *data) {}
   void HandleIdlePowerCollapse(char *data);
+  void HandleHWVSync(uint32_t sequence, int64_t timestamp);
+  void HandleSWVSync();
   void PopulateHWEventData(const vector<HWEvent> &event_list);
   DisplayError SetEventParser();
   DisplayError InitializePollFd();
   DisplayError CloseFds();
   DisplayError RegisterVSync();
+  DisplayError ArmVSync();
+  void SetSWVSyncTimer(int64_t expiry_ns);
 
   HWEventHandler *event_handler_{};
   vector<HWEventData> event_data_list_{};
@@ -84,6 +92,15 @@ class HWEventsDRM : public HWEventsInterface {
   std::string event_thread_name_ = "SDM_EventThread";
   bool exit_threads_ = false;
   uint32_t vsync_index_ = 0;
+  std::mutex vsync_lock_;
+  bool vblank_pending_ = false;
+  // Software vsync, driven by a timerfd that is polled after the event_data_list_ fds
+  HWVSyncModel vsync_model_{};
+  int sw_vsync_fd_ = -1;
+  uint32_t sw_vsync_index_ = 0;
+  uint32_t sw_vsync_count_ = 0;
+  int64_t sw_vsync_expiry_ns_ = 0;
+  int64_t last_vsync_ns_ = 0;
 };
 
 }  // namespace sdm
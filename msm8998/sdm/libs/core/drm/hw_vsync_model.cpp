@@ -0,0 +1,153 @@
+/*
+* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <utils/debug.h>
+
+#include "hw_vsync_model.h"
+
+#define __CLASS__ "HWVSyncModel"
+
+namespace sdm {
+
+void HWVSyncModel::Reset() {
+  head_ = 0;
+  count_ = 0;
+  locked_ = false;
+  period_ns_ = 0;
+  jitter_ns_ = 0;
+}
+
+bool HWVSyncModel::AddSample(uint32_t sequence, int64_t timestamp_ns) {
+  bool in_sync = true;
+
+  if (locked_) {
+    int64_t error_ns = timestamp_ns - Predict(sequence);
+    if (llabs(error_ns) > kMaxDriftNs) {
+      DLOGI_IF(kTagDriverConfig, "vsync drift %" PRId64 " ns at sequence %u, resyncing", error_ns,
+               sequence);
+      Reset();
+      in_sync = false;
+    }
+  }
+
+  if (count_) {
+    // Vblank counter restarted, e.g. across a panel power cycle
+    uint32_t last = (head_ + kMaxSamples - 1) % kMaxSamples;
+    if (INT32(sequence - sequence_[last]) <= 0) {
+      Reset();
+      in_sync = false;
+    }
+  }
+
+  sequence_[head_] = sequence;
+  timestamp_ns_[head_] = timestamp_ns;
+  head_ = (head_ + 1) % kMaxSamples;
+  if (count_ < kMaxSamples) {
+    count_++;
+  }
+
+  Fit();
+
+  return in_sync;
+}
+
+int64_t HWVSyncModel::Predict(uint32_t sequence) const {
+  return ref_timestamp_ns_ + period_ns_ * INT32(sequence - ref_sequence_);
+}
+
+void HWVSyncModel::Fit() {
+  locked_ = false;
+  if (count_ < 2) {
+    return;
+  }
+
+  // Samples relative to the oldest one, so the sums stay well within double precision.
+  uint32_t oldest = (head_ + kMaxSamples - count_) % kMaxSamples;
+  uint32_t base_sequence = sequence_[oldest];
+  int64_t base_timestamp_ns = timestamp_ns_[oldest];
+  double mean_x = 0.0, mean_y = 0.0;
+  for (uint32_t i = 0; i < count_; i++) {
+    uint32_t index = (oldest + i) % kMaxSamples;
+    mean_x += INT32(sequence_[index] - base_sequence);
+    mean_y += static_cast<double>(timestamp_ns_[index] - base_timestamp_ns);
+  }
+  mean_x /= count_;
+  mean_y /= count_;
+
+  double sxx = 0.0, sxy = 0.0;
+  for (uint32_t i = 0; i < count_; i++) {
+    uint32_t index = (oldest + i) % kMaxSamples;
+    double dx = INT32(sequence_[index] - base_sequence) - mean_x;
+    double dy = static_cast<double>(timestamp_ns_[index] - base_timestamp_ns) - mean_y;
+    sxx += dx * dx;
+    sxy += dx * dy;
+  }
+  if (sxx <= 0.0) {
+    return;
+  }
+
+  double period = sxy / sxx;
+  double intercept = mean_y - period * mean_x;
+  double residual = 0.0;
+  for (uint32_t i = 0; i < count_; i++) {
+    uint32_t index = (oldest + i) % kMaxSamples;
+    double x = INT32(sequence_[index] - base_sequence);
+    double error = static_cast<double>(timestamp_ns_[index] - base_timestamp_ns) -
+                   (intercept + period * x);
+    residual += error * error;
+  }
+
+  ref_sequence_ = base_sequence;
+  ref_timestamp_ns_ = base_timestamp_ns + static_cast<int64_t>(llround(intercept));
+  period_ns_ = static_cast<int64_t>(llround(period));
+  jitter_ns_ = static_cast<int64_t>(llround(sqrt(residual / count_)));
+  locked_ = (count_ >= kMinSamples) && (jitter_ns_ <= kMaxJitterNs) &&
+            (period_ns_ >= kMinPeriodNs) && (period_ns_ <= kMaxPeriodNs);
+}
+
+int64_t HWVSyncModel::GetNextVSync(int64_t now_ns, int64_t last_vsync_ns) const {
+  // Anything within half a period of the last reported vsync is that same vsync.
+  int64_t after_ns = last_vsync_ns + period_ns_ / 2;
+  if (now_ns > after_ns) {
+    after_ns = now_ns;
+  }
+
+  int64_t elapsed_ns = after_ns - ref_timestamp_ns_;
+  int64_t count = elapsed_ns / period_ns_;
+  if (elapsed_ns >= 0) {
+    count++;
+  }
+
+  return ref_timestamp_ns_ + count * period_ns_;
+}
+
+}  // namespace sdm
@@ -0,0 +1,77 @@
+/*
+* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HW_VSYNC_MODEL_H__
+#define __HW_VSYNC_MODEL_H__
+
+#include <stdint.h>
+
+namespace sdm {
+
+// Software model of the panel vsync. Hardware vblank timestamps are fit against the vblank
+// sequence number with a least squares line, which gives the vsync period and phase. The residual
+// of that fit is the jitter. Once enough samples agree, vsyncs can be predicted from a timer and
+// only occasional hardware vblanks are needed to track drift.
+class HWVSyncModel {
+ public:
+  void Reset();
+  // Returns false when the sample does not match the current prediction. The model restarts from
+  // this sample in that case.
+  bool AddSample(uint32_t sequence, int64_t timestamp_ns);
+  bool IsLocked() const { return locked_; }
+  // Predicted time of the first vsync after both now_ns and the last reported vsync
+  int64_t GetNextVSync(int64_t now_ns, int64_t last_vsync_ns) const;
+  int64_t GetPeriod() const { return period_ns_; }
+  int64_t GetJitter() const { return jitter_ns_; }
+
+ private:
+  static const uint32_t kMaxSamples = 16;
+  static const uint32_t kMinSamples = 6;
+  static const int64_t kMaxJitterNs = 250000;
+  static const int64_t kMaxDriftNs = 1000000;
+  static const int64_t kMinPeriodNs = 4000000;
+  static const int64_t kMaxPeriodNs = 50000000;
+
+  void Fit();
+  int64_t Predict(uint32_t sequence) const;
+
+  uint32_t sequence_[kMaxSamples] = {};
+  int64_t timestamp_ns_[kMaxSamples] = {};
+  uint32_t head_ = 0;
+  uint32_t count_ = 0;
+  bool locked_ = false;
+  uint32_t ref_sequence_ = 0;
+  int64_t ref_timestamp_ns_ = 0;
+  int64_t period_ns_ = 0;
+  int64_t jitter_ns_ = 0;
+};
+
+}  // namespace sdm
+
+#endif  // __HW_VSYNC_MODEL_H__
@@ -0,0 +1,143 @@
+/*
+* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/utsname.h>
+#include <utils/constants.h>
+#include <utils/debug.h>
+
+#include <string>
+
+#include "hw_caps_cache.h"
+#include "hw_hdmi_mode_cache.h"
+
+#define __CLASS__ "HWCapsCache"
+
+namespace sdm {
+
+static const char *kCachePath = "/data/vendor/display/hw_caps_cache";
+static const char *kCacheTmpPath = "/data/vendor/display/hw_caps_cache.tmp";
+
+// Release and version together identify the kernel build, the version carries the build number
+// and time.
+uint64_t HWCapsCache::GetBuildId() {
+  struct utsname name = {};
+  if (uname(&name)) {
+    return 0;
+  }
+
+  uint64_t hash = HWHDMIModeCache::Hash(name.release, strlen(name.release));
+  return HWHDMIModeCache::Hash(name.version, strlen(name.version), hash);
+}
+
+bool HWCapsCache::ReadString(FILE *fp, std::string *str) {
+  uint32_t size = 0;
+  if (fread(&size, sizeof(size), 1, fp) != 1 || size > kMaxNodeSize) {
+    return false;
+  }
+
+  str->resize(size);
+  return !size || fread(&(*str)[0], 1, size, fp) == size;
+}
+
+bool HWCapsCache::WriteString(FILE *fp, const std::string &str) {
+  uint32_t size = UINT32(str.size());
+  return fwrite(&size, sizeof(size), 1, fp) == 1 &&
+         (!size || fwrite(str.data(), 1, size, fp) == size);
+}
+
+bool HWCapsCache::Load(HWCapsSnapshot *snapshot) {
+  uint64_t build_id = GetBuildId();
+  if (!build_id) {
+    return false;
+  }
+
+  FILE *fp = fopen(kCachePath, "rb");
+  if (!fp) {
+    return false;
+  }
+
+  FileHeader header = {};
+  uint8_t present[3] = {};
+  HWCapsSnapshot cached;
+  bool success = fread(&header, sizeof(header), 1, fp) == 1 && header.magic == kFileMagic &&
+                 header.version == kFileVersion && header.build_id == build_id &&
+                 fread(present, sizeof(present), 1, fp) == 1 &&
+                 fread(&cached.v4l2_rotator_index, sizeof(cached.v4l2_rotator_index), 1,
+                       fp) == 1 &&
+                 ReadString(fp, &cached.mdp_caps) && ReadString(fp, &cached.rotator_caps) &&
+                 ReadString(fp, &cached.bw_mode_bitmap) &&
+                 ReadString(fp, &cached.v4l2_rotator_caps);
+  fclose(fp);
+
+  if (!success || !present[0]) {
+    DLOGI("Discarding hardware capabilities cache %s", kCachePath);
+    return false;
+  }
+
+  cached.has_mdp_caps = present[0];
+  cached.has_rotator_caps = present[1];
+  cached.has_bw_mode_bitmap = present[2];
+  *snapshot = cached;
+  DLOGI("Using cached hardware capabilities for kernel build 0x%" PRIx64, build_id);
+
+  return true;
+}
+
+void HWCapsCache::Store(const HWCapsSnapshot &snapshot) {
+  FileHeader header = {kFileMagic, kFileVersion, GetBuildId()};
+  if (!header.build_id || !snapshot.has_mdp_caps) {
+    return;
+  }
+
+  FILE *fp = fopen(kCacheTmpPath, "wb");
+  if (!fp) {
+    DLOGI_IF(kTagDriverConfig, "Cannot create %s: %s", kCacheTmpPath, strerror(errno));
+    return;
+  }
+
+  uint8_t present[3] = {snapshot.has_mdp_caps, snapshot.has_rotator_caps,
+                        snapshot.has_bw_mode_bitmap};
+  bool success = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+                 fwrite(present, sizeof(present), 1, fp) == 1 &&
+                 fwrite(&snapshot.v4l2_rotator_index, sizeof(snapshot.v4l2_rotator_index), 1,
+                        fp) == 1 &&
+                 WriteString(fp, snapshot.mdp_caps) && WriteString(fp, snapshot.rotator_caps) &&
+                 WriteString(fp, snapshot.bw_mode_bitmap) &&
+                 WriteString(fp, snapshot.v4l2_rotator_caps);
+
+  if (fclose(fp) != 0) {
+    success = false;
+  }
+
+  // Replace the cache atomically so a crash never leaves a partially written file behind.
+  if (!success || rename(kCacheTmpPath, kCachePath) != 0) {
+    DLOGW("Failed to write hardware capabilities cache %s", kCachePath);
+    remove(kCacheTmpPath);
+  }
+}
+
+}  // namespace sdm
@@ -0,0 +1,71 @@
+/*
+* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HW_CAPS_CACHE_H__
+#define __HW_CAPS_CACHE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+namespace sdm {
+
+// Contents of the sysfs nodes HWInfo parses the hardware capabilities from.
+struct HWCapsSnapshot {
+  bool has_mdp_caps = false;
+  std::string mdp_caps;
+  bool has_rotator_caps = false;        // MDSS rotator
+  std::string rotator_caps;
+  bool has_bw_mode_bitmap = false;
+  std::string bw_mode_bitmap;
+  int32_t v4l2_rotator_index = -1;      // videoN node of the V4L2 rotator, -1 if there is none
+  std::string v4l2_rotator_caps;
+};
+
+// The capability nodes only change along with the kernel. A snapshot is persisted together with
+// the kernel build it was read on, so composer restarts skip reading and scanning sysfs.
+class HWCapsCache {
+ public:
+  static bool Load(HWCapsSnapshot *snapshot);
+  static void Store(const HWCapsSnapshot &snapshot);
+
+ private:
+  static const uint32_t kFileMagic = 0x50414348;  // "HCAP"
+  static const uint32_t kFileVersion = 1;
+  static const uint32_t kMaxNodeSize = 64 * 1024;
+
+  struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t build_id;
+  };
+
+  static uint64_t GetBuildId();
+  static bool ReadString(FILE *fp, std::string *str);
+  static bool WriteString(FILE *fp, const std::string &str);
+};
+
+}  // namespace sdm
+
+#endif  // __HW_CAPS_CACHE_H__
@@ -163,4 +163,133 @@ DisplayError HWColorManager::SetPADither(const PPFeatureInfo &feature,
   return ret;
 }
 
+static inline void HashBytes(const void *data, size_t size, uint64_t *hash) {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; i++) {
+    *hash = (*hash ^ bytes[i]) * 0x100000001b3ULL;
+  }
+}
+
+template <class T>
+static inline void HashValue(const T &value, uint64_t *hash) {
+  HashBytes(&value, sizeof(value), hash);
+}
+
+static inline void HashTable(const uint32_t *table, uint32_t entries, uint64_t *hash) {
+  HashValue(entries, hash);
+  if (table) {
+    HashBytes(table, entries * sizeof(uint32_t), hash);
+  }
+}
+
+uint64_t HWColorManager::GetFeatureDigest(const PPFeatureInfo &feature) {
+  const void *config = feature.GetConfigData();
+  uint64_t hash = 0xcbf29ce484222325ULL;
+
+  // Read backs have to reach the driver every time.
+  if (!config || (feature.enable_flags_ & kOpsRead)) {
+    return 0;
+  }
+
+  HashValue(feature.feature_id_, &hash);
+  HashValue(feature.feature_version_, &hash);
+  HashValue(feature.disp_id_, &hash);
+  HashValue(feature.enable_flags_, &hash);
+
+  // Tables are referenced by pointer, so every field is hashed individually.
+  switch (feature.feature_id_) {
+  case kGlobalColorFeaturePcc: {
+    const SDEPccCfg *pcc = reinterpret_cast<const SDEPccCfg *>(config);
+    HashValue(pcc->red, &hash);
+    HashValue(pcc->green, &hash);
+    HashValue(pcc->blue, &hash);
+    break;
+  }
+
+  case kGlobalColorFeatureIgc:
+    if (feature.feature_version_ == PPFeatureVersion::kSDEIgcV30) {
+      const SDEIgcV30LUTData *igc = reinterpret_cast<const SDEIgcV30LUTData *>(config);
+      HashValue(igc->table_fmt, &hash);
+      HashValue(igc->strength, &hash);
+      HashTable(reinterpret_cast<const uint32_t *>(igc->c0_c1_data), igc->len, &hash);
+      HashTable(reinterpret_cast<const uint32_t *>(igc->c2_data), igc->len, &hash);
+    } else {
+      const SDEIgcLUTData *igc = reinterpret_cast<const SDEIgcLUTData *>(config);
+      HashValue(igc->table_fmt, &hash);
+      HashTable(igc->c0_c1_data, igc->len, &hash);
+      HashTable(igc->c2_data, igc->len, &hash);
+    }
+    break;
+
+  case kGlobalColorFeaturePgc:
+  case kMixerColorFeatureGc: {
+    const SDEPgcLUTData *pgc = reinterpret_cast<const SDEPgcLUTData *>(config);
+    HashTable(pgc->c0_data, pgc->len, &hash);
+    HashTable(pgc->c1_data, pgc->len, &hash);
+    HashTable(pgc->c2_data, pgc->len, &hash);
+    break;
+  }
+
+  case kGlobalColorFeaturePaV2: {
+    const SDEPaData *pa = reinterpret_cast<const SDEPaData *>(config);
+    HashValue(pa->mode, &hash);
+    HashValue(pa->hue_adj, &hash);
+    HashValue(pa->sat_adj, &hash);
+    HashValue(pa->val_adj, &hash);
+    HashValue(pa->cont_adj, &hash);
+    const SDEPaMemColorData *mem_colors[] = { &pa->skin, &pa->sky, &pa->foliage };
+    for (const SDEPaMemColorData *mem_color : mem_colors) {
+      HashValue(mem_color->adjust_p0, &hash);
+      HashValue(mem_color->adjust_p1, &hash);
+      HashValue(mem_color->adjust_p2, &hash);
+      HashValue(mem_color->blend_gain, &hash);
+      HashValue(mem_color->sat_hold, &hash);
+      HashValue(mem_color->val_hold, &hash);
+      HashValue(mem_color->hue_region, &hash);
+      HashValue(mem_color->sat_region, &hash);
+      HashValue(mem_color->val_region, &hash);
+    }
+    HashValue(pa->six_zone_thresh, &hash);
+    HashValue(pa->six_zone_adj_p0, &hash);
+    HashValue(pa->six_zone_adj_p1, &hash);
+    HashValue(pa->six_zone_sat_hold, &hash);
+    HashValue(pa->six_zone_val_hold, &hash);
+    HashTable(pa->six_zone_curve_p0, pa->six_zone_len, &hash);
+    HashTable(pa->six_zone_curve_p1, pa->six_zone_len, &hash);
+    break;
+  }
+
+  case kGlobalColorFeatureDither: {
+    const SDEDitherCfg *dither = reinterpret_cast<const SDEDitherCfg *>(config);
+    HashValue(dither->g_y_depth, &hash);
+    HashValue(dither->r_cr_depth, &hash);
+    HashValue(dither->b_cb_depth, &hash);
+    HashValue(dither->length, &hash);
+    HashValue(dither->dither_matrix, &hash);
+    HashValue(dither->temporal_en, &hash);
+    break;
+  }
+
+  case kGlobalColorFeatureGamut: {
+    const SDEGamutCfg *gamut = reinterpret_cast<const SDEGamutCfg *>(config);
+    HashValue(gamut->mode, &hash);
+    HashValue(gamut->map_en, &hash);
+    for (int i = 0; i < SDEGamutCfg::kGamutTableNum; i++) {
+      HashTable(gamut->c0_data[i], gamut->tbl_size[i], &hash);
+      HashTable(gamut->c1_c2_data[i], gamut->tbl_size[i], &hash);
+    }
+    for (int i = 0; i < SDEGamutCfg::kGamutScaleoffTableNum; i++) {
+      HashTable(gamut->scale_off_data[i], gamut->tbl_scale_off_sz[i], &hash);
+    }
+    break;
+  }
+
+  default:
+    // Layout of the remaining payloads is not known well enough to compare them.
+    return 0;
+  }
+
+  return hash ? hash : 1;
+}
+
 }  // namespace sdm
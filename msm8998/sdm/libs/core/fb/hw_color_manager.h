@@ -51,6 +51,10 @@ class HWColorManager {
   static DisplayError (*SetFeature[kMaxNumPPFeatures])(const PPFeatureInfo &feature,
                                                        msmfb_mdp_pp *kernel_params);
 
+  // Returns a digest of the feature configuration including its lookup tables, or 0 if the
+  // configuration can not be compared and always has to be programmed.
+  static uint64_t GetFeatureDigest(const PPFeatureInfo &feature);
+
  protected:
   HWColorManager() {}
 };
@@ -223,46 +223,84 @@ DisplayError HWDevice::Validate(HWLayers *hw_layers) {
         mdp_input_layer &mdp_layer = mdp_in_layers_[mdp_layer_count];
         mdp_layer_buffer &mdp_buffer = mdp_layer.buffer;
 
-        mdp_buffer.width = input_buffer.width;
-        mdp_buffer.height = input_buffer.height;
-        mdp_buffer.comp_ratio.denom = 1000;
-        mdp_buffer.comp_ratio.numer = UINT32(hw_layers->config[i].compression * 1000);
-
-        if (layer.flags.solid_fill) {
-          mdp_buffer.format = MDP_ARGB_8888;
-        } else {
-          error = SetFormat(input_buffer.format, &mdp_buffer.format);
-          if (error != kErrorNone) {
-            return error;
+        MDPLayerInput layer_input;
+        layer_input.pipe_info = *pipe_info;
+        layer_input.width = input_buffer.width;
+        layer_input.height = input_buffer.height;
+        layer_input.format = input_buffer.format;
+        layer_input.compression = hw_layers->config[i].compression;
+        layer_input.buffer_flags = layer.input_buffer.flags.flags;
+        layer_input.solid_fill = layer.flags.solid_fill;
+        layer_input.cursor = layer.flags.cursor && is_cursor_pipe_used;
+        layer_input.rotator_used = is_rotator_used;
+        layer_input.plane_alpha = layer.plane_alpha;
+        layer_input.blending = layer.blending;
+        layer_input.transform = layer.transform;
+        layer_input.color_primaries = layer.input_buffer.color_metadata.colorPrimaries;
+        layer_input.range = layer.input_buffer.color_metadata.range;
+        layer_input.igc = layer.input_buffer.igc;
+        layer_input.solid_fill_color = layer.solid_fill_color;
+
+        // A slot built from the same inputs in an earlier Validate is left as programmed
+        if (!mdp_layer_built_[mdp_layer_count] ||
+            !IsSameMDPLayerInput(mdp_layer_inputs_[mdp_layer_count], layer_input)) {
+          mdp_layer_built_[mdp_layer_count] = false;
+          memset(&mdp_layer, 0, sizeof(mdp_layer));
+          memset(&pp_params_[mdp_layer_count], 0, sizeof(pp_params_[mdp_layer_count]));
+          memset(&igc_lut_data_[mdp_layer_count], 0, sizeof(igc_lut_data_[mdp_layer_count]));
+          hw_scale_->ResetScaleParams(mdp_layer_count, pipe_info->sub_block_type);
+
+          mdp_buffer.width = input_buffer.width;
+          mdp_buffer.height = input_buffer.height;
+          mdp_buffer.comp_ratio.denom = 1000;
+          mdp_buffer.comp_ratio.numer = UINT32(hw_layers->config[i].compression * 1000);
+
+          if (layer.flags.solid_fill) {
+            mdp_buffer.format = MDP_ARGB_8888;
+          } else {
+            error = SetFormat(input_buffer.format, &mdp_buffer.format);
+            if (error != kErrorNone) {
+              return error;
+            }
           }
-        }
-        mdp_layer.alpha = layer.plane_alpha;
-        mdp_layer.z_order = UINT16(pipe_info->z_order);
-        mdp_layer.transp_mask = 0xffffffff;
-        SetBlending(layer.blending, &mdp_layer.blend_op);
-        mdp_layer.pipe_ndx = pipe_info->pipe_id;
-        mdp_layer.horz_deci = pipe_info->horizontal_decimation;
-        mdp_layer.vert_deci = pipe_info->vertical_decimation;
-
-        SetRect(pipe_info->src_roi, &mdp_layer.src_rect);
-        SetRect(pipe_info->dst_roi, &mdp_layer.dst_rect);
-        SetMDPFlags(&layer, is_rotator_used, is_cursor_pipe_used, &mdp_layer.flags);
-        SetCSC(layer.input_buffer.color_metadata, &mdp_layer.color_space);
-        if (pipe_info->flags & kIGC) {
-          SetIGC(&layer.input_buffer, mdp_layer_count);
-        }
-        if (pipe_info->flags & kMultiRect) {
-          mdp_layer.flags |= MDP_LAYER_MULTIRECT_ENABLE;
-          if (pipe_info->flags & kMultiRectParallelMode) {
-            mdp_layer.flags |= MDP_LAYER_MULTIRECT_PARALLEL_MODE;
+          mdp_layer.alpha = layer.plane_alpha;
+          mdp_layer.z_order = UINT16(pipe_info->z_order);
+          mdp_layer.transp_mask = 0xffffffff;
+          SetBlending(layer.blending, &mdp_layer.blend_op);
+          mdp_layer.pipe_ndx = pipe_info->pipe_id;
+          mdp_layer.horz_deci = pipe_info->horizontal_decimation;
+          mdp_layer.vert_deci = pipe_info->vertical_decimation;
+
+          SetRect(pipe_info->src_roi, &mdp_layer.src_rect);
+          SetRect(pipe_info->dst_roi, &mdp_layer.dst_rect);
+          SetMDPFlags(&layer, is_rotator_used, is_cursor_pipe_used, &mdp_layer.flags);
+          SetCSC(layer.input_buffer.color_metadata, &mdp_layer.color_space);
+          if (pipe_info->flags & kIGC) {
+            SetIGC(&layer.input_buffer, mdp_layer_count);
           }
+          if (pipe_info->flags & kMultiRect) {
+            mdp_layer.flags |= MDP_LAYER_MULTIRECT_ENABLE;
+            if (pipe_info->flags & kMultiRectParallelMode) {
+              mdp_layer.flags |= MDP_LAYER_MULTIRECT_PARALLEL_MODE;
+            }
+          }
+          mdp_layer.bg_color = layer.solid_fill_color;
+
+          // HWScaleData to MDP driver
+          hw_scale_->SetHWScaleData(pipe_info->scale_data, mdp_layer_count, &mdp_commit,
+                                    pipe_info->sub_block_type);
+          mdp_layer.scale = hw_scale_->GetScaleDataRef(mdp_layer_count, pipe_info->sub_block_type);
+
+          mdp_layer_inputs_[mdp_layer_count] = layer_input;
+          mdp_layer_flags_[mdp_layer_count] = mdp_layer.flags;
+          mdp_layer_built_[mdp_layer_count] = true;
+        } else {
+          mdp_layer.flags = mdp_layer_flags_[mdp_layer_count];
         }
-        mdp_layer.bg_color = layer.solid_fill_color;
 
-        // HWScaleData to MDP driver
-        hw_scale_->SetHWScaleData(pipe_info->scale_data, mdp_layer_count, &mdp_commit,
-                                  pipe_info->sub_block_type);
-        mdp_layer.scale = hw_scale_->GetScaleDataRef(mdp_layer_count, pipe_info->sub_block_type);
+        // Buffer and fence are filled in Commit
+        mdp_buffer.plane_count = 0;
+        mdp_buffer.fence = -1;
 
         mdp_layer_count++;
 
@@ -318,6 +356,7 @@ DisplayError HWDevice::Validate(HWLayers *hw_layers) {
     HWDestScaleInfo *dest_scale_info = it->second;
 
     mdp_destination_scaler_data *dest_scalar_data = &mdp_dest_scalar_data_[index];
+    hw_scale_->ResetScaleParams(index, kHWDestinationScalar);
     hw_scale_->SetHWScaleData(dest_scale_info->scale_data, index, &mdp_commit,
                               kHWDestinationScalar);
 
@@ -561,6 +600,8 @@ DisplayError HWDevice::Commit(HWLayers *hw_layers) {
 
 DisplayError HWDevice::Flush() {
   ResetDisplayParams();
+  hw_scale_->ResetScaleParams();
+  mdp_layer_built_.reset();
   mdp_layer_commit_v1 &mdp_commit = mdp_disp_commit_.commit_v1;
   mdp_commit.input_layer_cnt = 0;
   mdp_commit.output_layer = NULL;
@@ -780,6 +821,8 @@ int HWDevice::GetFBNodeIndex(HWDeviceType device_type) {
 }
 
 void HWDevice::PopulateHWPanelInfo() {
+  // Panel mode is an input of the layer flags
+  mdp_layer_built_.reset();
   hw_panel_info_ = HWPanelInfo();
   GetHWPanelInfoByNode(fb_node_index_, &hw_panel_info_);
   DLOGI("Device type = %d, Display Port = %d, Display Mode = %d, Device Node = %d, Is Primary = %d",
@@ -1061,22 +1104,16 @@ bool HWDevice::EnableHotPlugDetection(int enable) {
 }
 
 void HWDevice::ResetDisplayParams() {
+  // Input layers, their scale blocks and IGC params are reset by Validate for the slots it has to
+  // rebuild, the rest keep what was programmed for the previous frame.
   memset(&mdp_disp_commit_, 0, sizeof(mdp_disp_commit_));
-  memset(&mdp_in_layers_, 0, sizeof(mdp_in_layers_));
   memset(&mdp_out_layer_, 0, sizeof(mdp_out_layer_));
   mdp_out_layer_.buffer.fence = -1;
-  hw_scale_->ResetScaleParams();
-  memset(&pp_params_, 0, sizeof(pp_params_));
-  memset(&igc_lut_data_, 0, sizeof(igc_lut_data_));
 
   for (size_t i = 0; i < mdp_dest_scalar_data_.size(); i++) {
     mdp_dest_scalar_data_[i] = {};
   }
 
-  for (uint32_t i = 0; i < kMaxSDELayers * 2; i++) {
-    mdp_in_layers_[i].buffer.fence = -1;
-  }
-
   mdp_disp_commit_.version = MDP_COMMIT_VERSION_1_0;
   mdp_disp_commit_.commit_v1.input_layers = mdp_in_layers_;
   mdp_disp_commit_.commit_v1.output_layer = &mdp_out_layer_;
@@ -1085,6 +1122,90 @@ void HWDevice::ResetDisplayParams() {
   mdp_disp_commit_.commit_v1.dest_scaler = mdp_dest_scalar_data_.data();
 }
 
+bool HWDevice::IsSameMDPLayerInput(const MDPLayerInput &lhs, const MDPLayerInput &rhs) {
+  const HWPipeInfo &lpipe = lhs.pipe_info;
+  const HWPipeInfo &rpipe = rhs.pipe_info;
+
+  return (lpipe.pipe_id == rpipe.pipe_id) && (lpipe.sub_block_type == rpipe.sub_block_type) &&
+         (lpipe.src_roi == rpipe.src_roi) && (lpipe.dst_roi == rpipe.dst_roi) &&
+         (lpipe.horizontal_decimation == rpipe.horizontal_decimation) &&
+         (lpipe.vertical_decimation == rpipe.vertical_decimation) &&
+         (lpipe.z_order == rpipe.z_order) && (lpipe.flags == rpipe.flags) &&
+         IsSameScaleData(lpipe.scale_data, rpipe.scale_data) &&
+         (lhs.width == rhs.width) && (lhs.height == rhs.height) && (lhs.format == rhs.format) &&
+         (lhs.compression == rhs.compression) && (lhs.buffer_flags == rhs.buffer_flags) &&
+         (lhs.solid_fill == rhs.solid_fill) && (lhs.cursor == rhs.cursor) &&
+         (lhs.rotator_used == rhs.rotator_used) && (lhs.plane_alpha == rhs.plane_alpha) &&
+         (lhs.blending == rhs.blending) && (lhs.transform == rhs.transform) &&
+         (lhs.color_primaries == rhs.color_primaries) && (lhs.range == rhs.range) &&
+         (lhs.igc == rhs.igc) && (lhs.solid_fill_color == rhs.solid_fill_color);
+}
+
+bool HWDevice::IsSamePixelExtension(const HWPixelExtension &lhs, const HWPixelExtension &rhs) {
+  return (lhs.extension == rhs.extension) && (lhs.overfetch == rhs.overfetch) &&
+         (lhs.repeat == rhs.repeat);
+}
+
+// Compares the fields HWScale hands over to the driver
+bool HWDevice::IsSameScaleData(const HWScaleData &lhs, const HWScaleData &rhs) {
+  if ((lhs.enable.scale != rhs.enable.scale) ||
+      (lhs.enable.direction_detection != rhs.enable.direction_detection) ||
+      (lhs.enable.detail_enhance != rhs.enable.detail_enhance) ||
+      (lhs.dst_width != rhs.dst_width) || (lhs.dst_height != rhs.dst_height) ||
+      (lhs.y_rgb_filter_cfg != rhs.y_rgb_filter_cfg) ||
+      (lhs.uv_filter_cfg != rhs.uv_filter_cfg) ||
+      (lhs.alpha_filter_cfg != rhs.alpha_filter_cfg) || (lhs.blend_cfg != rhs.blend_cfg) ||
+      (lhs.lut_flag.lut_swap != rhs.lut_flag.lut_swap) ||
+      (lhs.lut_flag.lut_dir_wr != rhs.lut_flag.lut_dir_wr) ||
+      (lhs.lut_flag.lut_y_cir_wr != rhs.lut_flag.lut_y_cir_wr) ||
+      (lhs.lut_flag.lut_uv_cir_wr != rhs.lut_flag.lut_uv_cir_wr) ||
+      (lhs.lut_flag.lut_y_sep_wr != rhs.lut_flag.lut_y_sep_wr) ||
+      (lhs.lut_flag.lut_uv_sep_wr != rhs.lut_flag.lut_uv_sep_wr) ||
+      (lhs.dir_lut_idx != rhs.dir_lut_idx) || (lhs.y_rgb_cir_lut_idx != rhs.y_rgb_cir_lut_idx) ||
+      (lhs.uv_cir_lut_idx != rhs.uv_cir_lut_idx) ||
+      (lhs.y_rgb_sep_lut_idx != rhs.y_rgb_sep_lut_idx) ||
+      (lhs.uv_sep_lut_idx != rhs.uv_sep_lut_idx)) {
+    return false;
+  }
+
+  for (int i = 0; i < MAX_PLANES; i++) {
+    const HWPlane &lplane = lhs.plane[i];
+    const HWPlane &rplane = rhs.plane[i];
+    if ((lplane.init_phase_x != rplane.init_phase_x) ||
+        (lplane.phase_step_x != rplane.phase_step_x) ||
+        (lplane.init_phase_y != rplane.init_phase_y) ||
+        (lplane.phase_step_y != rplane.phase_step_y) ||
+        !IsSamePixelExtension(lplane.left, rplane.left) ||
+        !IsSamePixelExtension(lplane.top, rplane.top) ||
+        !IsSamePixelExtension(lplane.right, rplane.right) ||
+        !IsSamePixelExtension(lplane.bottom, rplane.bottom) ||
+        (lplane.roi_width != rplane.roi_width) || (lplane.preload_x != rplane.preload_x) ||
+        (lplane.preload_y != rplane.preload_y) || (lplane.src_width != rplane.src_width) ||
+        (lplane.src_height != rplane.src_height)) {
+      return false;
+    }
+  }
+
+  const HWDetailEnhanceData &lde = lhs.detail_enhance;
+  const HWDetailEnhanceData &rde = rhs.detail_enhance;
+  if ((lde.enable != rde.enable) || (lde.sharpen_level1 != rde.sharpen_level1) ||
+      (lde.sharpen_level2 != rde.sharpen_level2) || (lde.clip != rde.clip) ||
+      (lde.limit != rde.limit) || (lde.thr_quiet != rde.thr_quiet) ||
+      (lde.thr_dieout != rde.thr_dieout) || (lde.thr_low != rde.thr_low) ||
+      (lde.thr_high != rde.thr_high) || (lde.prec_shift != rde.prec_shift)) {
+    return false;
+  }
+
+  for (int i = 0; i < MAX_DETAIL_ENHANCE_CURVE; i++) {
+    if ((lde.adjust_a[i] != rde.adjust_a[i]) || (lde.adjust_b[i] != rde.adjust_b[i]) ||
+        (lde.adjust_c[i] != rde.adjust_c[i])) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 void HWDevice::SetCSC(const ColorMetaData &color_metadata, mdp_color_space *color_space) {
   switch (color_metadata.colorPrimaries) {
   case ColorPrimaries_BT601_6_525:
@@ -29,6 +29,7 @@
 #include <linux/msm_mdp_ext.h>
 #include <linux/mdss_rotator.h>
 #include <pthread.h>
+#include <bitset>
 #include <vector>
 
 #include "hw_interface.h"
@@ -160,6 +161,35 @@ class HWDevice : public HWInterface {
   std::vector<mdp_destination_scaler_data> mdp_dest_scalar_data_;
   int bl_level_update_commit = -1;
   bool bl_update_commit = false;
+
+ private:
+  // Inputs an mdp_input_layer slot, its scale block and IGC params were built from in Validate
+  struct MDPLayerInput {
+    HWPipeInfo pipe_info;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    LayerBufferFormat format = kFormatInvalid;
+    float compression = 1.0f;
+    uint32_t buffer_flags = 0;
+    bool solid_fill = false;
+    bool cursor = false;
+    bool rotator_used = false;
+    uint8_t plane_alpha = 0;
+    LayerBlending blending = kBlendingPremultiplied;
+    LayerTransform transform;
+    ColorPrimaries color_primaries = ColorPrimaries_BT709_5;
+    ColorRange range = Range_Limited;
+    LayerIGC igc = kIGCNotSpecified;
+    uint32_t solid_fill_color = 0;
+  };
+
+  static bool IsSameMDPLayerInput(const MDPLayerInput &lhs, const MDPLayerInput &rhs);
+  static bool IsSamePixelExtension(const HWPixelExtension &lhs, const HWPixelExtension &rhs);
+  static bool IsSameScaleData(const HWScaleData &lhs, const HWScaleData &rhs);
+
+  MDPLayerInput mdp_layer_inputs_[kMaxSDELayers * 2];
+  uint32_t mdp_layer_flags_[kMaxSDELayers * 2] = {};  // Flags as built, Commit updates the layer's
+  std::bitset<kMaxSDELayers * 2> mdp_layer_built_;  // Slots holding a layer built in Validate
 };
 
 }  // namespace sdm
@@ -40,6 +40,7 @@
 
 #include <vector>
 #include <map>
+#include <string>
 #include <utility>
 
 #include "hw_hdmi.h"
@@ -210,12 +211,17 @@ DisplayError HWHDMI::Init() {
     return kErrorHardware;
   }
 
-  error = ReadTimingInfo();
-  if (error != kErrorNone) {
-    Deinit();
-    return error;
+  if (!ReadCachedModes()) {
+    error = ReadTimingInfo();
+    if (error != kErrorNone) {
+      Deinit();
+      return error;
+    }
+    CacheModes();
   }
 
+  dfps_switches_.clear();
+
   ReadScanInfo();
 
   GetPanelS3DMode();
@@ -234,6 +240,18 @@ DisplayError HWHDMI::Init() {
   return error;
 }
 
+DisplayError HWHDMI::Deinit() {
+  int *sysfs_fds[] = { &dfps_mode_fd_, &dynamic_fps_fd_ };
+  for (int *fd : sysfs_fds) {
+    if (*fd >= 0) {
+      Sys::close_(*fd);
+      *fd = -1;
+    }
+  }
+
+  return HWDevice::Deinit();
+}
+
 DisplayError HWHDMI::GetNumDisplayAttributes(uint32_t *count) {
   *count = UINT32(hdmi_modes_.size());
   if (*count <= 0) {
@@ -266,6 +284,21 @@ DisplayError HWHDMI::ReadEDIDInfo() {
   }
   Sys::close_(edid_file);
 
+  char edid_s3d_str[kPageSize] = {'\0'};
+  char edid_s3d_path[kMaxStringLength] = {'\0'};
+  snprintf(edid_s3d_path, sizeof(edid_s3d_path), "%s%d/edid_3d_modes", fb_path_, fb_node_index_);
+  int edid_s3d_node = Sys::open_(edid_s3d_path, O_RDONLY);
+  if (edid_s3d_node >= 0) {
+    if (Sys::pread_(edid_s3d_node, edid_s3d_str, sizeof(edid_s3d_str)-1, 0) < 0) {
+      edid_s3d_str[0] = '\0';
+    }
+    Sys::close_(edid_s3d_node);
+  } else {
+    DLOGW("%s could not be opened : %s", edid_s3d_path, strerror(errno));
+  }
+
+  ReadEDIDHash(edid_str, edid_s3d_str);
+
   DLOGI("EDID mode string: %s", edid_str);
   while (length > 1 && isspace(edid_str[length-1])) {
     --length;
@@ -289,9 +322,53 @@ DisplayError HWHDMI::ReadEDIDInfo() {
     }
   }
 
+  ReadS3DInfo(edid_s3d_str);
+
   return kErrorNone;
 }
 
+// Identifies the sink by its raw EDID. The mode strings are hashed as well, since they also depend
+// on what the driver filters out, and are all that is left when edid_raw_data is not exposed.
+void HWHDMI::ReadEDIDHash(const char *edid_modes, const char *edid_s3d_modes) {
+  char edid_raw_path[kMaxStringLength] = {'\0'};
+  snprintf(edid_raw_path, sizeof(edid_raw_path), "%s%d/edid_raw_data", fb_path_, fb_node_index_);
+
+  uint64_t hash = HWHDMIModeCache::kHashSeed;
+  int edid_raw_node = Sys::open_(edid_raw_path, O_RDONLY);
+  if (edid_raw_node >= 0) {
+    char edid_raw[kPageSize] = {'\0'};
+    ssize_t length = Sys::pread_(edid_raw_node, edid_raw, sizeof(edid_raw), 0);
+    if (length > 0) {
+      hash = HWHDMIModeCache::Hash(edid_raw, size_t(length), hash);
+    }
+    Sys::close_(edid_raw_node);
+  }
+
+  hash = HWHDMIModeCache::Hash(edid_modes, strlen(edid_modes), hash);
+  edid_hash_ = HWHDMIModeCache::Hash(edid_s3d_modes, strlen(edid_s3d_modes), hash);
+}
+
+bool HWHDMI::ReadCachedModes() {
+  HDMIModeTable table;
+  if (!HWHDMIModeCache::Find(edid_hash_, &table) || table.video_formats != hdmi_modes_) {
+    return false;
+  }
+
+  supported_video_modes_ = table.timing_info;
+  DLOGI("Using cached timing info of %zu modes for EDID 0x%" PRIx64, hdmi_modes_.size(),
+        edid_hash_);
+
+  return true;
+}
+
+void HWHDMI::CacheModes() {
+  HDMIModeTable table;
+  table.edid_hash = edid_hash_;
+  table.video_formats = hdmi_modes_;
+  table.timing_info = supported_video_modes_;
+  HWHDMIModeCache::Insert(table);
+}
+
 DisplayError HWHDMI::GetDisplayAttributes(uint32_t index,
                                           HWDisplayAttributes *display_attributes) {
   DTRACE_SCOPED();
@@ -389,6 +466,8 @@ DisplayError HWHDMI::SetDisplayAttributes(uint32_t index) {
   active_config_index_ = index;
 
   frame_rate_ = timing_mode->refresh_rate;
+  // The driver may reset its dfps mode along with the timing
+  dfps_mode_ = kModeMAX;
 
   // Get the display attributes for current active config index
   GetDisplayAttributes(active_config_index_, &display_attributes_);
@@ -669,16 +748,18 @@ void HWHDMI::SetSourceProductInformation(const char *node, const char *name) {
 
 DisplayError HWHDMI::GetDisplayS3DSupport(uint32_t index,
                                           HWDisplayAttributes *attrib) {
-  ssize_t length = -1;
-  char edid_s3d_str[kPageSize] = {'\0'};
-  char edid_s3d_path[kMaxStringLength] = {'\0'};
-  snprintf(edid_s3d_path, sizeof(edid_s3d_path), "%s%d/edid_3d_modes", fb_path_, fb_node_index_);
-
-  if (index > hdmi_modes_.size()) {
+  if (index >= s3d_config_.size()) {
     return kErrorNotSupported;
   }
 
-  attrib->s3d_config[kS3DModeNone] = 1;
+  attrib->s3d_config = s3d_config_[index];
+
+  return kErrorNone;
+}
+
+// Parses edid_3d_modes once per connect into s3d_config_
+void HWHDMI::ReadS3DInfo(char *edid_s3d_modes) {
+  s3d_config_.assign(hdmi_modes_.size(), 1 << kS3DModeNone);
 
   // Three level inception!
   // The string looks like 16=SSH,4=FP:TAB:SSH,5=FP:SSH,32=FP:TAB:SSH
@@ -686,42 +767,32 @@ DisplayError HWHDMI::GetDisplayS3DSupport(uint32_t index,
   char *saveptr_l1 = NULL, *saveptr_l2 = NULL, *saveptr_l3 = NULL;
   char *l1 = NULL, *l2 = NULL, *l3 = NULL;
 
-  int edid_s3d_node = Sys::open_(edid_s3d_path, O_RDONLY);
-  if (edid_s3d_node < 0) {
-    DLOGW("%s could not be opened : %s", edid_s3d_path, strerror(errno));
-    return kErrorNotSupported;
-  }
-
-  length = Sys::pread_(edid_s3d_node, edid_s3d_str, sizeof(edid_s3d_str)-1, 0);
-  if (length <= 0) {
-    Sys::close_(edid_s3d_node);
-    return kErrorNotSupported;
-  }
-
-  l1 = strtok_r(edid_s3d_str, ",", &saveptr_l1);
+  l1 = strtok_r(edid_s3d_modes, ",", &saveptr_l1);
   while (l1 != NULL) {
     l2 = strtok_r(l1, "=", &saveptr_l2);
     if (l2 != NULL) {
-      if (hdmi_modes_[index] == (uint32_t)atoi(l2)) {
-          l3 = strtok_r(saveptr_l2, ":", &saveptr_l3);
-          while (l3 != NULL) {
-            if (strncmp("SSH", l3, strlen("SSH")) == 0) {
-              attrib->s3d_config[kS3DModeLR] = 1;
-              attrib->s3d_config[kS3DModeRL] = 1;
-            } else if (strncmp("TAB", l3, strlen("TAB")) == 0) {
-              attrib->s3d_config[kS3DModeTB] = 1;
-            } else if (strncmp("FP", l3, strlen("FP")) == 0) {
-              attrib->s3d_config[kS3DModeFP] = 1;
-            }
-            l3 = strtok_r(NULL, ":", &saveptr_l3);
-          }
+      uint32_t s3d_config = 0;
+      l3 = strtok_r(saveptr_l2, ":", &saveptr_l3);
+      while (l3 != NULL) {
+        if (strncmp("SSH", l3, strlen("SSH")) == 0) {
+          s3d_config |= (1 << kS3DModeLR) | (1 << kS3DModeRL);
+        } else if (strncmp("TAB", l3, strlen("TAB")) == 0) {
+          s3d_config |= (1 << kS3DModeTB);
+        } else if (strncmp("FP", l3, strlen("FP")) == 0) {
+          s3d_config |= (1 << kS3DModeFP);
+        }
+        l3 = strtok_r(NULL, ":", &saveptr_l3);
+      }
+
+      uint32_t video_format = UINT32(atoi(l2));
+      for (uint32_t i = 0; i < hdmi_modes_.size(); i++) {
+        if (hdmi_modes_[i] == video_format) {
+          s3d_config_[i] |= s3d_config;
+        }
       }
     }
     l1 = strtok_r(NULL, ",", &saveptr_l1);
   }
-
-  Sys::close_(edid_s3d_node);
-  return kErrorNone;
 }
 
 bool HWHDMI::IsSupportedS3DMode(HWS3DMode s3d_mode) {
@@ -895,80 +966,106 @@ DisplayError HWHDMI::GetDynamicFrameRateMode(uint32_t refresh_rate, uint32_t *mo
   return kErrorNone;
 }
 
+DisplayError HWHDMI::GetDynamicFPSSwitch(uint32_t refresh_rate,
+                                         const DynamicFPSSwitch **dfps_switch) {
+  DynamicFPSKey key(active_config_index_, frame_rate_, refresh_rate);
+  auto it = dfps_switches_.find(key);
+  if (it == dfps_switches_.end()) {
+    DynamicFPSSwitch new_switch;
+    DynamicFPSData data;
+    uint32_t mode = kModeClock;
+    DisplayError error = GetDynamicFrameRateMode(refresh_rate, &mode, &data,
+                                                 &new_switch.config_index);
+    if (error != kErrorNone) {
+      return error;
+    }
+
+    char refresh_rate_string[kMaxStringLength];
+    if (mode == kModeHFP || mode == kModeClock) {
+      snprintf(refresh_rate_string, sizeof(refresh_rate_string), "%d", data.fps);
+    } else {
+      snprintf(refresh_rate_string, sizeof(refresh_rate_string), "%d %d %d %d %d",
+               data.hor_front_porch, data.hor_back_porch, data.hor_pulse_width,
+               data.clk_rate_hz, data.fps);
+    }
+    new_switch.mode = mode;
+    new_switch.value = refresh_rate_string;
+    GetDisplayAttributes(new_switch.config_index, &new_switch.display_attributes);
+
+    it = dfps_switches_.insert(std::make_pair(key, new_switch)).first;
+  }
+
+  *dfps_switch = &it->second;
+
+  return kErrorNone;
+}
+
 DisplayError HWHDMI::SetRefreshRate(uint32_t refresh_rate) {
-  char mode_path[kMaxStringLength] = {0};
-  char node_path[kMaxStringLength] = {0};
-  uint32_t mode = kModeClock;
-  uint32_t config_index = 0;
-  DynamicFPSData data;
-  DisplayError error = kErrorNone;
+  DTRACE_SCOPED();
+  const DynamicFPSSwitch *dfps_switch = NULL;
 
   if (refresh_rate == frame_rate_) {
-    return error;
+    return kErrorNone;
   }
 
-  error = GetDynamicFrameRateMode(refresh_rate, &mode, &data, &config_index);
+  DisplayError error = GetDynamicFPSSwitch(refresh_rate, &dfps_switch);
   if (error != kErrorNone) {
     return error;
   }
 
-  snprintf(mode_path, sizeof(mode_path), "%s%d/msm_fb_dfps_mode", fb_path_, fb_node_index_);
-  snprintf(node_path, sizeof(node_path), "%s%d/dynamic_fps", fb_path_, fb_node_index_);
-
-  int fd_mode = Sys::open_(mode_path, O_WRONLY);
-  if (fd_mode < 0) {
-    DLOGE("Failed to open %s with error %s", mode_path, strerror(errno));
-    return kErrorFileDescriptor;
-  }
+  if (dfps_switch->mode != dfps_mode_) {
+    if (dfps_mode_fd_ < 0) {
+      char mode_path[kMaxStringLength] = {0};
+      snprintf(mode_path, sizeof(mode_path), "%s%d/msm_fb_dfps_mode", fb_path_, fb_node_index_);
+      dfps_mode_fd_ = Sys::open_(mode_path, O_WRONLY);
+      if (dfps_mode_fd_ < 0) {
+        DLOGE("Failed to open %s with error %s", mode_path, strerror(errno));
+        return kErrorFileDescriptor;
+      }
+    }
 
-  char dfps_mode[kMaxStringLength];
-  snprintf(dfps_mode, sizeof(dfps_mode), "%d", mode);
-  DLOGI_IF(kTagDriverConfig, "Setting dfps_mode  = %d", mode);
-  ssize_t len = Sys::pwrite_(fd_mode, dfps_mode, strlen(dfps_mode), 0);
-  if (len < 0) {
-    DLOGE("Failed to enable dfps mode %d with error %s", mode, strerror(errno));
-    Sys::close_(fd_mode);
-    return kErrorUndefined;
+    char dfps_mode[kMaxStringLength];
+    snprintf(dfps_mode, sizeof(dfps_mode), "%d", dfps_switch->mode);
+    DLOGI_IF(kTagDriverConfig, "Setting dfps_mode  = %d", dfps_switch->mode);
+    ssize_t len = Sys::pwrite_(dfps_mode_fd_, dfps_mode, strlen(dfps_mode), 0);
+    if (len < 0) {
+      DLOGE("Failed to enable dfps mode %d with error %s", dfps_switch->mode, strerror(errno));
+      dfps_mode_ = kModeMAX;
+      return kErrorUndefined;
+    }
+    dfps_mode_ = dfps_switch->mode;
   }
-  Sys::close_(fd_mode);
 
-  int fd_node = Sys::open_(node_path, O_WRONLY);
-  if (fd_node < 0) {
-    DLOGE("Failed to open %s with error %s", node_path, strerror(errno));
-    return kErrorFileDescriptor;
+  if (dynamic_fps_fd_ < 0) {
+    char node_path[kMaxStringLength] = {0};
+    snprintf(node_path, sizeof(node_path), "%s%d/dynamic_fps", fb_path_, fb_node_index_);
+    dynamic_fps_fd_ = Sys::open_(node_path, O_WRONLY);
+    if (dynamic_fps_fd_ < 0) {
+      DLOGE("Failed to open %s with error %s", node_path, strerror(errno));
+      return kErrorFileDescriptor;
+    }
   }
 
-  char refresh_rate_string[kMaxStringLength];
-  if (mode == kModeHFP || mode == kModeClock) {
-    snprintf(refresh_rate_string, sizeof(refresh_rate_string), "%d", data.fps);
-    DLOGI_IF(kTagDriverConfig, "Setting refresh rate = %d", data.fps);
-  } else {
-    snprintf(refresh_rate_string, sizeof(refresh_rate_string), "%d %d %d %d %d",
-             data.hor_front_porch, data.hor_back_porch, data.hor_pulse_width,
-             data.clk_rate_hz, data.fps);
-  }
-  len = Sys::pwrite_(fd_node, refresh_rate_string, strlen(refresh_rate_string), 0);
+  DLOGI_IF(kTagDriverConfig, "Setting refresh rate = %s", dfps_switch->value.c_str());
+  ssize_t len = Sys::pwrite_(dynamic_fps_fd_, dfps_switch->value.c_str(),
+                             dfps_switch->value.length(), 0);
   if (len < 0) {
     DLOGE("Failed to write %d with error %s", refresh_rate, strerror(errno));
-    Sys::close_(fd_node);
     return kErrorUndefined;
   }
-  Sys::close_(fd_node);
-
-  error = ReadTimingInfo();
-  if (error != kErrorNone) {
-    return error;
-  }
 
-  GetDisplayAttributes(config_index, &display_attributes_);
+  // The driver applies the new timing from the next vsync on. Dynamic fps leaves the timing table
+  // as it is, so the attributes come from the precomputed switch instead of reading the table
+  // back from the driver.
+  display_attributes_ = dfps_switch->display_attributes;
   UpdateMixerAttributes();
 
   frame_rate_ = refresh_rate;
-  active_config_index_ = config_index;
+  active_config_index_ = dfps_switch->config_index;
 
   DLOGI_IF(kTagDriverConfig, "config_index(%d) Mode(%d) frame_rate(%d)",
-           config_index,
-           mode,
+           active_config_index_,
+           dfps_switch->mode,
            frame_rate_);
 
   return kErrorNone;
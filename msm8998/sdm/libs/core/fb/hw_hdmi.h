@@ -27,9 +27,12 @@
 
 #include <video/msm_hdmi_modes.h>
 #include <map>
+#include <string>
+#include <tuple>
 #include <vector>
 
 #include "hw_device.h"
+#include "hw_hdmi_mode_cache.h"
 
 namespace sdm {
 
@@ -72,7 +75,26 @@ class HWHDMI : public HWDevice {
     uint32_t fps;
   };
 
+  /**
+   * struct DynamicFPSSwitch - switch to a frame rate from a given mode, as computed by
+   * GetDynamicFrameRateMode
+   * @mode: HWFramerateUpdate mode written to msm_fb_dfps_mode
+   * @config_index: config the switch lands on
+   * @value: string written to dynamic_fps
+   * @display_attributes: attributes of the display after the switch
+   */
+  struct DynamicFPSSwitch {
+    uint32_t mode = kModeClock;
+    uint32_t config_index = 0;
+    std::string value;
+    HWDisplayAttributes display_attributes;
+  };
+
+  // Active config index, current frame rate and requested frame rate
+  typedef std::tuple<uint32_t, uint32_t, uint32_t> DynamicFPSKey;
+
   virtual DisplayError Init();
+  virtual DisplayError Deinit();
   virtual DisplayError GetNumDisplayAttributes(uint32_t *count);
   // Requirement to call this only after the first config has been explicitly set by client
   virtual DisplayError GetActiveConfig(uint32_t *active_config);
@@ -91,6 +113,10 @@ class HWHDMI : public HWDevice {
 
  private:
   DisplayError ReadEDIDInfo();
+  void ReadEDIDHash(const char *edid_modes, const char *edid_s3d_modes);
+  void ReadS3DInfo(char *edid_s3d_modes);
+  bool ReadCachedModes();
+  void CacheModes();
   void ReadScanInfo();
   HWScanSupport MapHWScanSupport(uint32_t value);
   int OpenResolutionFile(int file_mode);
@@ -108,16 +134,25 @@ class HWHDMI : public HWDevice {
 
   DisplayError GetDynamicFrameRateMode(uint32_t refresh_rate, uint32_t*mode,
                                        DynamicFPSData *data, uint32_t *config_index);
+  DisplayError GetDynamicFPSSwitch(uint32_t refresh_rate, const DynamicFPSSwitch **dfps_switch);
   static const int kThresholdRefreshRate = 1000;
   vector<uint32_t> hdmi_modes_;
   // Holds the hdmi timing information. Ex: resolution, fps etc.,
   vector<msm_hdmi_mode_timing_info> supported_video_modes_;
+  // Bit mask of the supported HWS3DMode values of each mode in hdmi_modes_
+  vector<uint32_t> s3d_config_;
+  uint64_t edid_hash_ = 0;
   HWScanInfo hw_scan_info_;
   uint32_t active_config_index_;
   std::map<HWS3DMode, msm_hdmi_s3d_mode> s3d_mode_sdm_to_mdp_;
   vector<HWS3DMode> supported_s3d_modes_;
   msm_hdmi_s3d_mode active_mdp_s3d_mode_ = HDMI_S3D_NONE;
   uint32_t frame_rate_ = 0;
+  // Frame rate switches already computed, valid for as long as supported_video_modes_ is
+  std::map<DynamicFPSKey, DynamicFPSSwitch> dfps_switches_;
+  int dfps_mode_fd_ = -1;
+  int dynamic_fps_fd_ = -1;
+  uint32_t dfps_mode_ = kModeMAX;  // Last mode written to msm_fb_dfps_mode
 };
 
 }  // namespace sdm
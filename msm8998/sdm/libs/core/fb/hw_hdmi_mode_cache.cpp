@@ -0,0 +1,170 @@
+/*
+* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <utils/debug.h>
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "hw_hdmi_mode_cache.h"
+
+#define __CLASS__ "HWHDMIModeCache"
+
+namespace sdm {
+
+static const char *kCachePath = "/data/vendor/display/hdmi_mode_cache";
+static const char *kCacheTmpPath = "/data/vendor/display/hdmi_mode_cache.tmp";
+
+std::mutex HWHDMIModeCache::lock_;
+std::vector<HDMIModeTable> HWHDMIModeCache::tables_;
+bool HWHDMIModeCache::loaded_ = false;
+
+uint64_t HWHDMIModeCache::Hash(const void *data, size_t size, uint64_t hash) {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+
+  return hash;
+}
+
+bool HWHDMIModeCache::Find(uint64_t edid_hash, HDMIModeTable *table) {
+  std::lock_guard<std::mutex> lock(lock_);
+  Load();
+
+  for (auto it = tables_.begin(); it != tables_.end(); it++) {
+    if (it->edid_hash == edid_hash) {
+      *table = *it;
+      // Keep the most recently used sink at the front
+      std::rotate(tables_.begin(), it, it + 1);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void HWHDMIModeCache::Insert(const HDMIModeTable &table) {
+  size_t count = table.video_formats.size();
+  if (!count || count > kMaxModes || table.timing_info.size() != count) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(lock_);
+  Load();
+
+  auto it = std::find_if(tables_.begin(), tables_.end(), [&table](const HDMIModeTable &entry) {
+    return entry.edid_hash == table.edid_hash;
+  });
+  if (it != tables_.end()) {
+    tables_.erase(it);
+  }
+
+  tables_.insert(tables_.begin(), table);
+  if (tables_.size() > kMaxEntries) {
+    tables_.resize(kMaxEntries);
+  }
+
+  Store();
+}
+
+void HWHDMIModeCache::Load() {
+  if (loaded_) {
+    return;
+  }
+  loaded_ = true;
+
+  FILE *fp = fopen(kCachePath, "rb");
+  if (!fp) {
+    return;
+  }
+
+  FileHeader header = {};
+  if (fread(&header, sizeof(header), 1, fp) != 1 || header.magic != kFileMagic ||
+      header.version != kFileVersion ||
+      header.timing_info_size != sizeof(msm_hdmi_mode_timing_info) ||
+      header.entry_count > kMaxEntries) {
+    DLOGW("Discarding invalid HDMI mode cache %s", kCachePath);
+    fclose(fp);
+    return;
+  }
+
+  for (uint32_t i = 0; i < header.entry_count; i++) {
+    HDMIModeTable table;
+    uint32_t count = 0;
+    if (fread(&table.edid_hash, sizeof(table.edid_hash), 1, fp) != 1 ||
+        fread(&count, sizeof(count), 1, fp) != 1 || !count || count > kMaxModes) {
+      break;
+    }
+
+    table.video_formats.resize(count);
+    table.timing_info.resize(count);
+    if (fread(table.video_formats.data(), sizeof(uint32_t), count, fp) != count ||
+        fread(table.timing_info.data(), sizeof(msm_hdmi_mode_timing_info), count, fp) != count) {
+      break;
+    }
+
+    tables_.push_back(table);
+  }
+
+  fclose(fp);
+  DLOGI_IF(kTagDriverConfig, "Loaded %zu HDMI mode tables", tables_.size());
+}
+
+void HWHDMIModeCache::Store() {
+  FILE *fp = fopen(kCacheTmpPath, "wb");
+  if (!fp) {
+    DLOGI_IF(kTagDriverConfig, "Cannot create %s: %s", kCacheTmpPath, strerror(errno));
+    return;
+  }
+
+  FileHeader header = {kFileMagic, kFileVersion, sizeof(msm_hdmi_mode_timing_info),
+                       UINT32(tables_.size())};
+  bool success = (fwrite(&header, sizeof(header), 1, fp) == 1);
+  for (auto &table : tables_) {
+    uint32_t count = UINT32(table.video_formats.size());
+    success = success && fwrite(&table.edid_hash, sizeof(table.edid_hash), 1, fp) == 1 &&
+              fwrite(&count, sizeof(count), 1, fp) == 1 &&
+              fwrite(table.video_formats.data(), sizeof(uint32_t), count, fp) == count &&
+              fwrite(table.timing_info.data(), sizeof(msm_hdmi_mode_timing_info), count,
+                     fp) == count;
+  }
+
+  if (fclose(fp) != 0) {
+    success = false;
+  }
+
+  // Replace the cache atomically so a crash never leaves a partially written file behind.
+  if (!success || rename(kCacheTmpPath, kCachePath) != 0) {
+    DLOGW("Failed to write HDMI mode cache %s", kCachePath);
+    remove(kCacheTmpPath);
+  }
+}
+
+}  // namespace sdm
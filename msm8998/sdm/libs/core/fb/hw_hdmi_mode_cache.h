@@ -0,0 +1,77 @@
+/*
+* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HW_HDMI_MODE_CACHE_H__
+#define __HW_HDMI_MODE_CACHE_H__
+
+#include <video/msm_hdmi_modes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+#include <vector>
+
+namespace sdm {
+
+// Timing table of an HDMI sink, as paged in from res_info.
+struct HDMIModeTable {
+  uint64_t edid_hash = 0;
+  std::vector<uint32_t> video_formats;                  // Video format codes in driver order
+  std::vector<msm_hdmi_mode_timing_info> timing_info;   // Timing info of each video format
+};
+
+// Mode tables of recently connected sinks keyed by EDID hash. The tables live for the life of the
+// process and are persisted, so reconnecting a known sink skips the res_info paging.
+class HWHDMIModeCache {
+ public:
+  static const uint64_t kHashSeed = 0xcbf29ce484222325ULL;
+
+  // FNV-1a, chained through the hash argument
+  static uint64_t Hash(const void *data, size_t size, uint64_t hash = kHashSeed);
+  static bool Find(uint64_t edid_hash, HDMIModeTable *table);
+  static void Insert(const HDMIModeTable &table);
+
+ private:
+  static const uint32_t kMaxEntries = 8;
+  static const uint32_t kMaxModes = 128;
+  static const uint32_t kFileMagic = 0x434d4448;  // "HDMC"
+  static const uint32_t kFileVersion = 1;
+
+  struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t timing_info_size;
+    uint32_t entry_count;
+  };
+
+  static void Load();
+  static void Store();
+
+  static std::mutex lock_;
+  static std::vector<HDMIModeTable> tables_;  // Most recently connected first
+  static bool loaded_;
+};
+
+}  // namespace sdm
+
+#endif  // __HW_HDMI_MODE_CACHE_H__
@@ -28,6 +28,7 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <pthread.h>
 #include <utils/constants.h>
 #include <utils/debug.h>
 #include <utils/sys.h>
@@ -38,6 +39,7 @@
 #include <fstream>
 #include <map>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
@@ -50,6 +52,7 @@ using std::vector;
 using std::map;
 using std::string;
 using std::fstream;
+using std::istringstream;
 using std::to_string;
 
 namespace sdm {
@@ -86,12 +89,89 @@ int HWInfo::ParseString(const char *input, char *tokens[], const uint32_t max_to
   return 0;
 }
 
-DisplayError HWInfo::GetDynamicBWLimits(HWResourceInfo *hw_resource) {
-  Sys::fstream fs(kBWModeBitmap, fstream::in);
+bool HWInfo::ReadNode(const string &path, string *contents) {
+  Sys::fstream fs(path, fstream::in);
   if (!fs.is_open()) {
+    return false;
+  }
+
+  string line;
+  contents->clear();
+  while (Sys::getline_(fs, line)) {
+    contents->append(line);
+    contents->push_back('\n');
+  }
+
+  return true;
+}
+
+bool HWInfo::IsV4L2Rotator(int32_t index) {
+  string name;
+  return ReadNode("/sys/class/video4linux/video" + to_string(index) + "/name", &name) &&
+         !strncmp(name.c_str(), "sde_rotator", strlen("sde_rotator"));
+}
+
+void *HWInfo::ReadRotatorCaps(void *context) {
+  HWCapsSnapshot *caps = reinterpret_cast<HWCapsSnapshot *>(context);
+  caps->has_rotator_caps = ReadNode(kRotatorCapsPath, &caps->rotator_caps);
+  if (caps->has_rotator_caps) {
+    return NULL;
+  }
+
+  // Without an MDSS rotator, look for the V4L2 one
+  const int32_t kMaxV4L2Nodes = 64;
+  for (int32_t i = 0; i < kMaxV4L2Nodes; i++) {
+    if (IsV4L2Rotator(i)) {
+      caps->v4l2_rotator_index = i;
+      ReadNode("/sys/class/video4linux/video" + to_string(i) + "/device/caps",
+               &caps->v4l2_rotator_caps);
+      // We support only 1 rotator
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+void *HWInfo::ReadBWModeBitmap(void *context) {
+  HWCapsSnapshot *caps = reinterpret_cast<HWCapsSnapshot *>(context);
+  caps->has_bw_mode_bitmap = ReadNode(kBWModeBitmap, &caps->bw_mode_bitmap);
+
+  return NULL;
+}
+
+// The capability nodes are independent of each other, the rotator and bandwidth ones are read on
+// their own threads while mdp caps are read here. Nodes that turn out not to be needed are simply
+// left unparsed.
+void HWInfo::ReadCapsSnapshot(HWCapsSnapshot *caps) {
+  pthread_t rotator_thread;
+  pthread_t bw_thread;
+  bool rotator_async = (pthread_create(&rotator_thread, NULL, &ReadRotatorCaps, caps) == 0);
+  bool bw_async = (pthread_create(&bw_thread, NULL, &ReadBWModeBitmap, caps) == 0);
+
+  string fb_path = "/sys/devices/virtual/graphics/fb"
+                      + to_string(kHWCapabilitiesNode) + "/mdp/caps";
+  caps->has_mdp_caps = ReadNode(fb_path, &caps->mdp_caps);
+
+  if (rotator_async) {
+    pthread_join(rotator_thread, NULL);
+  } else {
+    ReadRotatorCaps(caps);
+  }
+
+  if (bw_async) {
+    pthread_join(bw_thread, NULL);
+  } else {
+    ReadBWModeBitmap(caps);
+  }
+}
+
+DisplayError HWInfo::GetDynamicBWLimits(const HWCapsSnapshot &caps, HWResourceInfo *hw_resource) {
+  if (!caps.has_bw_mode_bitmap) {
     DLOGE("File '%s' not found", kBWModeBitmap);
     return kErrorHardware;
   }
+  istringstream fs(caps.bw_mode_bitmap);
 
   HWDynBwLimitInfo* bw_info = &hw_resource->dyn_bw_info;
   for (int index = 0; index < kBwModeMax; index++) {
@@ -103,7 +183,7 @@ DisplayError HWInfo::GetDynamicBWLimits(HWResourceInfo *hw_resource) {
   const uint32_t max_count = kBwModeMax;
   char *tokens[max_count] = { NULL };
   string line;
-  while (Sys::getline_(fs, line)) {
+  while (std::getline(fs, line)) {
     if (!ParseString(line.c_str(), tokens, max_count, ":, =\n", &token_count)) {
       if (!strncmp(tokens[0], "default_pipe", strlen("default_pipe"))) {
         bw_info->pipe_bw_limit[kBwDefault] = UINT32(atoi(tokens[1]));
@@ -133,15 +213,27 @@ DisplayError HWInfo::GetHWResourceInfo(HWResourceInfo *hw_resource) {
     *hw_resource = *hw_resource_;
     return kErrorNone;
   }
-  string fb_path = "/sys/devices/virtual/graphics/fb"
-                      + to_string(kHWCapabilitiesNode) + "/mdp/caps";
 
-  Sys::fstream fs(fb_path, fstream::in);
-  if (!fs.is_open()) {
-    DLOGE("File '%s' not found", fb_path.c_str());
-    return kErrorHardware;
+  HWCapsSnapshot caps;
+  bool cached = HWCapsCache::Load(&caps);
+  // videoN nodes are numbered in probe order, which may differ across boots of the same kernel
+  if (cached && (caps.v4l2_rotator_index >= 0) && !IsV4L2Rotator(caps.v4l2_rotator_index)) {
+    DLOGI("V4L2 rotator is no longer video%d, reading capabilities again",
+          caps.v4l2_rotator_index);
+    caps = HWCapsSnapshot();
+    cached = false;
   }
 
+  if (!cached) {
+    ReadCapsSnapshot(&caps);
+    if (!caps.has_mdp_caps) {
+      DLOGE("File '/sys/devices/virtual/graphics/fb%d/mdp/caps' not found", kHWCapabilitiesNode);
+      return kErrorHardware;
+    }
+    HWCapsCache::Store(caps);
+  }
+
+  istringstream fs(caps.mdp_caps);
   hw_resource_ = new HWResourceInfo;
 
   InitSupportedFormatMap(hw_resource_);
@@ -151,7 +243,7 @@ DisplayError HWInfo::GetHWResourceInfo(HWResourceInfo *hw_resource) {
   const uint32_t max_count = 256;
   char *tokens[max_count] = { NULL };
   string line;
-  while (Sys::getline_(fs, line)) {
+  while (std::getline(fs, line)) {
     // parse the line and update information accordingly
     if (!ParseString(line.c_str(), tokens, max_count, ":, =\n", &token_count)) {
       if (!strncmp(tokens[0], "hw_rev", strlen("hw_rev"))) {
@@ -245,7 +337,7 @@ DisplayError HWInfo::GetHWResourceInfo(HWResourceInfo *hw_resource) {
       } else if (!strncmp(tokens[0], "pipe_count", strlen("pipe_count"))) {
         uint32_t pipe_count = UINT8(atoi(tokens[1]));
         for (uint32_t i = 0; i < pipe_count; i++) {
-          Sys::getline_(fs, line);
+          std::getline(fs, line);
           if (!ParseString(line.c_str(), tokens, max_count, ": =\n", &token_count)) {
             HWPipeCaps pipe_caps;
             pipe_caps.type = kPipeTypeUnused;
@@ -316,7 +408,7 @@ DisplayError HWInfo::GetHWResourceInfo(HWResourceInfo *hw_resource) {
         hw_resource_->linear_factor, hw_resource_->scale_factor, hw_resource_->extra_fudge_factor);
 
   if (hw_resource_->separate_rotator || hw_resource_->num_dma_pipe) {
-    GetHWRotatorInfo(hw_resource_);
+    GetHWRotatorInfo(caps, hw_resource_);
   }
 
   // If the driver doesn't spell out the wb index, assume it to be the number of rotators,
@@ -326,7 +418,7 @@ DisplayError HWInfo::GetHWResourceInfo(HWResourceInfo *hw_resource) {
   }
 
   if (hw_resource_->has_dyn_bw_support) {
-    DisplayError ret = GetDynamicBWLimits(hw_resource_);
+    DisplayError ret = GetDynamicBWLimits(caps, hw_resource_);
     if (ret != kErrorNone) {
       DLOGE("Failed to read dynamic band width info");
       return ret;
@@ -345,27 +437,29 @@ DisplayError HWInfo::GetHWResourceInfo(HWResourceInfo *hw_resource) {
   return kErrorNone;
 }
 
-DisplayError HWInfo::GetHWRotatorInfo(HWResourceInfo *hw_resource) {
-  if (GetMDSSRotatorInfo(hw_resource) != kErrorNone)
-    return GetV4L2RotatorInfo(hw_resource);
+DisplayError HWInfo::GetHWRotatorInfo(const HWCapsSnapshot &caps,
+                                      HWResourceInfo *hw_resource) {
+  if (GetMDSSRotatorInfo(caps, hw_resource) != kErrorNone)
+    return GetV4L2RotatorInfo(caps, hw_resource);
 
   return kErrorNone;
 }
 
-DisplayError HWInfo::GetMDSSRotatorInfo(HWResourceInfo *hw_resource) {
-  Sys::fstream fs(kRotatorCapsPath, fstream::in);
-  if (!fs.is_open()) {
+DisplayError HWInfo::GetMDSSRotatorInfo(const HWCapsSnapshot &caps,
+                                        HWResourceInfo *hw_resource) {
+  if (!caps.has_rotator_caps) {
     DLOGW("File '%s' not found", kRotatorCapsPath);
     return kErrorNotSupported;
   }
 
+  istringstream fs(caps.rotator_caps);
   uint32_t token_count = 0;
   const uint32_t max_count = 10;
   char *tokens[max_count] = { NULL };
   string line;
 
   hw_resource->hw_rot_info.type = HWRotatorInfo::ROT_TYPE_MDSS;
-  while (Sys::getline_(fs, line)) {
+  while (std::getline(fs, line)) {
     if (!ParseString(line.c_str(), tokens, max_count, ":, =\n", &token_count)) {
       if (!strncmp(tokens[0], "wb_count", strlen("wb_count"))) {
         hw_resource->hw_rot_info.num_rotator = UINT8(atoi(tokens[1]));
@@ -383,47 +477,28 @@ DisplayError HWInfo::GetMDSSRotatorInfo(HWResourceInfo *hw_resource) {
   return kErrorNone;
 }
 
-DisplayError HWInfo::GetV4L2RotatorInfo(HWResourceInfo *hw_resource) {
-  string v4l2_path = "/sys/class/video4linux/video";
-  const uint32_t kMaxV4L2Nodes = 64;
-  bool found = false;
-
-  for (uint32_t i = 0; (i < kMaxV4L2Nodes) && (false == found); i++) {
-    string path = v4l2_path + to_string(i) + "/name";
-    Sys::fstream fs(path, fstream::in);
-    if (!fs.is_open()) {
-      continue;
-    }
-
+DisplayError HWInfo::GetV4L2RotatorInfo(const HWCapsSnapshot &caps,
+                                        HWResourceInfo *hw_resource) {
+  if (caps.v4l2_rotator_index >= 0) {
+    hw_resource->hw_rot_info.device_path = string("/dev/video" +
+                                                  to_string(caps.v4l2_rotator_index));
+    hw_resource->hw_rot_info.num_rotator++;
+    hw_resource->hw_rot_info.type = HWRotatorInfo::ROT_TYPE_V4L2;
+    hw_resource->hw_rot_info.has_downscale = true;
+
+    istringstream caps_fs(caps.v4l2_rotator_caps);
+    uint32_t token_count = 0;
+    const uint32_t max_count = 10;
+    char *tokens[max_count] = { NULL };
     string line;
-    if (Sys::getline_(fs, line) &&
-        (!strncmp(line.c_str(), "sde_rotator", strlen("sde_rotator")))) {
-       hw_resource->hw_rot_info.device_path = string("/dev/video" + to_string(i));
-       hw_resource->hw_rot_info.num_rotator++;
-       hw_resource->hw_rot_info.type = HWRotatorInfo::ROT_TYPE_V4L2;
-       hw_resource->hw_rot_info.has_downscale = true;
-
-       string caps_path = v4l2_path + to_string(i) + "/device/caps";
-       Sys::fstream caps_fs(caps_path, fstream::in);
-
-       if (caps_fs.is_open()) {
-         uint32_t token_count = 0;
-         const uint32_t max_count = 10;
-         char *tokens[max_count] = { NULL };
-         string caps;
-         while (Sys::getline_(caps_fs, caps)) {
-           if (!ParseString(caps.c_str(), tokens, max_count, ":, =\n", &token_count)) {
-             if (!strncmp(tokens[0], "downscale_compression", strlen("downscale_compression"))) {
-               hw_resource->hw_rot_info.downscale_compression = UINT8(atoi(tokens[1]));
-             } else if (!strncmp(tokens[0], "min_downscale", strlen("min_downscale"))) {
-               hw_resource->hw_rot_info.min_downscale = FLOAT(atof(tokens[1]));
-             }
-           }
-         }
-       }
-
-       // We support only 1 rotator
-       found = true;
+    while (std::getline(caps_fs, line)) {
+      if (!ParseString(line.c_str(), tokens, max_count, ":, =\n", &token_count)) {
+        if (!strncmp(tokens[0], "downscale_compression", strlen("downscale_compression"))) {
+          hw_resource->hw_rot_info.downscale_compression = UINT8(atoi(tokens[1]));
+        } else if (!strncmp(tokens[0], "min_downscale", strlen("min_downscale"))) {
+          hw_resource->hw_rot_info.min_downscale = FLOAT(atof(tokens[1]));
+        }
+      }
     }
   }
 
@@ -30,8 +30,10 @@
 #include <private/hw_info_types.h>
 #include <linux/msm_mdp.h>
 #include <bitset>
+#include <string>
 
 #include "hw_info_interface.h"
+#include "hw_caps_cache.h"
 
 #ifndef MDP_IMGTYPE_END
 #define MDP_IMGTYPE_LIMIT1 0x100
@@ -46,9 +48,11 @@ class HWInfo: public HWInfoInterface {
   virtual DisplayError GetFirstDisplayInterfaceType(HWDisplayInterfaceInfo *hw_disp_info);
 
  private:
-  virtual DisplayError GetHWRotatorInfo(HWResourceInfo *hw_resource);
-  virtual DisplayError GetMDSSRotatorInfo(HWResourceInfo *hw_resource);
-  virtual DisplayError GetV4L2RotatorInfo(HWResourceInfo *hw_resource);
+  virtual DisplayError GetHWRotatorInfo(const HWCapsSnapshot &caps, HWResourceInfo *hw_resource);
+  virtual DisplayError GetMDSSRotatorInfo(const HWCapsSnapshot &caps,
+                                          HWResourceInfo *hw_resource);
+  virtual DisplayError GetV4L2RotatorInfo(const HWCapsSnapshot &caps,
+                                          HWResourceInfo *hw_resource);
 
   // TODO(user): Read Mdss version from the driver
   static const int kHWMdssVersion5 = 500;  // MDSS_V5
@@ -65,7 +69,12 @@ class HWInfo: public HWInfoInterface {
 
   static int ParseString(const char *input, char *tokens[], const uint32_t max_token,
                          const char *delim, uint32_t *count);
-  DisplayError GetDynamicBWLimits(HWResourceInfo *hw_resource);
+  static bool ReadNode(const std::string &path, std::string *contents);
+  static bool IsV4L2Rotator(int32_t index);
+  static void *ReadRotatorCaps(void *caps);
+  static void *ReadBWModeBitmap(void *caps);
+  static void ReadCapsSnapshot(HWCapsSnapshot *caps);
+  DisplayError GetDynamicBWLimits(const HWCapsSnapshot &caps, HWResourceInfo *hw_resource);
   LayerBufferFormat GetSDMFormat(int mdp_format);
   void InitSupportedFormatMap(HWResourceInfo *hw_resource);
   void ParseFormats(char *tokens[], uint32_t token_count, HWSubBlockType sub_block_type,
@@ -107,9 +107,41 @@ DisplayError HWPrimary::Init() {
 
   avr_prop_disabled_ = Debug::IsAVRDisabled();
 
+  // The brightness node is opened again on use if it is not available yet.
+  if (GetSysfsNode(kBrightnessNode, O_RDWR, &brightness_fd_) < 0) {
+    DLOGV_IF(kTagDriverConfig, "Failed to open node = %s, error = %s ", kBrightnessNode,
+             strerror(errno));
+  }
+  StartBrightnessThread();
+
+  StartPPThread();
+
   return error;
 }
 
+DisplayError HWPrimary::Deinit() {
+  StopBrightnessThread();
+  StopPPThread();
+
+  int *sysfs_fds[] = { &brightness_fd_, &dynamic_fps_fd_, &idle_time_fd_ };
+  for (int *fd : sysfs_fds) {
+    if (*fd >= 0) {
+      Sys::close_(*fd);
+      *fd = -1;
+    }
+  }
+
+  return HWDevice::Deinit();
+}
+
+int HWPrimary::GetSysfsNode(const char *node_path, int flags, int *fd) {
+  if (*fd < 0) {
+    *fd = Sys::open_(node_path, flags);
+  }
+
+  return *fd;
+}
+
 bool HWPrimary::GetCurrentModeFromSysfs(size_t *curr_x_pixels, size_t *curr_y_pixels) {
   bool ret = false;
   string mode_path = fb_path_ + string("0/mode");
@@ -255,6 +287,9 @@ DisplayError HWPrimary::PopulateDisplayAttributes() {
   display_attributes_.h_total += (display_attributes_.is_device_split ||
     hw_panel_info_.ping_pong_split)? h_blanking : 0;
 
+  SCOPE_LOCK(brightness_locker_);
+  brightness_period_us_ = display_attributes_.vsync_period_ns / 1000;
+
   return kErrorNone;
 }
 
@@ -304,7 +339,7 @@ DisplayError HWPrimary::SetRefreshRate(uint32_t refresh_rate) {
 
   snprintf(node_path, sizeof(node_path), "%s%d/dynamic_fps", fb_path_, fb_node_index_);
 
-  int fd = Sys::open_(node_path, O_WRONLY);
+  int fd = GetSysfsNode(node_path, O_WRONLY, &dynamic_fps_fd_);
   if (fd < 0) {
     DLOGE("Failed to open %s with error %s", node_path, strerror(errno));
     return kErrorFileDescriptor;
@@ -316,16 +351,22 @@ DisplayError HWPrimary::SetRefreshRate(uint32_t refresh_rate) {
   ssize_t len = Sys::pwrite_(fd, refresh_rate_string, strlen(refresh_rate_string), 0);
   if (len < 0) {
     DLOGE("Failed to write %d with error %s", refresh_rate, strerror(errno));
-    Sys::close_(fd);
     return kErrorUndefined;
   }
-  Sys::close_(fd);
 
-  DisplayError error = PopulateDisplayAttributes();
-  if (error != kErrorNone) {
-    return error;
+  // Porch based dynamic fps changes the panel timing along with the frame rate, so read the mode
+  // back from the driver. Clock based dynamic fps only changes the frame rate, so update the cached
+  // attributes instead.
+  if (hw_panel_info_.dfps_porch_mode) {
+    return PopulateDisplayAttributes();
   }
 
+  display_attributes_.fps = refresh_rate;
+  display_attributes_.vsync_period_ns = UINT32(1000000000L / refresh_rate);
+
+  SCOPE_LOCK(brightness_locker_);
+  brightness_period_us_ = display_attributes_.vsync_period_ns / 1000;
+
   return kErrorNone;
 }
 
@@ -341,6 +382,10 @@ DisplayError HWPrimary::PowerOff() {
 
   auto_refresh_ = false;
 
+  // Post processing state may be lost with the panel, program the next configs in full.
+  SCOPE_LOCK(pp_locker_);
+  memset(pp_expected_digest_, 0, sizeof(pp_expected_digest_));
+
   return kErrorNone;
 }
 
@@ -429,6 +474,8 @@ DisplayError HWPrimary::Validate(HWLayers *hw_layers) {
 DisplayError HWPrimary::Commit(HWLayers *hw_layers) {
   LayerBuffer *output_buffer = hw_layers->info.stack->output_buffer;
 
+  WaitForPPFeatures();
+
   if (hw_resource_.has_concurrent_writeback && output_buffer) {
     if (output_buffer->planes[0].fd >= 0) {
       mdp_out_layer_.buffer.planes[0].fd = output_buffer->planes[0].fd;
@@ -466,7 +513,7 @@ void HWPrimary::SetIdleTimeoutMs(uint32_t timeout_ms) {
   snprintf(node_path, sizeof(node_path), "%s%d/idle_time", fb_path_, fb_node_index_);
 
   // Open a sysfs node to send the timeout value to driver.
-  int fd = Sys::open_(node_path, O_WRONLY);
+  int fd = GetSysfsNode(node_path, O_WRONLY, &idle_time_fd_);
   if (fd < 0) {
     DLOGE("Unable to open %s, node %s", node_path, strerror(errno));
     return;
@@ -480,8 +527,6 @@ void HWPrimary::SetIdleTimeoutMs(uint32_t timeout_ms) {
   if (length <= 0) {
     DLOGE("Unable to write into %s, node %s", node_path, strerror(errno));
   }
-
-  Sys::close_(fd);
 }
 
 DisplayError HWPrimary::SetVSyncState(bool enable) {
@@ -517,35 +562,108 @@ DisplayError HWPrimary::SetDisplayMode(const HWDisplayMode hw_display_mode) {
 }
 
 DisplayError HWPrimary::SetPanelBrightness(int level) {
-  char buffer[kMaxSysfsCommandLength] = {0};
-
   DLOGV_IF(kTagDriverConfig, "Set brightness level to %d", level);
-  int fd = Sys::open_(kBrightnessNode, O_RDWR);
-  if (fd < 0) {
-    DLOGV_IF(kTagDriverConfig, "Failed to open node = %s, error = %s ", kBrightnessNode,
-             strerror(errno));
+  if (level < 0) {
+    return kErrorParameters;
+  }
+
+  if (GetSysfsNode(kBrightnessNode, O_RDWR, &brightness_fd_) < 0) {
+    DLOGV_IF(kTagDriverConfig, "Brightness node = %s is not available", kBrightnessNode);
     return kErrorFileDescriptor;
   }
 
+  if (!brightness_thread_started_) {
+    return WriteBrightness(level);
+  }
+
+  // Latest level wins, the writer thread picks it up at most once per frame.
+  SCOPE_LOCK(brightness_locker_);
+  pending_brightness_ = level;
+  brightness_locker_.Signal();
+
+  return kErrorNone;
+}
+
+DisplayError HWPrimary::WriteBrightness(int level) {
+  char buffer[kMaxSysfsCommandLength] = {0};
+
   int32_t bytes = snprintf(buffer, kMaxSysfsCommandLength, "%d\n", level);
   if (bytes < 0) {
     DLOGV_IF(kTagDriverConfig, "Failed to copy new brightness level = %d", level);
-    Sys::close_(fd);
     return kErrorUndefined;
   }
 
-  ssize_t ret = Sys::pwrite_(fd, buffer, static_cast<size_t>(bytes), 0);
+  ssize_t ret = Sys::pwrite_(brightness_fd_, buffer, static_cast<size_t>(bytes), 0);
   if (ret <= 0) {
     DLOGV_IF(kTagDriverConfig, "Failed to write to node = %s, error = %s ", kBrightnessNode,
              strerror(errno));
-    Sys::close_(fd);
     return kErrorUndefined;
   }
-  Sys::close_(fd);
 
   return kErrorNone;
 }
 
+void HWPrimary::StartBrightnessThread() {
+  exit_brightness_thread_ = false;
+  if (pthread_create(&brightness_thread_, NULL, &BrightnessThread, this) != 0) {
+    DLOGW("Failed to start brightness thread, writing brightness synchronously");
+    return;
+  }
+
+  brightness_thread_started_ = true;
+}
+
+void HWPrimary::StopBrightnessThread() {
+  if (!brightness_thread_started_) {
+    return;
+  }
+
+  brightness_locker_.Lock();
+  exit_brightness_thread_ = true;
+  brightness_locker_.Signal();
+  brightness_locker_.Unlock();
+
+  pthread_join(brightness_thread_, NULL);
+  brightness_thread_started_ = false;
+}
+
+void *HWPrimary::BrightnessThread(void *context) {
+  if (context) {
+    reinterpret_cast<HWPrimary *>(context)->BrightnessThreadMain();
+  }
+
+  return NULL;
+}
+
+void HWPrimary::BrightnessThreadMain() {
+  prctl(PR_SET_NAME, "SDM_Brightness", 0, 0, 0);
+
+  brightness_locker_.Lock();
+  while (true) {
+    if (pending_brightness_ < 0) {
+      // A level still pending at exit is written before leaving.
+      if (exit_brightness_thread_) {
+        break;
+      }
+      brightness_locker_.Wait();
+      continue;
+    }
+
+    int level = pending_brightness_;
+    uint32_t period_us = brightness_period_us_;
+    pending_brightness_ = -1;
+    brightness_locker_.Unlock();
+
+    WriteBrightness(level);
+
+    // Requests arriving during this frame only replace the pending level.
+    usleep(period_us);
+
+    brightness_locker_.Lock();
+  }
+  brightness_locker_.Unlock();
+}
+
 DisplayError HWPrimary::GetPanelBrightness(int *level) {
   char brightness[kMaxStringLength] = {0};
 
@@ -554,18 +672,24 @@ DisplayError HWPrimary::GetPanelBrightness(int *level) {
     return kErrorParameters;
   }
 
-  int fd = Sys::open_(kBrightnessNode, O_RDWR);
-  if (fd < 0) {
-    DLOGV_IF(kTagDriverConfig, "Failed to open brightness node = %s, error = %s", kBrightnessNode,
-             strerror(errno));
+  if (GetSysfsNode(kBrightnessNode, O_RDWR, &brightness_fd_) < 0) {
+    DLOGV_IF(kTagDriverConfig, "Brightness node = %s is not available", kBrightnessNode);
     return kErrorFileDescriptor;
   }
 
-  if (Sys::pread_(fd, brightness, sizeof(brightness), 0) > 0) {
+  // A level that has not reached the node yet is what the panel is about to show.
+  {
+    SCOPE_LOCK(brightness_locker_);
+    if (pending_brightness_ >= 0) {
+      *level = pending_brightness_;
+      return kErrorNone;
+    }
+  }
+
+  if (Sys::pread_(brightness_fd_, brightness, sizeof(brightness), 0) > 0) {
     *level = atoi(brightness);
     DLOGV_IF(kTagDriverConfig, "Brightness level = %d", *level);
   }
-  Sys::close_(fd);
 
   return kErrorNone;
 }
@@ -619,35 +743,198 @@ DisplayError HWPrimary::GetPPFeaturesVersion(PPFeatureVersion *vers) {
 
 // It was entered with PPFeaturesConfig::locker_ being hold.
 DisplayError HWPrimary::SetPPFeatures(PPFeaturesConfig *feature_list) {
-  msmfb_mdp_pp kernel_params = {};
-  int ret = 0;
   PPFeatureInfo *feature = NULL;
+  bool read_back = false;
+  bool queued = false;
 
-  while (true) {
-    ret = feature_list->RetrieveNextFeature(&feature);
-    if (ret)
-        break;
-
-    if (feature) {
-      DLOGV_IF(kTagDriverConfig, "feature_id = %d", feature->feature_id_);
+  SCOPE_LOCK(pp_locker_);
+  while (feature_list->RetrieveNextFeature(&feature) == kErrorNone) {
+    if (!feature || (feature->feature_id_ >= kMaxNumPPFeatures)) {
+      continue;
+    }
 
-      if ((feature->feature_id_ < kMaxNumPPFeatures)) {
-        HWColorManager::SetFeature[feature->feature_id_](*feature, &kernel_params);
-        if (Sys::ioctl_(device_fd_, INT(MSMFB_MDP_PP), &kernel_params) < 0) {
-          IOCTL_LOGE(MSMFB_MDP_PP, device_type_);
+    uint32_t feature_id = feature->feature_id_;
+    uint64_t digest = HWColorManager::GetFeatureDigest(*feature);
+    read_back = read_back || (feature->enable_flags_ & kOpsRead);
 
-          feature_list->Reset();
-          return kErrorHardware;
-        }
-      }
+    // Only the latest config of a feature is kept. It is dropped if it matches what the hardware
+    // ends up with once everything queued or in flight is programmed, not only what it has now,
+    // so that reverting a config still in flight is not lost.
+    if (digest && (digest == pp_expected_digest_[feature_id])) {
+      DLOGV_IF(kTagDriverConfig, "feature_id = %d is already programmed", feature_id);
+      continue;
     }
-  }  // while(true)
+
+    delete pp_pending_[feature_id];
+    feature_list->DetachFeature(feature_id);
+    pp_pending_[feature_id] = feature;
+    pp_pending_digest_[feature_id] = digest;
+    pp_expected_digest_[feature_id] = digest;
+    queued = true;
+  }
 
   // Once all features were consumed, then destroy all feature instance from feature_list,
   // Then mark it as non-dirty of PPFeaturesConfig cache.
   feature_list->Reset();
 
-  return kErrorNone;
+  if (!queued) {
+    return kErrorNone;
+  }
+
+  if (pp_thread_started_ && !read_back) {
+    pp_queued_batches_++;
+    pp_locker_.Broadcast();
+    return kErrorNone;
+  }
+
+  // Read backs return data to the caller, so everything queued is programmed right away.
+  while (pp_busy_) {
+    pp_locker_.Wait();
+  }
+
+  PPFeatureInfo *features[kMaxNumPPFeatures] = {};
+  uint64_t digests[kMaxNumPPFeatures] = {};
+  uint32_t failed_mask = 0;
+  TakePendingPPFeatures(features, digests);
+  DisplayError error = ApplyPPFeatures(features, &failed_mask);
+  DropFailedPPFeatures(failed_mask, digests);
+  pp_applied_batches_ = pp_queued_batches_;
+  pp_locker_.Broadcast();
+
+  return error;
+}
+
+uint32_t HWPrimary::TakePendingPPFeatures(PPFeatureInfo **features, uint64_t *digests) {
+  uint32_t feature_mask = 0;
+
+  for (uint32_t i = 0; i < kMaxNumPPFeatures; i++) {
+    features[i] = pp_pending_[i];
+    digests[i] = pp_pending_digest_[i];
+    pp_pending_[i] = NULL;
+    if (features[i]) {
+      feature_mask |= BITMAP(i);
+    }
+  }
+
+  return feature_mask;
+}
+
+DisplayError HWPrimary::ApplyPPFeatures(PPFeatureInfo **features, uint32_t *failed_mask) {
+  DisplayError error = kErrorNone;
+
+  for (uint32_t i = 0; i < kMaxNumPPFeatures; i++) {
+    PPFeatureInfo *feature = features[i];
+    if (!feature) {
+      continue;
+    }
+
+    msmfb_mdp_pp kernel_params = {};
+    DLOGV_IF(kTagDriverConfig, "feature_id = %d", feature->feature_id_);
+
+    HWColorManager::SetFeature[i](*feature, &kernel_params);
+    if (Sys::ioctl_(device_fd_, INT(MSMFB_MDP_PP), &kernel_params) < 0) {
+      IOCTL_LOGE(MSMFB_MDP_PP, device_type_);
+      *failed_mask |= BITMAP(i);
+      error = kErrorHardware;
+    }
+
+    delete feature;
+    features[i] = NULL;
+  }
+
+  return error;
+}
+
+void HWPrimary::DropFailedPPFeatures(uint32_t failed_mask, const uint64_t *digests) {
+  // A failed config is not on the hardware. Unless a newer one was queued meanwhile, the next
+  // config of that feature has to be programmed even if it matches the failed one.
+  for (uint32_t i = 0; i < kMaxNumPPFeatures; i++) {
+    if ((failed_mask & BITMAP(i)) && (pp_expected_digest_[i] == digests[i])) {
+      pp_expected_digest_[i] = 0;
+    }
+  }
+}
+
+void HWPrimary::WaitForPPFeatures() {
+  SCOPE_LOCK(pp_locker_);
+
+  // Features queued before the previous commit have to reach the hardware before this one.
+  while (pp_thread_started_ && (INT32(pp_applied_batches_ - pp_commit_batches_) < 0)) {
+    pp_locker_.Wait();
+  }
+
+  pp_commit_batches_ = pp_queued_batches_;
+}
+
+void HWPrimary::StartPPThread() {
+  exit_pp_thread_ = false;
+  if (pthread_create(&pp_thread_, NULL, &PPThread, this) != 0) {
+    DLOGW("Failed to start post processing thread, programming features synchronously");
+    return;
+  }
+
+  pp_thread_started_ = true;
+}
+
+void HWPrimary::StopPPThread() {
+  if (pp_thread_started_) {
+    pp_locker_.Lock();
+    exit_pp_thread_ = true;
+    pp_locker_.Broadcast();
+    pp_locker_.Unlock();
+
+    pthread_join(pp_thread_, NULL);
+    pp_thread_started_ = false;
+  }
+
+  for (uint32_t i = 0; i < kMaxNumPPFeatures; i++) {
+    delete pp_pending_[i];
+    pp_pending_[i] = NULL;
+  }
+}
+
+void *HWPrimary::PPThread(void *context) {
+  if (context) {
+    reinterpret_cast<HWPrimary *>(context)->PPThreadMain();
+  }
+
+  return NULL;
+}
+
+void HWPrimary::PPThreadMain() {
+  PPFeatureInfo *features[kMaxNumPPFeatures] = {};
+  uint64_t digests[kMaxNumPPFeatures] = {};
+
+  prctl(PR_SET_NAME, "SDM_PPFeatures", 0, 0, 0);
+
+  pp_locker_.Lock();
+  while (true) {
+    uint32_t feature_mask = TakePendingPPFeatures(features, digests);
+    if (!feature_mask) {
+      // Features still queued at exit are programmed before leaving.
+      pp_applied_batches_ = pp_queued_batches_;
+      pp_locker_.Broadcast();
+      if (exit_pp_thread_) {
+        break;
+      }
+      pp_locker_.Wait();
+      continue;
+    }
+
+    uint32_t batch = pp_queued_batches_;
+    uint32_t failed_mask = 0;
+    pp_busy_ = true;
+    pp_locker_.Unlock();
+
+    ApplyPPFeatures(features, &failed_mask);
+
+    pp_locker_.Lock();
+    DropFailedPPFeatures(failed_mask, digests);
+    pp_applied_batches_ = batch;
+    pp_busy_ = false;
+    pp_locker_.Broadcast();
+  }
+  pp_locker_.Unlock();
 }
 
 DisplayError HWPrimary::SetMixerAttributes(const HWMixerAttributes &mixer_attributes) {
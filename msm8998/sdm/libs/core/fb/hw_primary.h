@@ -26,6 +26,8 @@
 #define __HW_PRIMARY_H__
 
 #include <sys/poll.h>
+#include <pthread.h>
+#include <utils/locker.h>
 #include <vector>
 #include <string>
 
@@ -39,6 +41,7 @@ class HWPrimary : public HWDevice {
 
  protected:
   virtual DisplayError Init();
+  virtual DisplayError Deinit();
   virtual DisplayError GetNumDisplayAttributes(uint32_t *count);
   virtual DisplayError GetActiveConfig(uint32_t *active_config);
   virtual DisplayError GetDisplayAttributes(uint32_t index,
@@ -79,6 +82,20 @@ class HWPrimary : public HWDevice {
   bool GetCurrentModeFromSysfs(size_t *curr_x_pixels, size_t *curr_y_pixels);
   void UpdateMixerAttributes();
   void SetAVRFlags(const HWAVRInfo &hw_avr_info, uint32_t *avr_flags);
+  int GetSysfsNode(const char *node_path, int flags, int *fd);
+  DisplayError WriteBrightness(int level);
+  void StartBrightnessThread();
+  void StopBrightnessThread();
+  static void *BrightnessThread(void *context);
+  void BrightnessThreadMain();
+  void StartPPThread();
+  void StopPPThread();
+  static void *PPThread(void *context);
+  void PPThreadMain();
+  uint32_t TakePendingPPFeatures(PPFeatureInfo **features, uint64_t *digests);
+  DisplayError ApplyPPFeatures(PPFeatureInfo **features, uint32_t *failed_mask);
+  void DropFailedPPFeatures(uint32_t failed_mask, const uint64_t *digests);
+  void WaitForPPFeatures();
 
   std::vector<DisplayConfigVariableInfo> display_configs_;
   std::vector<std::string> display_config_strings_;
@@ -87,6 +104,36 @@ class HWPrimary : public HWDevice {
   const char *kAutoRefreshNode = "/sys/devices/virtual/graphics/fb0/msm_cmd_autorefresh_en";
   bool auto_refresh_ = false;
   bool avr_prop_disabled_ = false;
+
+  // Sysfs nodes are opened once and rewritten in place, every value is written at offset 0.
+  int brightness_fd_ = -1;
+  int dynamic_fps_fd_ = -1;
+  int idle_time_fd_ = -1;
+
+  // Brightness requests are handed to a writer thread that applies only the latest level and
+  // then holds off for a frame, so a burst of requests becomes one sysfs write per vsync period.
+  Locker brightness_locker_;
+  pthread_t brightness_thread_ = {};
+  bool brightness_thread_started_ = false;
+  bool exit_brightness_thread_ = false;
+  int pending_brightness_ = -1;
+  uint32_t brightness_period_us_ = 16666;
+
+  // Post processing features are queued per feature id with the latest config winning, and are
+  // programmed by a worker thread. A config matching the latest one queued or programmed for its
+  // feature is dropped. Each commit waits for the features queued before the previous commit, so
+  // they are at most a frame late without blocking the frame that queued them.
+  Locker pp_locker_;
+  pthread_t pp_thread_ = {};
+  bool pp_thread_started_ = false;
+  bool exit_pp_thread_ = false;
+  bool pp_busy_ = false;
+  PPFeatureInfo *pp_pending_[kMaxNumPPFeatures] = {};
+  uint64_t pp_pending_digest_[kMaxNumPPFeatures] = {};
+  uint64_t pp_expected_digest_[kMaxNumPPFeatures] = {};
+  uint32_t pp_queued_batches_ = 0;
+  uint32_t pp_applied_batches_ = 0;
+  uint32_t pp_commit_batches_ = 0;
 };
 
 }  // namespace sdm
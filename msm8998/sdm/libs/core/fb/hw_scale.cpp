@@ -97,6 +97,12 @@ void* HWScaleV1::GetScaleDataRef(uint32_t index, HWSubBlockType sub_block_type)
   return NULL;
 }
 
+void HWScaleV1::ResetScaleParams(uint32_t index, HWSubBlockType sub_block_type) {
+  if (sub_block_type != kHWDestinationScalar) {
+    scale_data_v1_.at(index) = {};
+  }
+}
+
 void HWScaleV1::DumpScaleData(void *mdp_scale) {
   if (!mdp_scale) {
     return;
@@ -238,6 +244,14 @@ void* HWScaleV2::GetScaleDataRef(uint32_t index, HWSubBlockType sub_block_type)
   }
 }
 
+void HWScaleV2::ResetScaleParams(uint32_t index, HWSubBlockType sub_block_type) {
+  if (sub_block_type != kHWDestinationScalar) {
+    scale_data_v2_.at(index) = {};
+  } else {
+    dest_scale_data_v2_.erase(index);
+  }
+}
+
 uint32_t HWScaleV2::GetMDPScalingFilter(ScalingFilterConfig filter_cfg) {
   switch (filter_cfg) {
   case kFilterEdgeDirected:
@@ -44,6 +44,7 @@ class HWScale {
   virtual void* GetScaleDataRef(uint32_t index, HWSubBlockType sub_block_type) = 0;
   virtual void DumpScaleData(void *mdp_scale) = 0;
   virtual void ResetScaleParams() = 0;
+  virtual void ResetScaleParams(uint32_t index, HWSubBlockType sub_block_type) = 0;
  protected:
   virtual ~HWScale() { }
 };
@@ -55,6 +56,7 @@ class HWScaleV1 : public HWScale {
   virtual void* GetScaleDataRef(uint32_t index, HWSubBlockType sub_block_type);
   virtual void DumpScaleData(void *mdp_scale);
   virtual void ResetScaleParams() { scale_data_v1_ = {}; }
+  virtual void ResetScaleParams(uint32_t index, HWSubBlockType sub_block_type);
 
  protected:
   ~HWScaleV1() {}
@@ -68,6 +70,7 @@ class HWScaleV2 : public HWScale {
   virtual void* GetScaleDataRef(uint32_t index, HWSubBlockType sub_block_type);
   virtual void DumpScaleData(void *mdp_scale);
   virtual void ResetScaleParams() { scale_data_v2_ = {}; dest_scale_data_v2_ = {}; }
+  virtual void ResetScaleParams(uint32_t index, HWSubBlockType sub_block_type);
 
  protected:
   ~HWScaleV2() {}
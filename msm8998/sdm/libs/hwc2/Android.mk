@@ -36,6 +36,8 @@ LOCAL_SRC_FILES               := hwc_session.cpp \
                                  hwc_layers.cpp \
                                  hwc_callbacks.cpp \
                                  cpuhint.cpp \
+                                 hwc_cadence_detector.cpp \
+                                 hwc_idle_policy.cpp \
                                  hwc_tonemapper.cpp \
                                  hwc_socket_handler.cpp \
                                  hwc_buffer_allocator.cpp
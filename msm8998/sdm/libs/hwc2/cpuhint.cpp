@@ -29,8 +29,11 @@
 
 #include <cutils/properties.h>
 #include <dlfcn.h>
+#include <inttypes.h>
 #include <utils/debug.h>
 
+#include <algorithm>
+
 #include "cpuhint.h"
 #include "hwc_debugger.h"
 
@@ -45,15 +48,15 @@ DisplayError CPUHint::Init(HWCDebugHandler *debug_handler) {
     return kErrorNotSupported;
   }
 
-  int pre_enable_window = -1;
-  debug_handler->GetProperty("sdm.perf_hint_window", &pre_enable_window);
-  if (pre_enable_window <= 0) {
-    DLOGI("Invalid CPU Hint Pre-enable Window %d", pre_enable_window);
+  int release_window = -1;
+  debug_handler->GetProperty("sdm.perf_hint_window", &release_window);
+  if (release_window <= 0) {
+    DLOGI("Invalid CPU Hint Window %d", release_window);
     return kErrorNotSupported;
   }
 
-  DLOGI("CPU Hint Pre-enable Window %d", pre_enable_window);
-  pre_enable_window_ = pre_enable_window;
+  DLOGI("CPU Hint Window %d", release_window);
+  release_window_ = release_window;
 
   if (vendor_ext_lib_.Open(path)) {
     if (!vendor_ext_lib_.Sym("perf_lock_acq", reinterpret_cast<void **>(&fn_lock_acquire_)) ||
@@ -70,23 +73,32 @@ DisplayError CPUHint::Init(HWCDebugHandler *debug_handler) {
   return kErrorNone;
 }
 
-void CPUHint::Set() {
-  if (!enabled_) {
+void CPUHint::UpdateFrameTime(int64_t frame_time_ns, int64_t vsync_period_ns) {
+  if (!enabled_ || frame_time_ns <= 0 || vsync_period_ns <= 0) {
     return;
   }
-  if (lock_acquired_) {
-    return;
+
+  if (!ewma_frame_time_ns_) {
+    ewma_frame_time_ns_ = frame_time_ns;
+  } else {
+    ewma_frame_time_ns_ += (frame_time_ns - ewma_frame_time_ns_) >> kEwmaShift;
   }
-  if (frame_countdown_) {
-    --frame_countdown_;
+
+  // A single late frame, e.g. a GPU fallback spike, boosts right away instead of waiting for
+  // the average to catch up.
+  int64_t predicted_ns = std::max(ewma_frame_time_ns_, frame_time_ns);
+  if ((predicted_ns * 100) > (vsync_period_ns * kBoostThresholdPct)) {
+    frame_countdown_ = release_window_;
+    Acquire();
     return;
   }
 
-  int hint = HINT;
-  lock_handle_ = fn_lock_acquire_(0 /*handle*/, 0/*duration*/,
-                                  &hint, sizeof(hint) / sizeof(int));
-  if (lock_handle_ >= 0) {
-    lock_acquired_ = true;
+  if ((ewma_frame_time_ns_ * 100) < (vsync_period_ns * kReleaseThresholdPct)) {
+    if (frame_countdown_) {
+      --frame_countdown_;
+      return;
+    }
+    Release();
   }
 }
 
@@ -95,8 +107,26 @@ void CPUHint::Reset() {
     return;
   }
 
-  frame_countdown_ = pre_enable_window_;
+  ewma_frame_time_ns_ = 0;
+  frame_countdown_ = 0;
+  Release();
+}
+
+void CPUHint::Acquire() {
+  if (lock_acquired_) {
+    return;
+  }
+
+  int hint = HINT;
+  lock_handle_ = fn_lock_acquire_(0 /*handle*/, 0/*duration*/,
+                                  &hint, sizeof(hint) / sizeof(int));
+  if (lock_handle_ >= 0) {
+    DLOGV_IF(kTagClient, "Acquired, predicted frame time %" PRId64 " ns", ewma_frame_time_ns_);
+    lock_acquired_ = true;
+  }
+}
 
+void CPUHint::Release() {
   if (!lock_acquired_) {
     return;
   }
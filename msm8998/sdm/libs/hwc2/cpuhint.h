@@ -37,18 +37,34 @@ namespace sdm {
 
 class HWCDebugHandler;
 
+// Drives the display layer perf hint from the time the composer thread spends on each frame.
+// Frame times are smoothed with an EWMA and compared against the vsync period, so that the boost
+// is held only while frames are predicted to miss their deadline.
 class CPUHint {
  public:
   DisplayError Init(HWCDebugHandler *debug_handler);
-  void Set();
+  // Reports composer thread time of the last frame against the current vsync period.
+  void UpdateFrameTime(int64_t frame_time_ns, int64_t vsync_period_ns);
+  // Releases the hint immediately, e.g. on idle or power off.
   void Reset();
 
  private:
   enum { HINT =  0x4501 /* 45-display layer hint, 01-Enable */ };
+  // Boost when the predicted frame time exceeds this share of the vsync period
+  static const int kBoostThresholdPct = 75;
+  // Consider releasing once the predicted frame time falls below this share
+  static const int kReleaseThresholdPct = 40;
+  // EWMA weight of the newest sample, as 1 / (1 << kEwmaShift)
+  static const int kEwmaShift = 2;
+
+  void Acquire();
+  void Release();
+
   bool enabled_ = false;
-  // frames to wait before setting this hint
-  int pre_enable_window_ = 0;
+  // frames below the release threshold before the hint is released
+  int release_window_ = 0;
   int frame_countdown_ = 0;
+  int64_t ewma_frame_time_ns_ = 0;
   int lock_handle_ = 0;
   bool lock_acquired_ = false;
   DynLib vendor_ext_lib_;
@@ -0,0 +1,220 @@
+/*
+* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <math.h>
+#include <utils/constants.h>
+#include <utils/debug.h>
+#include <algorithm>
+
+#include "hwc_cadence_detector.h"
+
+#define __CLASS__ "HWCCadenceDetector"
+
+namespace sdm {
+
+// Content frame rates which are recognized. Anything else is treated as free running content.
+static const uint32_t kStandardFps[] = { 24, 25, 30, 48, 50, 60 };
+
+void HWCCadenceDetector::Init(uint32_t min_refresh_rate, uint32_t max_refresh_rate) {
+  min_refresh_rate_ = min_refresh_rate;
+  max_refresh_rate_ = max_refresh_rate;
+  Reset();
+}
+
+void HWCCadenceDetector::Reset() {
+  layers_.clear();
+  candidate_rate_ = 0;
+  candidate_frames_ = 0;
+  selected_rate_ = 0;
+  content_fps_ = 0;
+}
+
+void HWCCadenceDetector::UpdateLayer(uint64_t layer_id, uint64_t buffer_id, int64_t now_ns) {
+  if (!buffer_id) {
+    return;
+  }
+
+  LayerHistory &history = layers_[layer_id];
+  if (history.buffer_id == buffer_id) {
+    return;
+  }
+  history.buffer_id = buffer_id;
+
+  // Restart the window when the layer resumes after being static, the gap is not a cadence.
+  if (history.count && ((now_ns - history.Last()) > kStaticTimeoutNs)) {
+    history.count = 0;
+  }
+
+  history.timestamps[history.head] = now_ns;
+  history.head = (history.head + 1) % kWindowSize;
+  if (history.count < kWindowSize) {
+    history.count++;
+  }
+}
+
+uint32_t HWCCadenceDetector::DetectFps(const LayerHistory &history, int64_t vsync_period_ns) {
+  if (history.count < (kMinIntervals + 1)) {
+    return 0;
+  }
+
+  uint32_t oldest = (history.head + kWindowSize - history.count) % kWindowSize;
+  int64_t min_interval = INT64_MAX;
+  int64_t max_interval = 0;
+  for (uint32_t i = 1; i < history.count; i++) {
+    int64_t interval = history.timestamps[(oldest + i) % kWindowSize] -
+                       history.timestamps[(oldest + i - 1) % kWindowSize];
+    min_interval = std::min(min_interval, interval);
+    max_interval = std::max(max_interval, interval);
+  }
+
+  // Updates land on vsync, so the content interval is spread over vsync multiples, e.g. 33.3/50ms
+  // for 24fps or 16.7/16.7/16.7/33.3ms for 48fps on 60Hz. A least squares fit over the window
+  // averages this out, where the window end points alone can be a whole vsync off.
+  double n = history.count;
+  double sum_x = 0.0, sum_y = 0.0, sum_xx = 0.0, sum_xy = 0.0;
+  for (uint32_t i = 0; i < history.count; i++) {
+    double x = i;
+    double y = DOUBLE(history.timestamps[(oldest + i) % kWindowSize] - history.timestamps[oldest]);
+    sum_x += x;
+    sum_y += y;
+    sum_xx += x * x;
+    sum_xy += x * y;
+  }
+  int64_t mean_interval = static_cast<int64_t>((n * sum_xy - sum_x * sum_y) /
+                                               (n * sum_xx - sum_x * sum_x));
+
+  // More than one vsync of quantization jitter means the content has no steady cadence
+  if (mean_interval <= 0 || max_interval > (mean_interval + vsync_period_ns) ||
+      min_interval < (mean_interval - vsync_period_ns)) {
+    return 0;
+  }
+
+  float fps = 1000000000.0f / FLOAT(mean_interval);
+  for (uint32_t standard_fps : kStandardFps) {
+    // 2% tolerance keeps 24 and 25 apart while accepting 23.976 and 29.97
+    if (fabsf(fps - FLOAT(standard_fps)) <= (FLOAT(standard_fps) * 0.02f)) {
+      return standard_fps;
+    }
+  }
+
+  return 0;
+}
+
+uint32_t HWCCadenceDetector::GetMultiple(uint32_t fps_a, uint32_t fps_b) {
+  uint32_t a = fps_a, b = fps_b;
+  while (b) {
+    uint32_t t = a % b;
+    a = b;
+    b = t;
+  }
+
+  return (fps_a / a) * fps_b;
+}
+
+uint32_t HWCCadenceDetector::GetRefreshRate(int64_t now_ns, int64_t vsync_period_ns) {
+  uint32_t content_fps = 0;
+  bool updating = false;
+  bool free_running = false;
+
+  for (auto it = layers_.begin(); it != layers_.end();) {
+    LayerHistory &history = it->second;
+    int64_t idle_ns = now_ns - history.Last();
+    if (idle_ns > kStaleTimeoutNs) {
+      // Destroyed or long static layers
+      it = layers_.erase(it);
+      continue;
+    }
+    it++;
+
+    // Static layers, e.g. UI on top of a video, do not constrain the refresh rate
+    if (idle_ns > kStaticTimeoutNs) {
+      history.fps = 0;
+      continue;
+    }
+
+    updating = true;
+    history.fps = DetectFps(history, vsync_period_ns);
+    if (!history.fps) {
+      free_running = true;
+      continue;
+    }
+
+    // Layers drawing on every vsync measure the lowered refresh rate itself. Unless the layer ran
+    // at that rate before the switch, its content rate is unknown and the rate goes back to max.
+    if (selected_rate_ && selected_rate_ < max_refresh_rate_ && history.fps == selected_rate_ &&
+        history.fps_at_switch != selected_rate_) {
+      free_running = true;
+      continue;
+    }
+    content_fps = content_fps ? GetMultiple(content_fps, history.fps) : history.fps;
+  }
+
+  uint32_t refresh_rate = 0;
+  if (updating && !free_running && content_fps) {
+    // Lowest refresh rate within the panel range which is a multiple of the content rate
+    refresh_rate = ((min_refresh_rate_ + content_fps - 1) / content_fps) * content_fps;
+    if (refresh_rate > max_refresh_rate_) {
+      refresh_rate = 0;
+    }
+  }
+  content_fps_ = free_running ? 0 : content_fps;
+
+  uint32_t requested = refresh_rate ? refresh_rate : max_refresh_rate_;
+  uint32_t selected = selected_rate_ ? selected_rate_ : max_refresh_rate_;
+  if (requested >= selected) {
+    // Going up is applied right away to avoid judder
+    candidate_frames_ = 0;
+  } else if (candidate_rate_ == refresh_rate) {
+    candidate_frames_++;
+  } else {
+    candidate_rate_ = refresh_rate;
+    candidate_frames_ = 1;
+  }
+
+  if ((requested >= selected || candidate_frames_ >= kHysteresisFrames) &&
+      selected_rate_ != refresh_rate) {
+    DLOGI_IF(kTagClient, "Content cadence %d fps, refresh rate %d -> %d", content_fps_,
+             selected, requested);
+    selected_rate_ = refresh_rate;
+    candidate_frames_ = 0;
+    rate_switches_++;
+    for (auto &layer : layers_) {
+      layer.second.fps_at_switch = layer.second.fps;
+    }
+  }
+
+  return selected_rate_;
+}
+
+void HWCCadenceDetector::Dump(std::ostringstream *os) {
+  *os << "cadence: content_fps: " << content_fps_ << " selected_rate: " << selected_rate_
+      << " tracked_layers: " << layers_.size() << " switches: " << rate_switches_ << std::endl;
+}
+
+}  // namespace sdm
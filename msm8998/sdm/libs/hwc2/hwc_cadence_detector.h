@@ -0,0 +1,88 @@
+/*
+* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HWC_CADENCE_DETECTOR_H__
+#define __HWC_CADENCE_DETECTOR_H__
+
+#include <stdint.h>
+#include <map>
+#include <sstream>
+
+namespace sdm {
+
+// Tracks buffer update timestamps of every layer over a sliding window and recognizes standard
+// content frame rates. It selects the lowest panel refresh rate which is an integral multiple of
+// the cadence of all updating layers, so that content can be shown without judder.
+class HWCCadenceDetector {
+ public:
+  void Init(uint32_t min_refresh_rate, uint32_t max_refresh_rate);
+  // Records the buffer of a layer for the frame being validated at now_ns.
+  void UpdateLayer(uint64_t layer_id, uint64_t buffer_id, int64_t now_ns);
+  // Returns the refresh rate suited for the current content, or 0 if no cadence is established.
+  // vsync_period_ns is the period the panel currently runs at.
+  uint32_t GetRefreshRate(int64_t now_ns, int64_t vsync_period_ns);
+  void Reset();
+  void Dump(std::ostringstream *os);
+
+ private:
+  static const uint32_t kWindowSize = 24;
+  // Minimum number of intervals required before a layer cadence is trusted.
+  static const uint32_t kMinIntervals = 12;
+  // Number of consecutive frames a lower refresh rate must be chosen before it is applied.
+  static const uint32_t kHysteresisFrames = 10;
+  static const int64_t kStaticTimeoutNs = 250000000LL;
+  static const int64_t kStaleTimeoutNs = 2000000000LL;
+
+  struct LayerHistory {
+    uint64_t buffer_id = 0;
+    int64_t timestamps[kWindowSize] = {};
+    uint32_t head = 0;
+    uint32_t count = 0;
+    uint32_t fps = 0;
+    // Rate measured when the refresh rate was last switched, tells content from display pacing.
+    uint32_t fps_at_switch = 0;
+    int64_t Last() const { return timestamps[(head + kWindowSize - 1) % kWindowSize]; }
+  };
+
+  uint32_t DetectFps(const LayerHistory &history, int64_t vsync_period_ns);
+  uint32_t GetMultiple(uint32_t fps_a, uint32_t fps_b);
+
+  uint32_t min_refresh_rate_ = 0;
+  uint32_t max_refresh_rate_ = 0;
+  std::map<uint64_t, LayerHistory> layers_;
+  uint32_t candidate_rate_ = 0;
+  uint32_t candidate_frames_ = 0;
+  uint32_t selected_rate_ = 0;
+  uint32_t content_fps_ = 0;
+  uint32_t rate_switches_ = 0;
+};
+
+}  // namespace sdm
+
+#endif  // __HWC_CADENCE_DETECTOR_H__
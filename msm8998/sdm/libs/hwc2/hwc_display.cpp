@@ -1765,8 +1765,8 @@ int HWCDisplay::GetVisibleDisplayRect(hwc_rect_t *visible_rect) {
   visible_rect->top = INT(display_rect_.top);
   visible_rect->right = INT(display_rect_.right);
   visible_rect->bottom = INT(display_rect_.bottom);
-  DLOGI("Dpy = %d Visible Display Rect(%d %d %d %d)", visible_rect->left, visible_rect->top,
-        visible_rect->right, visible_rect->bottom);
+  DLOGV_IF(kTagClient, "Dpy = %d Visible Display Rect(%d %d %d %d)", INT(id_),
+           visible_rect->left, visible_rect->top, visible_rect->right, visible_rect->bottom);
 
   return 0;
 }
@@ -33,8 +33,10 @@
 #include <utils/debug.h>
 #include <stdarg.h>
 #include <sys/mman.h>
+#include <time.h>
 
 #include <map>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -113,6 +115,20 @@ int HWCDisplayPrimary::Init() {
   }
   color_mode_ = new HWCColorMode(display_intf_);
 
+  int disable_cadence_dynfps = 0;
+  HWCDebugHandler::Get()->GetProperty("persist.cadence_dynfps.disable", &disable_cadence_dynfps);
+  use_cadence_refresh_rate_ = !disable_cadence_dynfps && (min_refresh_rate_ < max_refresh_rate_);
+  cadence_detector_.Init(min_refresh_rate_, max_refresh_rate_);
+
+  int disable_adaptive_idle = 0;
+  int max_idle_timeout_ms = 2000;
+  HWCDebugHandler::Get()->GetProperty("persist.adaptive_idle.disable", &disable_adaptive_idle);
+  HWCDebugHandler::Get()->GetProperty("sdm.idle_time.max", &max_idle_timeout_ms);
+  use_adaptive_idle_timeout_ = !disable_adaptive_idle;
+  idle_timeout_ms_ = UINT32(HWCDebugHandler::GetIdleTimeoutMs());
+  idle_policy_.Init(UINT32(max_idle_timeout_ms));
+  idle_policy_.SetBaseTimeout(idle_timeout_ms_);
+
   return INT(color_mode_->Init());
 }
 
@@ -155,9 +171,17 @@ void HWCDisplayPrimary::ProcessBootAnimCompleted() {
   }
 }
 
+static int64_t GetTimeNs() {
+  struct timespec ts = {};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
 HWC2::Error HWCDisplayPrimary::Validate(uint32_t *out_num_types, uint32_t *out_num_requests) {
   auto status = HWC2::Error::None;
   DisplayError error = kErrorNone;
+  int64_t start_ns = GetTimeNs();
+  validate_time_ns_ = 0;
 
   if (display_paused_) {
     MarkLayersForGPUBypass();
@@ -184,7 +208,7 @@ HWC2::Error HWCDisplayPrimary::Validate(uint32_t *out_num_types, uint32_t *out_n
   }
 
   bool one_updating_layer = SingleLayerUpdating();
-  ToggleCPUHint(one_updating_layer);
+  UpdateContentCadence();
 
   uint32_t refresh_rate = GetOptimalRefreshRate(one_updating_layer);
   if (current_refresh_rate_ != refresh_rate) {
@@ -198,6 +222,16 @@ HWC2::Error HWCDisplayPrimary::Validate(uint32_t *out_num_types, uint32_t *out_n
 
   if (handle_idle_timeout_) {
     handle_idle_timeout_ = false;
+    if (cpu_hint_) {
+      cpu_hint_->Reset();
+    }
+  } else if (use_adaptive_idle_timeout_) {
+    // Only content updates feed the policy, the refresh requested on idle timeout does not.
+    uint32_t idle_timeout_ms = idle_policy_.UpdateFrame(GetTimeNs());
+    if (idle_timeout_ms != idle_timeout_ms_) {
+      display_intf_->SetIdleTimeoutMs(idle_timeout_ms);
+      idle_timeout_ms_ = idle_timeout_ms;
+    }
   }
 
   if (layer_set_.empty()) {
@@ -207,6 +241,7 @@ HWC2::Error HWCDisplayPrimary::Validate(uint32_t *out_num_types, uint32_t *out_n
   }
 
   status = PrepareLayerStack(out_num_types, out_num_requests);
+  validate_time_ns_ = GetTimeNs() - start_ns;
   return status;
 }
 
@@ -221,12 +256,25 @@ HWC2::Error HWCDisplayPrimary::Present(int32_t *out_retire_fence) {
       DLOGE("Flush failed. Error = %d", error);
     }
   } else {
+    int64_t start_ns = GetTimeNs();
     status = HWCDisplay::CommitLayerStack();
     if (status == HWC2::Error::None) {
       HandleFrameOutput();
       SolidFillCommit();
       status = HWCDisplay::PostCommitLayerStack(out_retire_fence);
     }
+    UpdateCPUHint(validate_time_ns_ + (GetTimeNs() - start_ns));
+    // A Present without its own Validate must not reuse this frame's validate time
+    validate_time_ns_ = 0;
+  }
+
+  return status;
+}
+
+HWC2::Error HWCDisplayPrimary::SetPowerMode(HWC2::PowerMode mode) {
+  auto status = HWCDisplay::SetPowerMode(mode);
+  if (mode == HWC2::PowerMode::Off && cpu_hint_) {
+    cpu_hint_->Reset();
   }
 
   return status;
@@ -354,16 +402,13 @@ void HWCDisplayPrimary::SetQDCMSolidFillInfo(bool enable, uint32_t color) {
   solid_fill_color_ = color;
 }
 
-void HWCDisplayPrimary::ToggleCPUHint(bool set) {
-  if (!cpu_hint_) {
+void HWCDisplayPrimary::UpdateCPUHint(int64_t frame_time_ns) {
+  if (!cpu_hint_ || !current_refresh_rate_) {
     return;
   }
 
-  if (set) {
-    cpu_hint_->Set();
-  } else {
-    cpu_hint_->Reset();
-  }
+  int64_t vsync_period_ns = 1000000000LL / current_refresh_rate_;
+  cpu_hint_->UpdateFrameTime(frame_time_ns, vsync_period_ns);
 }
 
 void HWCDisplayPrimary::SetSecureDisplay(bool secure_display_active) {
@@ -398,22 +443,59 @@ uint32_t HWCDisplayPrimary::GetOptimalRefreshRate(bool one_updating_layer) {
     return min_refresh_rate_;
   } else if (use_metadata_refresh_rate_ && one_updating_layer && metadata_refresh_rate_) {
     return metadata_refresh_rate_;
+  } else if (use_cadence_refresh_rate_ && current_refresh_rate_) {
+    int64_t vsync_period_ns = 1000000000LL / current_refresh_rate_;
+    uint32_t cadence_refresh_rate = cadence_detector_.GetRefreshRate(GetTimeNs(), vsync_period_ns);
+    if (cadence_refresh_rate) {
+      return cadence_refresh_rate;
+    }
   }
 
   return max_refresh_rate_;
 }
 
+void HWCDisplayPrimary::UpdateContentCadence() {
+  if (!use_cadence_refresh_rate_) {
+    return;
+  }
+
+  int64_t now_ns = GetTimeNs();
+  for (auto hwc_layer : layer_set_) {
+    Layer *layer = hwc_layer->GetSDMLayer();
+    if (layer->flags.solid_fill) {
+      continue;
+    }
+    cadence_detector_.UpdateLayer(hwc_layer->GetId(), layer->input_buffer.buffer_id, now_ns);
+  }
+}
+
+std::string HWCDisplayPrimary::Dump() {
+  std::ostringstream os;
+  os << HWCDisplay::Dump();
+  if (use_cadence_refresh_rate_) {
+    cadence_detector_.Dump(&os);
+  }
+  if (use_adaptive_idle_timeout_) {
+    idle_policy_.Dump(&os);
+  }
+  return os.str();
+}
+
 DisplayError HWCDisplayPrimary::Refresh() {
   DisplayError error = kErrorNone;
 
   callbacks_->Refresh(HWC_DISPLAY_PRIMARY);
   handle_idle_timeout_ = true;
+  idle_policy_.IdleTimeout(GetTimeNs());
   validated_ = false;
 
   return error;
 }
 
 void HWCDisplayPrimary::SetIdleTimeoutMs(uint32_t timeout_ms) {
+  // Explicitly requested timeouts, including 0 to disable the fallback, reset the learnt one.
+  idle_policy_.SetBaseTimeout(timeout_ms);
+  idle_timeout_ms_ = timeout_ms;
   display_intf_->SetIdleTimeoutMs(timeout_ms);
 }
 
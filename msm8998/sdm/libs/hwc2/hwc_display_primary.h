@@ -33,6 +33,8 @@
 #include <string>
 
 #include "cpuhint.h"
+#include "hwc_cadence_detector.h"
+#include "hwc_idle_policy.h"
 #include "hwc_display.h"
 
 namespace sdm {
@@ -68,6 +70,8 @@ class HWCDisplayPrimary : public HWCDisplay {
   virtual int GetFrameCaptureStatus() { return frame_capture_status_; }
   virtual DisplayError SetDetailEnhancerConfig(const DisplayDetailEnhancerData &de_data);
   virtual DisplayError ControlPartialUpdate(bool enable, uint32_t *pending);
+  virtual std::string Dump(void);
+  virtual HWC2::Error SetPowerMode(HWC2::PowerMode mode);
 
  private:
   HWCDisplayPrimary(CoreInterface *core_intf, BufferAllocator *buffer_allocator,
@@ -77,9 +81,10 @@ class HWCDisplayPrimary : public HWCDisplay {
   virtual DisplayError DisablePartialUpdateOneFrame();
   void ProcessBootAnimCompleted(void);
   void SetQDCMSolidFillInfo(bool enable, uint32_t color);
-  void ToggleCPUHint(bool set);
+  void UpdateCPUHint(int64_t frame_time_ns);
   void ForceRefreshRate(uint32_t refresh_rate);
   uint32_t GetOptimalRefreshRate(bool one_updating_layer);
+  void UpdateContentCadence();
   void HandleFrameOutput();
   void HandleFrameCapture();
   void HandleFrameDump();
@@ -88,7 +93,14 @@ class HWCDisplayPrimary : public HWCDisplay {
 
   BufferAllocator *buffer_allocator_ = nullptr;
   CPUHint *cpu_hint_ = nullptr;
+  // Composer time spent in the last Validate, reported to cpu_hint_ along with Present
+  int64_t validate_time_ns_ = 0;
   bool handle_idle_timeout_ = false;
+  bool use_cadence_refresh_rate_ = false;
+  HWCCadenceDetector cadence_detector_;
+  bool use_adaptive_idle_timeout_ = false;
+  HWCIdlePolicy idle_policy_;
+  uint32_t idle_timeout_ms_ = 0;  // Timeout last programmed on display_intf_
 
   // Primary output buffer configuration
   LayerBuffer output_buffer_ = {};
@@ -31,10 +31,15 @@
 #include <utils/debug.h>
 #include <sync/sync.h>
 #include <stdarg.h>
+#include <time.h>
 #ifndef USE_GRALLOC1
 #include <gr.h>
 #endif
 
+#include <iomanip>
+#include <sstream>
+#include <string>
+
 #include "hwc_display_virtual.h"
 #include "hwc_debugger.h"
 
@@ -98,16 +103,22 @@ HWCDisplayVirtual::HWCDisplayVirtual(CoreInterface *core_intf, HWCBufferAllocato
 }
 
 int HWCDisplayVirtual::Init() {
-  output_buffer_ = new LayerBuffer();
+  current_slot_ = 0;
+  output_buffer_ = &output_slots_[current_slot_].buffer;
   return HWCDisplay::Init();
 }
 
 int HWCDisplayVirtual::Deinit() {
   int status = 0;
-  if (output_buffer_) {
-    delete output_buffer_;
-    output_buffer_ = nullptr;
+  for (uint32_t i = 0; i < kOutputBufferDepth; i++) {
+    OutputSlot *slot = &output_slots_[i];
+    RetireWriteback(slot, slot->dump_pending);
+    if (slot->buffer.acquire_fence_fd >= 0) {
+      close(slot->buffer.acquire_fence_fd);
+      slot->buffer.acquire_fence_fd = -1;
+    }
   }
+  output_buffer_ = nullptr;
   status = HWCDisplay::Deinit();
 
   return status;
@@ -116,6 +127,9 @@ int HWCDisplayVirtual::Deinit() {
 HWC2::Error HWCDisplayVirtual::Validate(uint32_t *out_num_types, uint32_t *out_num_requests) {
   auto status = HWC2::Error::None;
 
+  // Never wait for the previous writeback here, it overlaps with this frame's validation.
+  RetireCompletedWritebacks();
+
   if (display_paused_) {
     MarkLayersForGPUBypass();
     return status;
@@ -135,23 +149,13 @@ HWC2::Error HWCDisplayVirtual::Present(int32_t *out_retire_fence) {
       DLOGE("Flush failed. Error = %d", error);
     }
   } else {
+    // SetOutputBuffer may have moved to a new slot after Validate, write into that slot's buffer
+    // so that the buffer, its acquire fence and the queued writeback all match.
+    OutputSlot *slot = &output_slots_[current_slot_];
+    layer_stack_.output_buffer = &slot->buffer;
     status = HWCDisplay::CommitLayerStack();
     if (status == HWC2::Error::None) {
-      if (dump_frame_count_ && !flush_ && dump_output_layer_) {
-        if (output_handle_ && output_handle_->base) {
-          BufferInfo buffer_info;
-          const private_handle_t *output_handle =
-              reinterpret_cast<const private_handle_t *>(output_buffer_->buffer_id);
-          buffer_info.buffer_config.width = static_cast<uint32_t>(output_handle->width);
-          buffer_info.buffer_config.height = static_cast<uint32_t>(output_handle->height);
-          buffer_info.buffer_config.format =
-              GetSDMFormat(output_handle->format, output_handle->flags);
-          buffer_info.alloc_buffer_info.size = static_cast<uint32_t>(output_handle->size);
-          DumpOutputBuffer(buffer_info, reinterpret_cast<void *>(output_handle->base),
-                           layer_stack_.retire_fence_fd);
-        }
-      }
-
+      QueueWriteback(slot);
       status = HWCDisplay::PostCommitLayerStack(out_retire_fence);
     }
   }
@@ -159,15 +163,101 @@ HWC2::Error HWCDisplayVirtual::Present(int32_t *out_retire_fence) {
     close(output_buffer_->acquire_fence_fd);
     output_buffer_->acquire_fence_fd = -1;
   }
+  RetireCompletedWritebacks();
   return status;
 }
 
+void HWCDisplayVirtual::QueueWriteback(OutputSlot *slot) {
+  // Only has work to do when a buffer is committed again without a new SetOutputBuffer call.
+  RetireWriteback(slot, slot->dump_pending);
+
+  frames_submitted_++;
+  if (layer_stack_.retire_fence_fd >= 0) {
+    slot->writeback_fence = dup(layer_stack_.retire_fence_fd);
+  } else {
+    frames_completed_++;
+    window_frames_++;
+  }
+
+  if (dump_frame_count_ && !flush_ && dump_output_layer_ && output_handle_ &&
+      output_handle_->base) {
+    BufferInfo &buffer_info = slot->dump_info;
+    buffer_info.buffer_config.width = static_cast<uint32_t>(output_handle_->width);
+    buffer_info.buffer_config.height = static_cast<uint32_t>(output_handle_->height);
+    buffer_info.buffer_config.format = GetSDMFormat(output_handle_->format, output_handle_->flags);
+    buffer_info.alloc_buffer_info.size = static_cast<uint32_t>(output_handle_->size);
+    slot->dump_base = reinterpret_cast<void *>(output_handle_->base);
+    slot->dump_index = dump_frame_index_;
+    slot->dump_pending = true;
+  }
+}
+
+void HWCDisplayVirtual::RetireWriteback(OutputSlot *slot, bool wait) {
+  bool written = true;
+
+  if (slot->writeback_fence >= 0) {
+    written = (sync_wait(slot->writeback_fence, wait ? 1000 : 0) == 0);
+    if (written) {
+      frames_completed_++;
+      window_frames_++;
+    } else {
+      frames_late_++;
+    }
+    close(slot->writeback_fence);
+    slot->writeback_fence = -1;
+  }
+
+  if (slot->dump_pending) {
+    if (written) {
+      // File name is derived from dump_frame_index_, which has moved on since this frame was
+      // committed.
+      uint32_t dump_frame_index = dump_frame_index_;
+      dump_frame_index_ = slot->dump_index;
+      DumpOutputBuffer(slot->dump_info, slot->dump_base, -1);
+      dump_frame_index_ = dump_frame_index;
+    }
+    slot->dump_pending = false;
+    slot->dump_base = nullptr;
+  }
+}
+
+void HWCDisplayVirtual::RetireCompletedWritebacks() {
+  for (uint32_t i = 0; i < kOutputBufferDepth; i++) {
+    OutputSlot *slot = &output_slots_[i];
+    if (slot->writeback_fence >= 0 && sync_wait(slot->writeback_fence, 0) == 0) {
+      RetireWriteback(slot, false);
+    }
+  }
+
+  UpdateThroughput();
+}
+
+void HWCDisplayVirtual::UpdateThroughput() {
+  struct timespec ts = {};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  int64_t now_ns = static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+
+  if (!window_start_ns_) {
+    window_start_ns_ = now_ns;
+    window_frames_ = 0;
+    return;
+  }
+
+  int64_t elapsed_ns = now_ns - window_start_ns_;
+  if (elapsed_ns >= 1000000000LL) {
+    achieved_fps_ = FLOAT(window_frames_) * 1e9f / FLOAT(elapsed_ns);
+    window_start_ns_ = now_ns;
+    window_frames_ = 0;
+  }
+}
+
 int HWCDisplayVirtual::SetConfig(uint32_t width, uint32_t height) {
   DisplayConfigVariableInfo variable_info;
   variable_info.x_pixels = width;
   variable_info.y_pixels = height;
   // TODO(user): Need to get the framerate of primary display and update it.
   variable_info.fps = 60;
+  requested_fps_ = variable_info.fps;
   return display_intf_->SetActiveConfig(&variable_info);
 }
 
@@ -177,6 +267,16 @@ HWC2::Error HWCDisplayVirtual::SetOutputBuffer(buffer_handle_t buf, int32_t rele
   }
   const private_handle_t *output_handle = static_cast<const private_handle_t *>(buf);
 
+  // Move to the next output slot, the previous buffers may still be in writeback. Their fences
+  // are only waited on when a deferred frame dump needs the content.
+  current_slot_ = (current_slot_ + 1) % kOutputBufferDepth;
+  OutputSlot *slot = &output_slots_[current_slot_];
+  RetireWriteback(slot, slot->dump_pending);
+  output_buffer_ = &slot->buffer;
+  if (output_buffer_->acquire_fence_fd >= 0) {
+    close(output_buffer_->acquire_fence_fd);
+  }
+
   // Fill output buffer parameters (width, height, format, plane information, fence)
   output_buffer_->acquire_fence_fd = dup(release_fence);
 
@@ -235,4 +335,18 @@ void HWCDisplayVirtual::SetFrameDumpConfig(uint32_t count, uint32_t bit_mask_lay
   DLOGI("output_layer_dump_enable %d", dump_output_layer_);
 }
 
+std::string HWCDisplayVirtual::Dump() {
+  std::ostringstream os;
+  os << HWCDisplay::Dump();
+  uint32_t in_flight = 0;
+  for (uint32_t i = 0; i < kOutputBufferDepth; i++) {
+    in_flight += (output_slots_[i].writeback_fence >= 0) ? 1 : 0;
+  }
+  os << "writeback: requested_fps: " << requested_fps_ << " achieved_fps: " << std::fixed
+     << std::setprecision(1) << achieved_fps_ << " in_flight: " << in_flight
+     << " submitted: " << frames_submitted_ << " completed: " << frames_completed_
+     << " late: " << frames_late_ << std::endl;
+  return os.str();
+}
+
 }  // namespace sdm
@@ -32,6 +32,7 @@
 
 #include <qdMetaData.h>
 #include <gralloc_priv.h>
+#include <string>
 #include "hwc_display.h"
 
 namespace sdm {
@@ -47,16 +48,46 @@ class HWCDisplayVirtual : public HWCDisplay {
   virtual HWC2::Error Validate(uint32_t *out_num_types, uint32_t *out_num_requests);
   virtual HWC2::Error Present(int32_t *out_retire_fence);
   virtual void SetFrameDumpConfig(uint32_t count, uint32_t bit_mask_layer_type);
+  virtual std::string Dump(void);
   HWC2::Error SetOutputBuffer(buffer_handle_t buf, int32_t release_fence);
 
  private:
+  // Number of output buffers that may be in writeback at the same time. SurfaceFlinger hands a
+  // new output buffer every frame, so the next frame is validated and committed while the
+  // previous writeback is still in progress.
+  static const uint32_t kOutputBufferDepth = 3;
+
+  struct OutputSlot {
+    LayerBuffer buffer;
+    int writeback_fence = -1;     // Retire fence of the commit that writes into this buffer
+    bool dump_pending = false;    // Output dump deferred until the writeback completes
+    uint32_t dump_index = 0;
+    BufferInfo dump_info;
+    void *dump_base = nullptr;
+  };
+
   HWCDisplayVirtual(CoreInterface *core_intf, HWCBufferAllocator *buffer_allocator,
                     HWCCallbacks *callbacks);
   int SetConfig(uint32_t width, uint32_t height);
+  void QueueWriteback(OutputSlot *slot);
+  void RetireWriteback(OutputSlot *slot, bool wait);
+  void RetireCompletedWritebacks();
+  void UpdateThroughput();
 
   bool dump_output_layer_ = false;
+  OutputSlot output_slots_[kOutputBufferDepth];
+  uint32_t current_slot_ = 0;
   LayerBuffer *output_buffer_ = NULL;
   const private_handle_t *output_handle_ = nullptr;
+
+  // Writeback throughput, sampled over one second windows
+  uint32_t requested_fps_ = 60;
+  uint32_t window_frames_ = 0;
+  int64_t window_start_ns_ = 0;
+  float achieved_fps_ = 0.0f;
+  uint32_t frames_submitted_ = 0;
+  uint32_t frames_completed_ = 0;
+  uint32_t frames_late_ = 0;
 };
 
 }  // namespace sdm
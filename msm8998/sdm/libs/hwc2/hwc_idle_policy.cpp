@@ -0,0 +1,151 @@
+/*
+* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <utils/constants.h>
+#include <utils/debug.h>
+#include <algorithm>
+
+#include "hwc_idle_policy.h"
+
+#define __CLASS__ "HWCIdlePolicy"
+
+namespace sdm {
+
+static const int64_t kNsPerMs = 1000000LL;
+
+void HWCIdlePolicy::Init(uint32_t max_timeout_ms) {
+  max_timeout_ms_ = max_timeout_ms;
+}
+
+void HWCIdlePolicy::SetBaseTimeout(uint32_t timeout_ms) {
+  base_timeout_ms_ = timeout_ms;
+  timeout_ms_ = timeout_ms;
+  candidate_ms_ = 0;
+  candidate_updates_ = 0;
+}
+
+void HWCIdlePolicy::IdleTimeout(int64_t now_ns) {
+  idle_entry_ns_ = now_ns;
+  idle_entries_++;
+}
+
+uint32_t HWCIdlePolicy::UpdateFrame(int64_t now_ns) {
+  // Timeouts beyond the max are used to disable the idle fallback, leave them as configured
+  if (!base_timeout_ms_ || base_timeout_ms_ > max_timeout_ms_) {
+    return timeout_ms_;
+  }
+
+  if (idle_entry_ns_) {
+    if ((now_ns - idle_entry_ns_) <= (static_cast<int64_t>(max_timeout_ms_) * kNsPerMs)) {
+      early_exits_++;
+    }
+    idle_entry_ns_ = 0;
+  }
+
+  if (last_update_ns_) {
+    int64_t interval = now_ns - last_update_ns_;
+    if (interval >= kStaticIntervalNs) {
+      // Restart the window, a long pause is not part of the update cadence.
+      static_intervals_++;
+      count_ = 0;
+    } else {
+      static_intervals_ = 0;
+      intervals_[head_] = interval;
+      head_ = (head_ + 1) % kWindowSize;
+      if (count_ < kWindowSize) {
+        count_++;
+      }
+    }
+  }
+  last_update_ns_ = now_ns;
+
+  uint32_t candidate_ms = GetCandidateMs();
+  uint32_t margin_ms = (timeout_ms_ * kHysteresisPercent) / 100;
+  if ((candidate_ms + margin_ms >= timeout_ms_) && (candidate_ms <= timeout_ms_ + margin_ms)) {
+    candidate_updates_ = 0;
+    return timeout_ms_;
+  }
+
+  uint32_t candidate_margin_ms = (candidate_ms_ * kHysteresisPercent) / 100;
+  if (candidate_updates_ && (candidate_ms + candidate_margin_ms >= candidate_ms_) &&
+      (candidate_ms <= candidate_ms_ + candidate_margin_ms)) {
+    candidate_updates_++;
+  } else {
+    candidate_updates_ = 1;
+  }
+  candidate_ms_ = candidate_ms;
+
+  if (candidate_updates_ >= kHysteresisUpdates) {
+    DLOGI_IF(kTagClient, "Update interval %d ms, idle timeout %d -> %d ms", interval_ms_,
+             timeout_ms_, candidate_ms);
+    timeout_ms_ = candidate_ms;
+    candidate_updates_ = 0;
+    timeout_changes_++;
+  }
+
+  return timeout_ms_;
+}
+
+uint32_t HWCIdlePolicy::GetCandidateMs() {
+  // Isolated updates on static content, fall back quickly after each of them.
+  if (static_intervals_ >= kStaticIntervals) {
+    return std::max(base_timeout_ms_ / 2, 1U);
+  }
+
+  if (count_ < kMinIntervals) {
+    interval_ms_ = 0;
+    return base_timeout_ms_;
+  }
+
+  int64_t intervals[kWindowSize];
+  uint32_t oldest = (head_ + kWindowSize - count_) % kWindowSize;
+  for (uint32_t i = 0; i < count_; i++) {
+    intervals[i] = intervals_[(oldest + i) % kWindowSize];
+  }
+  uint32_t rank = (count_ * 9) / 10;
+  std::nth_element(intervals, intervals + rank, intervals + count_);
+  interval_ms_ = UINT32(intervals[rank] / kNsPerMs);
+
+  // Bridge the interval with some margin for scheduling jitter. Intervals too long to bridge are
+  // left to the configured timeout, the content is idle between those updates.
+  uint32_t bridge_ms = interval_ms_ + interval_ms_ / 4;
+  if (bridge_ms <= base_timeout_ms_ || bridge_ms > max_timeout_ms_) {
+    return base_timeout_ms_;
+  }
+
+  return bridge_ms;
+}
+
+void HWCIdlePolicy::Dump(std::ostringstream *os) {
+  *os << "idle policy: base_ms: " << base_timeout_ms_ << " timeout_ms: " << timeout_ms_
+      << " interval_ms: " << interval_ms_ << " idle_entries: " << idle_entries_
+      << " early_exits: " << early_exits_ << " changes: " << timeout_changes_ << std::endl;
+}
+
+}  // namespace sdm
@@ -0,0 +1,88 @@
+/*
+* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HWC_IDLE_POLICY_H__
+#define __HWC_IDLE_POLICY_H__
+
+#include <stdint.h>
+#include <sstream>
+
+namespace sdm {
+
+// Adapts the idle fallback timeout to the interval between frame updates. Content that updates a
+// little slower than the timeout, like a dashboard ticking every second, would otherwise enter and
+// leave idle fallback on every update. The timeout is lengthened to bridge such intervals and to
+// hold across bursts of interaction, and shortened while the display only sees isolated updates.
+class HWCIdlePolicy {
+ public:
+  void Init(uint32_t max_timeout_ms);
+  // Sets the configured timeout the policy adapts around. 0 disables the idle fallback,
+  // timeouts beyond the max are used as configured.
+  void SetBaseTimeout(uint32_t timeout_ms);
+  // Records a frame update at now_ns and returns the timeout to be used from now on.
+  uint32_t UpdateFrame(int64_t now_ns);
+  // Records the idle fallback being entered at now_ns.
+  void IdleTimeout(int64_t now_ns);
+  uint32_t GetTimeoutMs() const { return timeout_ms_; }
+  void Dump(std::ostringstream *os);
+
+ private:
+  static const uint32_t kWindowSize = 32;
+  // Minimum number of intervals required before the update cadence is trusted.
+  static const uint32_t kMinIntervals = 8;
+  // Number of consecutive updates a new timeout must be chosen before it is applied.
+  static const uint32_t kHysteresisUpdates = 4;
+  // Timeouts within this percentage of the current one are not worth a change.
+  static const uint32_t kHysteresisPercent = 20;
+  // Gaps this long are not a cadence. Enough of them in a row mark the content static.
+  static const int64_t kStaticIntervalNs = 5000000000LL;
+  static const uint32_t kStaticIntervals = 3;
+
+  uint32_t GetCandidateMs();
+
+  uint32_t base_timeout_ms_ = 0;
+  uint32_t max_timeout_ms_ = 0;
+  uint32_t timeout_ms_ = 0;
+  int64_t intervals_[kWindowSize] = {};
+  uint32_t head_ = 0;
+  uint32_t count_ = 0;
+  int64_t last_update_ns_ = 0;
+  int64_t idle_entry_ns_ = 0;
+  uint32_t static_intervals_ = 0;
+  uint32_t candidate_ms_ = 0;
+  uint32_t candidate_updates_ = 0;
+  uint32_t interval_ms_ = 0;     // 90th percentile of the update intervals
+  uint32_t idle_entries_ = 0;
+  uint32_t early_exits_ = 0;     // Idle entries cut short by an update within the max timeout
+  uint32_t timeout_changes_ = 0;
+};
+
+}  // namespace sdm
+
+#endif  // __HWC_IDLE_POLICY_H__
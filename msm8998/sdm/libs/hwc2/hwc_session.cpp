@@ -35,6 +35,8 @@
 #include <algorithm>
 #include <string>
 #include <bitset>
+#include <memory>
+#include <vector>
 
 #include "hwc_buffer_allocator.h"
 #include "hwc_buffer_sync_handler.h"
@@ -152,6 +154,7 @@ int HWCSession::Init() {
 int HWCSession::Deinit() {
   HWCDisplayPrimary::Destroy(hwc_display_[HWC_DISPLAY_PRIMARY]);
   hwc_display_[HWC_DISPLAY_PRIMARY] = 0;
+  ClearDisplaySnapshot(HWC_DISPLAY_PRIMARY);
   if (color_mgr_) {
     color_mgr_->DestroyColorManager();
   }
@@ -287,6 +290,7 @@ int32_t HWCSession::DestroyVirtualDisplay(hwc2_device_t *device, hwc2_display_t
   if (display < HWC_NUM_DISPLAY_TYPES && hwc_session->hwc_display_[display]) {
     HWCDisplayVirtual::Destroy(hwc_session->hwc_display_[display]);
     hwc_session->hwc_display_[display] = nullptr;
+    hwc_session->ClearDisplaySnapshot(INT(display));
     return HWC2_ERROR_NONE;
   } else {
     return HWC2_ERROR_BAD_DISPLAY;
@@ -589,6 +593,8 @@ int32_t HWCSession::ValidateDisplay(hwc2_device_t *device, hwc2_display_t displa
     return HWC2_ERROR_BAD_DISPLAY;
   }
 
+  hwc_session->ApplyPendingCommands();
+
   // TODO(user): Handle secure session, handle QDCM solid fill
   // Handle external_pending_connect_ in CreateVirtualDisplay
   auto status = HWC2::Error::BadDisplay;
@@ -610,6 +616,7 @@ int32_t HWCSession::ValidateDisplay(hwc2_device_t *device, hwc2_display_t displa
     }
 
     status = hwc_session->hwc_display_[display]->Validate(out_num_types, out_num_requests);
+    hwc_session->UpdateDisplaySnapshot(INT(display), false /* full */);
   }
   return INT32(status);
 }
@@ -766,6 +773,7 @@ int HWCSession::DisconnectDisplay(int disp) {
   }
 
   hwc_display_[disp] = NULL;
+  ClearDisplaySnapshot(disp);
 
   return 0;
 }
@@ -773,30 +781,30 @@ int HWCSession::DisconnectDisplay(int disp) {
 // Qclient methods
 android::status_t HWCSession::notifyCallback(uint32_t command, const android::Parcel *input_parcel,
                                              android::Parcel *output_parcel) {
+  android::status_t status = 0;
+
+  // Queries are answered from the display snapshots and commands without a result are applied on
+  // the next frame, neither of them waits for locker_ behind Validate.
+  if (HandleSnapshotQuery(command, input_parcel, output_parcel, &status)) {
+    return status;
+  }
+
+  if (QueueCommand(command, input_parcel)) {
+    return 0;
+  }
+
+  int snapshot_dpy = GetCommandDisplay(command, input_parcel);
+
   SEQUENCE_WAIT_SCOPE_LOCK(locker_);
 
-  android::status_t status = 0;
+  // Keep queued commands ordered ahead of this one
+  ApplyPendingCommands();
 
   switch (command) {
-    case qService::IQService::DYNAMIC_DEBUG:
-      DynamicDebug(input_parcel);
-      break;
-
     case qService::IQService::SCREEN_REFRESH:
       callbacks_.Refresh(HWC_DISPLAY_PRIMARY);
       break;
 
-    case qService::IQService::SET_IDLE_TIMEOUT:
-      if (hwc_display_[HWC_DISPLAY_PRIMARY]) {
-        uint32_t timeout = UINT32(input_parcel->readInt32());
-        hwc_display_[HWC_DISPLAY_PRIMARY]->SetIdleTimeoutMs(timeout);
-      }
-      break;
-
-    case qService::IQService::SET_FRAME_DUMP_CONFIG:
-      SetFrameDumpConfig(input_parcel);
-      break;
-
     case qService::IQService::SET_MAX_PIPES_PER_MIXER:
       status = SetMaxMixerStages(input_parcel);
       break;
@@ -885,9 +893,248 @@ android::status_t HWCSession::notifyCallback(uint32_t command, const android::Pa
       return -EINVAL;
   }
 
+  // Display objects and active configs are also tracked per frame, this only catches changes
+  // which show up without a new frame.
+  if (snapshot_dpy >= HWC_DISPLAY_PRIMARY && snapshot_dpy < HWC_NUM_DISPLAY_TYPES) {
+    UpdateDisplaySnapshot(snapshot_dpy, true /* full */);
+  }
+
   return status;
 }
 
+bool HWCSession::HandleSnapshotQuery(uint32_t command, const android::Parcel *input_parcel,
+                                     android::Parcel *output_parcel, android::status_t *status) {
+  size_t data_position = input_parcel->dataPosition();
+  std::shared_ptr<const DisplaySnapshot> snapshot;
+  bool handled = false;
+
+  switch (command) {
+    case qService::IQService::GET_ACTIVE_CONFIG: {
+        int dpy = input_parcel->readInt32();
+        if (dpy >= HWC_DISPLAY_PRIMARY && dpy < HWC_NUM_DISPLAY_TYPES) {
+          snapshot = std::atomic_load(&display_snapshot_[dpy]);
+        }
+        if (snapshot) {
+          if (snapshot->active_config_error == 0) {
+            output_parcel->writeInt32(INT(snapshot->active_config));
+          }
+          *status = snapshot->active_config_error;
+          handled = true;
+        }
+      }
+      break;
+
+    case qService::IQService::GET_CONFIG_COUNT: {
+        int dpy = input_parcel->readInt32();
+        if (dpy >= HWC_DISPLAY_PRIMARY && dpy < HWC_NUM_DISPLAY_TYPES) {
+          snapshot = std::atomic_load(&display_snapshot_[dpy]);
+        }
+        if (snapshot) {
+          if (snapshot->config_count_error == 0) {
+            output_parcel->writeInt32(INT(snapshot->config_count));
+          }
+          *status = snapshot->config_count_error;
+          handled = true;
+        }
+      }
+      break;
+
+    case qService::IQService::GET_DISPLAY_ATTRIBUTES_FOR_CONFIG: {
+        int config = input_parcel->readInt32();
+        int dpy = input_parcel->readInt32();
+        if (dpy >= HWC_DISPLAY_PRIMARY && dpy < HWC_NUM_DISPLAY_TYPES) {
+          snapshot = std::atomic_load(&display_snapshot_[dpy]);
+        }
+        // Configs missing from the snapshot are left to the locked path to report the error
+        if (snapshot && config >= 0 && UINT32(config) < snapshot->configs.size()) {
+          auto &display_attributes = snapshot->configs.at(UINT32(config));
+          output_parcel->writeInt32(INT(display_attributes.vsync_period_ns));
+          output_parcel->writeInt32(INT(display_attributes.x_pixels));
+          output_parcel->writeInt32(INT(display_attributes.y_pixels));
+          output_parcel->writeFloat(display_attributes.x_dpi);
+          output_parcel->writeFloat(display_attributes.y_dpi);
+          output_parcel->writeInt32(0);  // Panel type, unsupported.
+          *status = 0;
+          handled = true;
+        }
+      }
+      break;
+
+    case qService::IQService::GET_DISPLAY_VISIBLE_REGION: {
+        int dpy = input_parcel->readInt32();
+        if (dpy >= HWC_DISPLAY_PRIMARY && dpy < HWC_NUM_DISPLAY_TYPES) {
+          snapshot = std::atomic_load(&display_snapshot_[dpy]);
+        }
+        if (snapshot) {
+          *status = snapshot->visible_rect_error;
+          if (snapshot->visible_rect_error >= 0) {
+            output_parcel->writeInt32(snapshot->visible_rect.left);
+            output_parcel->writeInt32(snapshot->visible_rect.top);
+            output_parcel->writeInt32(snapshot->visible_rect.right);
+            output_parcel->writeInt32(snapshot->visible_rect.bottom);
+            *status = android::NO_ERROR;
+          }
+          handled = true;
+        }
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  if (!handled) {
+    input_parcel->setDataPosition(data_position);
+  }
+
+  return handled;
+}
+
+bool HWCSession::QueueCommand(uint32_t command, const android::Parcel *input_parcel) {
+  std::function<void()> apply;
+
+  switch (command) {
+    case qService::IQService::DYNAMIC_DEBUG: {
+        // Only touches the process wide log levels, applied right away
+        int type = input_parcel->readInt32();
+        bool enable = (input_parcel->readInt32() > 0);
+        int verbose_level = input_parcel->readInt32();
+        DynamicDebug(type, enable, verbose_level);
+      }
+      return true;
+
+    case qService::IQService::SET_IDLE_TIMEOUT: {
+        uint32_t timeout = UINT32(input_parcel->readInt32());
+        apply = [this, timeout]() {
+          if (hwc_display_[HWC_DISPLAY_PRIMARY]) {
+            hwc_display_[HWC_DISPLAY_PRIMARY]->SetIdleTimeoutMs(timeout);
+          }
+        };
+      }
+      break;
+
+    case qService::IQService::SET_FRAME_DUMP_CONFIG: {
+        uint32_t frame_dump_count = UINT32(input_parcel->readInt32());
+        std::bitset<32> bit_mask_display_type = UINT32(input_parcel->readInt32());
+        uint32_t bit_mask_layer_type = UINT32(input_parcel->readInt32());
+        apply = [this, frame_dump_count, bit_mask_display_type, bit_mask_layer_type]() {
+          SetFrameDumpConfig(frame_dump_count, bit_mask_display_type, bit_mask_layer_type);
+        };
+      }
+      break;
+
+    default:
+      return false;
+  }
+
+  {
+    SCOPE_LOCK(command_locker_);
+    pending_commands_.push_back(apply);
+  }
+
+  // Have the command applied on a static screen too
+  callbacks_.Refresh(HWC_DISPLAY_PRIMARY);
+
+  return true;
+}
+
+void HWCSession::ApplyPendingCommands() {
+  std::vector<std::function<void()>> commands;
+
+  {
+    SCOPE_LOCK(command_locker_);
+    commands.swap(pending_commands_);
+  }
+
+  for (auto &command : commands) {
+    command();
+  }
+}
+
+void HWCSession::UpdateDisplaySnapshot(int disp, bool full) {
+  HWCDisplay *hwc_display = hwc_display_[disp];
+  if (!hwc_display) {
+    ClearDisplaySnapshot(disp);
+    return;
+  }
+
+  std::shared_ptr<const DisplaySnapshot> current = std::atomic_load(&display_snapshot_[disp]);
+  uint32_t active_config = 0;
+  int active_config_error = hwc_display->GetActiveDisplayConfig(&active_config);
+  hwc_rect_t visible_rect = {0, 0, 0, 0};
+  int visible_rect_error = hwc_display->GetVisibleDisplayRect(&visible_rect);
+
+  std::shared_ptr<DisplaySnapshot> snapshot;
+  if (!full && current && current->display == hwc_display &&
+      current->active_config_error == active_config_error &&
+      current->active_config == active_config) {
+    // Per frame only the visible rect can change, publish a new snapshot only when it does
+    if (current->visible_rect_error == visible_rect_error &&
+        current->visible_rect.left == visible_rect.left &&
+        current->visible_rect.top == visible_rect.top &&
+        current->visible_rect.right == visible_rect.right &&
+        current->visible_rect.bottom == visible_rect.bottom) {
+      return;
+    }
+    snapshot = std::make_shared<DisplaySnapshot>(*current);
+  } else {
+    snapshot = std::make_shared<DisplaySnapshot>();
+    snapshot->display = hwc_display;
+    snapshot->config_count_error = hwc_display->GetDisplayConfigCount(&snapshot->config_count);
+    if (snapshot->config_count_error == 0) {
+      for (uint32_t i = 0; i < snapshot->config_count; i++) {
+        DisplayConfigVariableInfo display_attributes;
+        if (hwc_display->GetDisplayAttributesForConfig(INT(i), &display_attributes) != 0) {
+          break;
+        }
+        snapshot->configs.push_back(display_attributes);
+      }
+    }
+  }
+
+  snapshot->active_config_error = active_config_error;
+  snapshot->active_config = active_config;
+  snapshot->visible_rect_error = visible_rect_error;
+  snapshot->visible_rect = visible_rect;
+
+  std::atomic_store(&display_snapshot_[disp], std::shared_ptr<const DisplaySnapshot>(snapshot));
+}
+
+int HWCSession::GetCommandDisplay(uint32_t command, const android::Parcel *input_parcel) {
+  size_t data_position = input_parcel->dataPosition();
+  int dpy = -1;
+
+  switch (command) {
+    case qService::IQService::SET_ACTIVE_CONFIG:
+      input_parcel->readInt32();  // config
+      dpy = input_parcel->readInt32();
+      break;
+
+    case qService::IQService::SET_SECONDARY_DISPLAY_STATUS:
+      dpy = input_parcel->readInt32();
+      break;
+
+    case qService::IQService::SET_DISPLAY_MODE:
+    case qService::IQService::CONFIGURE_DYN_REFRESH_RATE:
+    case qService::IQService::SET_LAYER_MIXER_RESOLUTION:
+    case qService::IQService::QDCM_SVC_CMDS:
+      dpy = HWC_DISPLAY_PRIMARY;
+      break;
+
+    default:
+      // Queries and commands which don't change what the snapshots report
+      break;
+  }
+
+  input_parcel->setDataPosition(data_position);
+
+  return dpy;
+}
+
+void HWCSession::ClearDisplaySnapshot(int disp) {
+  std::atomic_store(&display_snapshot_[disp], std::shared_ptr<const DisplaySnapshot>());
+}
+
 android::status_t HWCSession::ToggleScreenUpdates(const android::Parcel *input_parcel,
                                                   android::Parcel *output_parcel) {
   int input = input_parcel->readInt32();
@@ -1049,7 +1296,6 @@ android::status_t HWCSession::HandleGetDisplayConfigCount(const android::Parcel
 android::status_t HWCSession::HandleGetDisplayAttributesForConfig(const android::Parcel
                                                                   *input_parcel,
                                                                   android::Parcel *output_parcel) {
-  SCOPE_LOCK(locker_);
   int config = input_parcel->readInt32();
   int dpy = input_parcel->readInt32();
   int error = android::BAD_VALUE;
@@ -1121,13 +1367,11 @@ android::status_t HWCSession::ConfigureRefreshRate(const android::Parcel *input_
 }
 
 android::status_t HWCSession::SetDisplayMode(const android::Parcel *input_parcel) {
-  SCOPE_LOCK(locker_);
   uint32_t mode = UINT32(input_parcel->readInt32());
   return hwc_display_[HWC_DISPLAY_PRIMARY]->Perform(HWCDisplayPrimary::SET_DISPLAY_MODE, mode);
 }
 
 android::status_t HWCSession::SetMaxMixerStages(const android::Parcel *input_parcel) {
-  SCOPE_LOCK(locker_);
   DisplayError error = kErrorNone;
   std::bitset<32> bit_mask_display_type = UINT32(input_parcel->readInt32());
   uint32_t max_mixer_stages = UINT32(input_parcel->readInt32());
@@ -1196,11 +1440,9 @@ android::status_t HWCSession::GetBWTransactionStatus(const android::Parcel *inpu
   return 0;
 }
 
-void HWCSession::SetFrameDumpConfig(const android::Parcel *input_parcel) {
-  uint32_t frame_dump_count = UINT32(input_parcel->readInt32());
-  std::bitset<32> bit_mask_display_type = UINT32(input_parcel->readInt32());
-  uint32_t bit_mask_layer_type = UINT32(input_parcel->readInt32());
-
+void HWCSession::SetFrameDumpConfig(uint32_t frame_dump_count,
+                                    std::bitset<32> bit_mask_display_type,
+                                    uint32_t bit_mask_layer_type) {
   if (bit_mask_display_type[HWC_DISPLAY_PRIMARY]) {
     if (hwc_display_[HWC_DISPLAY_PRIMARY]) {
       hwc_display_[HWC_DISPLAY_PRIMARY]->SetFrameDumpConfig(frame_dump_count, bit_mask_layer_type);
@@ -1221,7 +1463,6 @@ void HWCSession::SetFrameDumpConfig(const android::Parcel *input_parcel) {
 }
 
 android::status_t HWCSession::SetMixerResolution(const android::Parcel *input_parcel) {
-  SCOPE_LOCK(locker_);
   DisplayError error = kErrorNone;
   uint32_t dpy = UINT32(input_parcel->readInt32());
 
@@ -1276,11 +1517,8 @@ android::status_t HWCSession::SetColorModeById(const android::Parcel *input_parc
   return 0;
 }
 
-void HWCSession::DynamicDebug(const android::Parcel *input_parcel) {
-  int type = input_parcel->readInt32();
-  bool enable = (input_parcel->readInt32() > 0);
+void HWCSession::DynamicDebug(int type, bool enable, int verbose_level) {
   DLOGI("type = %d enable = %d", type, enable);
-  int verbose_level = input_parcel->readInt32();
 
   switch (type) {
     case qService::IQService::DEBUG_ALL:
@@ -1618,7 +1856,6 @@ int HWCSession::GetVsyncPeriod(int disp) {
 
 android::status_t HWCSession::GetVisibleDisplayRect(const android::Parcel *input_parcel,
                                                     android::Parcel *output_parcel) {
-  SCOPE_LOCK(locker_);
   int dpy = input_parcel->readInt32();
 
   if (dpy < HWC_DISPLAY_PRIMARY || dpy >= HWC_NUM_DISPLAY_TYPES) {
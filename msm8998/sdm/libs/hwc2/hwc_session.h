@@ -23,6 +23,11 @@
 #include <core/core_interface.h>
 #include <utils/locker.h>
 
+#include <bitset>
+#include <functional>
+#include <memory>
+#include <vector>
+
 #include "hwc_callbacks.h"
 #include "hwc_layers.h"
 #include "hwc_display.h"
@@ -115,6 +120,19 @@ class HWCSession : hwc2_device_t, public qClient::BnQClient {
   static const int kExternalConnectionTimeoutMs = 500;
   static const int kPartialUpdateControlTimeoutMs = 100;
 
+  // What the QService queries report for a display. Rebuilt with locker_ held and published as a
+  // new immutable object, so that binder threads can answer queries without taking locker_.
+  struct DisplaySnapshot {
+    const HWCDisplay *display = NULL;  // Only compared, never dereferenced
+    int active_config_error = -1;
+    uint32_t active_config = 0;
+    int config_count_error = -1;
+    uint32_t config_count = 0;
+    std::vector<DisplayConfigVariableInfo> configs;
+    int visible_rect_error = -EINVAL;
+    hwc_rect_t visible_rect = {0, 0, 0, 0};
+  };
+
   // hwc methods
   static int Open(const hw_module_t *module, const char *name, hw_device_t **device);
   static int Close(hw_device_t *device);
@@ -135,8 +153,9 @@ class HWCSession : hwc2_device_t, public qClient::BnQClient {
   // QClient methods
   virtual android::status_t notifyCallback(uint32_t command, const android::Parcel *input_parcel,
                                            android::Parcel *output_parcel);
-  void DynamicDebug(const android::Parcel *input_parcel);
-  void SetFrameDumpConfig(const android::Parcel *input_parcel);
+  void DynamicDebug(int type, bool enable, int verbose_level);
+  void SetFrameDumpConfig(uint32_t frame_dump_count, std::bitset<32> bit_mask_display_type,
+                          uint32_t bit_mask_layer_type);
   android::status_t SetMaxMixerStages(const android::Parcel *input_parcel);
   android::status_t SetDisplayMode(const android::Parcel *input_parcel);
   android::status_t SetSecondaryDisplayStatus(const android::Parcel *input_parcel,
@@ -175,6 +194,14 @@ class HWCSession : hwc2_device_t, public qClient::BnQClient {
 
   android::status_t SetColorModeById(const android::Parcel *input_parcel);
 
+  bool HandleSnapshotQuery(uint32_t command, const android::Parcel *input_parcel,
+                           android::Parcel *output_parcel, android::status_t *status);
+  bool QueueCommand(uint32_t command, const android::Parcel *input_parcel);
+  void ApplyPendingCommands();
+  void UpdateDisplaySnapshot(int disp, bool full);
+  int GetCommandDisplay(uint32_t command, const android::Parcel *input_parcel);
+  void ClearDisplaySnapshot(int disp);
+
   static Locker locker_;
   CoreInterface *core_intf_ = NULL;
   HWCDisplay *hwc_display_[HWC_NUM_DISPLAY_TYPES] = {NULL};
@@ -193,6 +220,10 @@ class HWCSession : hwc2_device_t, public qClient::BnQClient {
   int bw_mode_release_fd_ = -1;
   qService::QService *qservice_ = NULL;
   HWCSocketHandler socket_handler_;
+  // Accessed through std::atomic_load and std::atomic_store only
+  std::shared_ptr<const DisplaySnapshot> display_snapshot_[HWC_NUM_DISPLAY_TYPES];
+  Locker command_locker_;
+  std::vector<std::function<void()>> pending_commands_;  // Applied with locker_ held
 };
 
 }  // namespace sdm
@@ -181,6 +181,13 @@ bool Debug::IsSkipValidateDisabled() {
   return (value == 1);
 }
 
+bool Debug::IsSWVSyncDisabled() {
+  int value = 0;
+  debug_.debug_handler_->GetProperty("sdm.debug.disable_sw_vsync", &value);
+
+  return (value == 1);
+}
+
 DisplayError Debug::GetMixerResolution(uint32_t *width, uint32_t *height) {
   char value[64] = {};
 
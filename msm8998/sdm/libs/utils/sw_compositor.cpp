@@ -0,0 +1,757 @@
+/*
+* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*  * Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*    copyright notice, this list of conditions and the following
+*    disclaimer in the documentation and/or other materials provided
+*    with the distribution.
+*  * Neither the name of The Linux Foundation nor the names of its
+*    contributors may be used to endorse or promote products derived
+*    from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <utils/constants.h>
+#include <utils/debug.h>
+#include <utils/formats.h>
+#include <utils/sw_compositor.h>
+#include <algorithm>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SW_COMPOSITOR_NEON
+#endif
+
+#define __CLASS__ "SWCompositor"
+
+namespace sdm {
+
+// Packed RGB pixel, read as a little endian word of 'bytes' bytes. Channels are listed in R, G,
+// B, A order, and a channel with 0 bits reads as fully opaque.
+struct SWPackedLayout {
+  uint32_t bytes;
+  uint32_t shift[4];
+  uint32_t bits[4];
+};
+
+static const SWPackedLayout kLayoutRGBA8888 = { 4, { 0, 8, 16, 24 }, { 8, 8, 8, 8 } };
+static const SWPackedLayout kLayoutRGBX8888 = { 4, { 0, 8, 16, 24 }, { 8, 8, 8, 0 } };
+static const SWPackedLayout kLayoutBGRA8888 = { 4, { 16, 8, 0, 24 }, { 8, 8, 8, 8 } };
+static const SWPackedLayout kLayoutBGRX8888 = { 4, { 16, 8, 0, 24 }, { 8, 8, 8, 0 } };
+static const SWPackedLayout kLayoutARGB8888 = { 4, { 8, 16, 24, 0 }, { 8, 8, 8, 8 } };
+static const SWPackedLayout kLayoutXRGB8888 = { 4, { 8, 16, 24, 0 }, { 8, 8, 8, 0 } };
+static const SWPackedLayout kLayoutRGB888 = { 3, { 0, 8, 16, 0 }, { 8, 8, 8, 0 } };
+static const SWPackedLayout kLayoutBGR888 = { 3, { 16, 8, 0, 0 }, { 8, 8, 8, 0 } };
+static const SWPackedLayout kLayoutRGB565 = { 2, { 11, 5, 0, 0 }, { 5, 6, 5, 0 } };
+static const SWPackedLayout kLayoutBGR565 = { 2, { 0, 5, 11, 0 }, { 5, 6, 5, 0 } };
+static const SWPackedLayout kLayoutRGBA5551 = { 2, { 11, 6, 1, 0 }, { 5, 5, 5, 1 } };
+static const SWPackedLayout kLayoutRGBA4444 = { 2, { 12, 8, 4, 0 }, { 4, 4, 4, 4 } };
+static const SWPackedLayout kLayoutRGBA1010102 = { 4, { 0, 10, 20, 30 }, { 10, 10, 10, 2 } };
+static const SWPackedLayout kLayoutRGBX1010102 = { 4, { 0, 10, 20, 30 }, { 10, 10, 10, 0 } };
+static const SWPackedLayout kLayoutBGRA1010102 = { 4, { 20, 10, 0, 30 }, { 10, 10, 10, 2 } };
+static const SWPackedLayout kLayoutBGRX1010102 = { 4, { 20, 10, 0, 30 }, { 10, 10, 10, 0 } };
+static const SWPackedLayout kLayoutARGB2101010 = { 4, { 2, 12, 22, 0 }, { 10, 10, 10, 2 } };
+static const SWPackedLayout kLayoutXRGB2101010 = { 4, { 2, 12, 22, 0 }, { 10, 10, 10, 0 } };
+static const SWPackedLayout kLayoutABGR2101010 = { 4, { 22, 12, 2, 0 }, { 10, 10, 10, 2 } };
+static const SWPackedLayout kLayoutXBGR2101010 = { 4, { 22, 12, 2, 0 }, { 10, 10, 10, 0 } };
+
+static const SWPackedLayout *GetPackedLayout(LayerBufferFormat format) {
+  switch (format) {
+  case kFormatRGBA8888:     return &kLayoutRGBA8888;
+  case kFormatRGBX8888:     return &kLayoutRGBX8888;
+  case kFormatBGRA8888:     return &kLayoutBGRA8888;
+  case kFormatBGRX8888:     return &kLayoutBGRX8888;
+  case kFormatARGB8888:     return &kLayoutARGB8888;
+  case kFormatXRGB8888:     return &kLayoutXRGB8888;
+  case kFormatRGB888:       return &kLayoutRGB888;
+  case kFormatBGR888:       return &kLayoutBGR888;
+  case kFormatRGB565:       return &kLayoutRGB565;
+  case kFormatBGR565:       return &kLayoutBGR565;
+  case kFormatRGBA5551:     return &kLayoutRGBA5551;
+  case kFormatRGBA4444:     return &kLayoutRGBA4444;
+  case kFormatRGBA1010102:  return &kLayoutRGBA1010102;
+  case kFormatRGBX1010102:  return &kLayoutRGBX1010102;
+  case kFormatBGRA1010102:  return &kLayoutBGRA1010102;
+  case kFormatBGRX1010102:  return &kLayoutBGRX1010102;
+  case kFormatARGB2101010:  return &kLayoutARGB2101010;
+  case kFormatXRGB2101010:  return &kLayoutXRGB2101010;
+  case kFormatABGR2101010:  return &kLayoutABGR2101010;
+  case kFormatXBGR2101010:  return &kLayoutXBGR2101010;
+  default:                  return nullptr;
+  }
+}
+
+// Integer YCbCr to RGB matrices scaled by 256: luma gain, luma offset, Cr->R, Cb->G, Cr->G, Cb->B
+static const int32_t kBT601Limited[6] = { 298, 16, 409, -100, -208, 516 };
+static const int32_t kBT601Full[6] = { 256, 0, 359, -88, -183, 454 };
+static const int32_t kBT709Limited[6] = { 298, 16, 459, -55, -136, 541 };
+static const int32_t kBT709Full[6] = { 256, 0, 403, -48, -120, 475 };
+
+struct SWPlanes {
+  const uint8_t *plane[3] = {};  // RGB or luma, chroma (CbCr or Cb), Cr for 3 plane formats
+  uint32_t stride[3] = {};       // Bytes
+  uint32_t chroma_shift_x = 0;
+  uint32_t chroma_shift_y = 0;
+  bool swap_uv = false;
+  const SWPackedLayout *layout = nullptr;
+  const int32_t *yuv_matrix = nullptr;
+};
+
+// Reads the raw RGBA8 value of pixel (x, y), without applying any blending
+typedef void (*SWFetchPixel)(const SWPlanes &planes, int32_t x, int32_t y, uint8_t *rgba);
+
+struct SWSource {
+  SWPlanes planes;
+  SWFetchPixel fetch = nullptr;
+  bool solid_fill = false;
+  uint8_t color[4] = {};
+  LayerBlending blending = kBlendingPremultiplied;
+  uint8_t plane_alpha = 0xff;
+  // Output pixels covered by the layer, clipped to the output, end exclusive
+  int32_t dst_left = 0, dst_top = 0, dst_right = 0, dst_bottom = 0;
+  // Source pixels that taps may read, end inclusive
+  int32_t src_left = 0, src_top = 0, src_right = 0, src_bottom = 0;
+  // Source position of the centre of output pixel (x, y) along axis a is
+  // origin[a] + x * step_x[a] + y * step_y[a]
+  double origin[2] = {}, step_x[2] = {}, step_y[2] = {};
+};
+
+struct SWComposeJob {
+  std::vector<SWSource> sources;
+  uint8_t *output = nullptr;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t stride = 0;
+  const SWPackedLayout *layout = nullptr;
+};
+
+static inline uint8_t Mul255(uint32_t a, uint32_t b) {
+  uint32_t t = a * b + 128;
+  return UINT8((t + (t >> 8)) >> 8);
+}
+
+static inline uint8_t Expand(uint32_t value, uint32_t bits) {
+  if (bits == 8) {
+    return UINT8(value);
+  }
+  uint32_t max = (1u << bits) - 1;
+  return UINT8((value * 255 + (max >> 1)) / max);
+}
+
+static inline uint32_t Reduce(uint8_t value, uint32_t bits) {
+  if (bits == 8) {
+    return value;
+  }
+  uint32_t max = (1u << bits) - 1;
+  return (value * max + 127) / 255;
+}
+
+static inline uint8_t Clamp8(int32_t value) {
+  return UINT8(std::min(std::max(value, 0), 255));
+}
+
+static void FetchPacked(const SWPlanes &planes, int32_t x, int32_t y, uint8_t *rgba) {
+  const SWPackedLayout &layout = *planes.layout;
+  const uint8_t *pixel = planes.plane[0] + UINT32(y) * planes.stride[0] + UINT32(x) * layout.bytes;
+  uint32_t word = 0;
+  for (uint32_t i = 0; i < layout.bytes; i++) {
+    word |= UINT32(pixel[i]) << (8 * i);
+  }
+  for (uint32_t c = 0; c < 4; c++) {
+    uint32_t bits = layout.bits[c];
+    rgba[c] = bits ? Expand((word >> layout.shift[c]) & ((1u << bits) - 1), bits) : 0xff;
+  }
+}
+
+static void FetchRGBA8888(const SWPlanes &planes, int32_t x, int32_t y, uint8_t *rgba) {
+  memcpy(rgba, planes.plane[0] + UINT32(y) * planes.stride[0] + UINT32(x) * 4, 4);
+}
+
+static inline void YUVToRGB(const int32_t *matrix, int32_t y, int32_t u, int32_t v,
+                            uint8_t *rgba) {
+  int32_t luma = matrix[0] * (y - matrix[1]) + 128;
+  u -= 128;
+  v -= 128;
+  rgba[0] = Clamp8((luma + matrix[2] * v) >> 8);
+  rgba[1] = Clamp8((luma + matrix[3] * u + matrix[4] * v) >> 8);
+  rgba[2] = Clamp8((luma + matrix[5] * u) >> 8);
+  rgba[3] = 0xff;
+}
+
+static void FetchSemiPlanar(const SWPlanes &planes, int32_t x, int32_t y, uint8_t *rgba) {
+  int32_t luma = planes.plane[0][UINT32(y) * planes.stride[0] + UINT32(x)];
+  const uint8_t *chroma = planes.plane[1] + (UINT32(y) >> planes.chroma_shift_y) *
+                          planes.stride[1] + (UINT32(x) >> planes.chroma_shift_x) * 2;
+  int32_t u = chroma[planes.swap_uv ? 1 : 0];
+  int32_t v = chroma[planes.swap_uv ? 0 : 1];
+  YUVToRGB(planes.yuv_matrix, luma, u, v, rgba);
+}
+
+static void FetchPlanar(const SWPlanes &planes, int32_t x, int32_t y, uint8_t *rgba) {
+  int32_t luma = planes.plane[0][UINT32(y) * planes.stride[0] + UINT32(x)];
+  uint32_t offset = (UINT32(y) >> 1) * planes.stride[1] + (UINT32(x) >> 1);
+  YUVToRGB(planes.yuv_matrix, luma, planes.plane[1][offset], planes.plane[2][offset], rgba);
+}
+
+static void FetchPacked422(const SWPlanes &planes, int32_t x, int32_t y, uint8_t *rgba) {
+  // YCbYCr, or CbYCrY when swap_uv is set
+  const uint8_t *pair = planes.plane[0] + UINT32(y) * planes.stride[0] + (UINT32(x) & ~1u) * 2;
+  uint32_t luma_index = planes.swap_uv ? 1 : 0;
+  uint32_t chroma_index = planes.swap_uv ? 0 : 1;
+  YUVToRGB(planes.yuv_matrix, pair[luma_index + (UINT32(x) & 1) * 2], pair[chroma_index],
+           pair[chroma_index + 2], rgba);
+}
+
+static void FetchP010(const SWPlanes &planes, int32_t x, int32_t y, uint8_t *rgba) {
+  // 16 bit samples with the value in the upper bits, of which the top 8 are used
+  const uint8_t *luma = planes.plane[0] + UINT32(y) * planes.stride[0] + UINT32(x) * 2;
+  const uint8_t *chroma = planes.plane[1] + (UINT32(y) >> 1) * planes.stride[1] +
+                          (UINT32(x) >> 1) * 4;
+  YUVToRGB(planes.yuv_matrix, luma[1], chroma[1], chroma[3], rgba);
+}
+
+static const int32_t *GetYUVMatrix(const ColorMetaData &color_metadata) {
+  bool full_range = (color_metadata.range == Range_Full);
+  if (color_metadata.colorPrimaries == ColorPrimaries_BT709_5) {
+    return full_range ? kBT709Full : kBT709Limited;
+  }
+  return full_range ? kBT601Full : kBT601Limited;
+}
+
+// The client describes buffers by their aligned width in pixels, either as the plane stride or
+// as the buffer width, and places the chroma planes right after the aligned luma plane.
+static bool GetPlanes(const LayerBuffer &buffer, const uint8_t *base, SWPlanes *planes,
+                      SWFetchPixel *fetch) {
+  if (GetBufferLayout(buffer.format) != kLinear) {
+    return false;
+  }
+
+  uint32_t stride = buffer.planes[0].stride ? buffer.planes[0].stride : buffer.width;
+  const uint8_t *luma = base + buffer.planes[0].offset;
+  uint32_t luma_size = stride * buffer.height;
+
+  planes->plane[0] = luma;
+  planes->yuv_matrix = GetYUVMatrix(buffer.color_metadata);
+
+  const SWPackedLayout *layout = GetPackedLayout(buffer.format);
+  if (layout) {
+    planes->layout = layout;
+    planes->stride[0] = stride * layout->bytes;
+    *fetch = (layout == &kLayoutRGBA8888) ? FetchRGBA8888 : FetchPacked;
+    return true;
+  }
+
+  switch (buffer.format) {
+  case kFormatYCbCr420SemiPlanar:
+  case kFormatYCbCr420SemiPlanarVenus:
+  case kFormatYCrCb420SemiPlanar:
+  case kFormatYCrCb420SemiPlanarVenus:
+  case kFormatYCbCr422H2V1SemiPlanar:
+  case kFormatYCrCb422H2V1SemiPlanar:
+  case kFormatYCbCr422H1V2SemiPlanar:
+  case kFormatYCrCb422H1V2SemiPlanar:
+    planes->stride[0] = stride;
+    planes->plane[1] = luma + luma_size;
+    planes->stride[1] = stride;
+    planes->chroma_shift_x = 1;
+    planes->chroma_shift_y = 1;
+    if (buffer.format == kFormatYCbCr422H2V1SemiPlanar ||
+        buffer.format == kFormatYCrCb422H2V1SemiPlanar) {
+      planes->chroma_shift_y = 0;
+    } else if (buffer.format == kFormatYCbCr422H1V2SemiPlanar ||
+               buffer.format == kFormatYCrCb422H1V2SemiPlanar) {
+      planes->chroma_shift_x = 0;
+      planes->stride[1] = stride * 2;
+    }
+    planes->swap_uv = (buffer.format == kFormatYCrCb420SemiPlanar ||
+                       buffer.format == kFormatYCrCb420SemiPlanarVenus ||
+                       buffer.format == kFormatYCrCb422H2V1SemiPlanar ||
+                       buffer.format == kFormatYCrCb422H1V2SemiPlanar);
+    *fetch = FetchSemiPlanar;
+    return true;
+
+  case kFormatYCbCr420Planar:
+  case kFormatYCrCb420Planar:
+  case kFormatYCrCb420PlanarStride16: {
+    uint32_t chroma_stride = CeilToMultipleOf(stride / 2, 16u);
+    const uint8_t *first = luma + luma_size;
+    const uint8_t *second = first + chroma_stride * (buffer.height / 2);
+    bool cb_first = (buffer.format == kFormatYCbCr420Planar);
+    planes->stride[0] = stride;
+    planes->plane[1] = cb_first ? first : second;
+    planes->plane[2] = cb_first ? second : first;
+    planes->stride[1] = chroma_stride;
+    planes->stride[2] = chroma_stride;
+    *fetch = FetchPlanar;
+    return true;
+  }
+
+  case kFormatYCbCr422H2V1Packed:
+  case kFormatCbYCrY422H2V1Packed:
+    planes->stride[0] = stride * 2;
+    planes->swap_uv = (buffer.format == kFormatCbYCrY422H2V1Packed);
+    *fetch = FetchPacked422;
+    return true;
+
+  case kFormatYCbCr420P010:
+    planes->stride[0] = stride * 2;
+    planes->plane[1] = luma + luma_size * 2;
+    planes->stride[1] = stride * 2;
+    *fetch = FetchP010;
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+static inline void Bilinear(const uint8_t *p00, const uint8_t *p01, const uint8_t *p10,
+                            const uint8_t *p11, uint32_t wx, uint32_t wy, uint8_t *out) {
+  for (uint32_t c = 0; c < 4; c++) {
+    uint32_t top = p00[c] * (256 - wx) + p01[c] * wx;
+    uint32_t bottom = p10[c] * (256 - wx) + p11[c] * wx;
+    out[c] = UINT8((top * (256 - wy) + bottom * wy + 32768) >> 16);
+  }
+}
+
+// Writes the raw source values seen by output pixels [x, x + count) of row y
+static void FetchSpan(const SWSource &source, int32_t x, int32_t y, int32_t count, uint8_t *out) {
+  if (source.solid_fill) {
+    for (int32_t i = 0; i < count; i++) {
+      memcpy(out + 4 * i, source.color, 4);
+    }
+    return;
+  }
+
+  int64_t fx = llround((source.origin[0] + x * source.step_x[0] + y * source.step_y[0]) * 65536);
+  int64_t fy = llround((source.origin[1] + x * source.step_x[1] + y * source.step_y[1]) * 65536);
+  int64_t dfx = llround(source.step_x[0] * 65536);
+  int64_t dfy = llround(source.step_x[1] * 65536);
+  const SWPlanes &planes = source.planes;
+
+  // Unscaled and untransformed spans sample whole pixels, so each output reads a single tap
+  if (dfx == 65536 && dfy == 0 && !(fx & 0xffff) && !(fy & 0xffff)) {
+    int32_t sx = INT32(fx >> 16);
+    int32_t sy = std::min(std::max(INT32(fy >> 16), source.src_top), source.src_bottom);
+    if (source.fetch == FetchRGBA8888 && sx >= source.src_left &&
+        sx + count - 1 <= source.src_right) {
+      memcpy(out, planes.plane[0] + UINT32(sy) * planes.stride[0] + UINT32(sx) * 4,
+             UINT32(count) * 4);
+      return;
+    }
+    for (int32_t i = 0; i < count; i++) {
+      int32_t cx = std::min(std::max(sx + i, source.src_left), source.src_right);
+      source.fetch(planes, cx, sy, out + 4 * i);
+    }
+    return;
+  }
+
+  uint8_t taps[4][4];
+  for (int32_t i = 0; i < count; i++, fx += dfx, fy += dfy) {
+    int32_t sx = INT32(fx >> 16);
+    int32_t sy = INT32(fy >> 16);
+    uint32_t wx = UINT32(fx >> 8) & 0xff;
+    uint32_t wy = UINT32(fy >> 8) & 0xff;
+    int32_t x0 = std::min(std::max(sx, source.src_left), source.src_right);
+    int32_t y0 = std::min(std::max(sy, source.src_top), source.src_bottom);
+    if (!wx && !wy) {
+      source.fetch(planes, x0, y0, out + 4 * i);
+      continue;
+    }
+    int32_t x1 = std::min(std::max(sx + 1, source.src_left), source.src_right);
+    int32_t y1 = std::min(std::max(sy + 1, source.src_top), source.src_bottom);
+    source.fetch(planes, x0, y0, taps[0]);
+    source.fetch(planes, x1, y0, taps[1]);
+    source.fetch(planes, x0, y1, taps[2]);
+    source.fetch(planes, x1, y1, taps[3]);
+    Bilinear(taps[0], taps[1], taps[2], taps[3], wx, wy, out + 4 * i);
+  }
+}
+
+#ifdef SW_COMPOSITOR_NEON
+// Same rounding as Mul255, 8 lanes at a time
+static inline uint8x8_t Mul255(uint8x8_t a, uint8x8_t b) {
+  uint16x8_t t = vaddq_u16(vmull_u8(a, b), vdupq_n_u16(128));
+  return vshrn_n_u16(vaddq_u16(t, vshrq_n_u16(t, 8)), 8);
+}
+#endif
+
+// Converts raw source values to premultiplied RGBA, with the plane alpha applied
+static void PremultiplySpan(LayerBlending blending, uint8_t plane_alpha, int32_t count,
+                            uint8_t *pixels) {
+  if (blending == kBlendingPremultiplied && plane_alpha == 0xff) {
+    return;
+  }
+
+  int32_t i = 0;
+#ifdef SW_COMPOSITOR_NEON
+  uint8x8_t alpha = vdup_n_u8(plane_alpha);
+  for (; i + 8 <= count; i += 8) {
+    uint8x8x4_t p = vld4_u8(pixels + 4 * i);
+    uint8x8_t factor;
+    if (blending == kBlendingCoverage) {
+      factor = Mul255(p.val[3], alpha);
+      p.val[3] = factor;
+    } else if (blending == kBlendingOpaque) {
+      factor = alpha;
+      p.val[3] = alpha;
+    } else {
+      factor = alpha;
+      p.val[3] = Mul255(p.val[3], alpha);
+    }
+    p.val[0] = Mul255(p.val[0], factor);
+    p.val[1] = Mul255(p.val[1], factor);
+    p.val[2] = Mul255(p.val[2], factor);
+    vst4_u8(pixels + 4 * i, p);
+  }
+#endif
+  for (; i < count; i++) {
+    uint8_t *p = pixels + 4 * i;
+    uint8_t factor;
+    if (blending == kBlendingCoverage) {
+      factor = Mul255(p[3], plane_alpha);
+      p[3] = factor;
+    } else if (blending == kBlendingOpaque) {
+      factor = plane_alpha;
+      p[3] = plane_alpha;
+    } else {
+      factor = plane_alpha;
+      p[3] = Mul255(p[3], plane_alpha);
+    }
+    p[0] = Mul255(p[0], factor);
+    p[1] = Mul255(p[1], factor);
+    p[2] = Mul255(p[2], factor);
+  }
+}
+
+// Source over, both premultiplied: dst = src + dst * (1 - src alpha)
+static void BlendSpan(const uint8_t *src, int32_t count, uint8_t *dst) {
+  int32_t i = 0;
+#ifdef SW_COMPOSITOR_NEON
+  for (; i + 8 <= count; i += 8) {
+    uint8x8x4_t s = vld4_u8(src + 4 * i);
+    uint8x8x4_t d = vld4_u8(dst + 4 * i);
+    uint8x8_t inverse = vmvn_u8(s.val[3]);
+    for (int c = 0; c < 4; c++) {
+      d.val[c] = vqadd_u8(s.val[c], Mul255(d.val[c], inverse));
+    }
+    vst4_u8(dst + 4 * i, d);
+  }
+#endif
+  for (; i < count; i++) {
+    const uint8_t *s = src + 4 * i;
+    uint8_t *d = dst + 4 * i;
+    uint32_t inverse = 255u - s[3];
+    for (int c = 0; c < 4; c++) {
+      d[c] = UINT8(std::min(s[c] + Mul255(d[c], inverse), 255));
+    }
+  }
+}
+
+static void WriteRow(const SWComposeJob &job, uint32_t y, const uint8_t *pixels) {
+  uint8_t *row = job.output + y * job.stride;
+  const SWPackedLayout &layout = *job.layout;
+  if (job.layout == &kLayoutRGBA8888) {
+    memcpy(row, pixels, job.width * 4);
+    return;
+  }
+
+  for (uint32_t x = 0; x < job.width; x++) {
+    const uint8_t *p = pixels + 4 * x;
+    uint32_t word = 0;
+    for (uint32_t c = 0; c < 4; c++) {
+      if (layout.bits[c]) {
+        word |= Reduce(p[c], layout.bits[c]) << layout.shift[c];
+      }
+    }
+    for (uint32_t i = 0; i < layout.bytes; i++) {
+      row[x * layout.bytes + i] = UINT8(word >> (8 * i));
+    }
+  }
+}
+
+static bool SetupSource(const Layer &layer, const uint8_t *base, uint32_t out_width,
+                        uint32_t out_height, SWSource *source) {
+  const LayerRect &dst = layer.dst_rect;
+  const LayerRect &src = layer.src_rect;
+  const LayerBuffer &buffer = layer.input_buffer;
+
+  // An output pixel is covered when its centre lies inside the destination rectangle
+  source->dst_left = std::max(INT32(ceilf(dst.left - 0.5f)), 0);
+  source->dst_top = std::max(INT32(ceilf(dst.top - 0.5f)), 0);
+  source->dst_right = std::min(INT32(ceilf(dst.right - 0.5f)), INT32(out_width));
+  source->dst_bottom = std::min(INT32(ceilf(dst.bottom - 0.5f)), INT32(out_height));
+  source->blending = layer.blending;
+  source->plane_alpha = layer.plane_alpha;
+
+  if (layer.flags.solid_fill) {
+    uint32_t color = layer.solid_fill_color;
+    source->solid_fill = true;
+    source->color[0] = UINT8(color >> 16);
+    source->color[1] = UINT8(color >> 8);
+    source->color[2] = UINT8(color);
+    source->color[3] = UINT8(color >> 24);
+    // Solid fill colors carry straight alpha
+    if (source->blending == kBlendingPremultiplied) {
+      source->blending = kBlendingCoverage;
+    }
+    return true;
+  }
+
+  if (!base || !GetPlanes(buffer, base, &source->planes, &source->fetch)) {
+    return false;
+  }
+
+  int32_t buffer_width = INT32(buffer.unaligned_width ? buffer.unaligned_width : buffer.width);
+  int32_t buffer_height = INT32(buffer.unaligned_height ? buffer.unaligned_height :
+                                buffer.height);
+  source->src_left = std::max(INT32(floorf(src.left)), 0);
+  source->src_top = std::max(INT32(floorf(src.top)), 0);
+  source->src_right = std::min(INT32(ceilf(src.right)), buffer_width) - 1;
+  source->src_bottom = std::min(INT32(ceilf(src.bottom)), buffer_height) - 1;
+  if (source->src_right < source->src_left || source->src_bottom < source->src_top) {
+    return false;
+  }
+
+  // 180 is both flips, and 270 is 90 with both flips
+  bool rotate_90 = false;
+  bool flip_h = layer.transform.flip_horizontal;
+  bool flip_v = layer.transform.flip_vertical;
+  int32_t rotation = (INT32(layer.transform.rotation) % 360 + 360) % 360;
+  if (rotation == 90 || rotation == 270) {
+    rotate_90 = true;
+  }
+  if (rotation == 180 || rotation == 270) {
+    flip_h = !flip_h;
+    flip_v = !flip_v;
+  }
+
+  // Undo the rotation first and then the flips, since the transform flips before rotating
+  for (int axis = 0; axis < 2; axis++) {
+    bool driven_by_x = rotate_90 ? (axis == 1) : (axis == 0);
+    bool reverse = (axis == 0) ? flip_h : (flip_v != rotate_90);
+    double dst_start = driven_by_x ? dst.left : dst.top;
+    double dst_size = driven_by_x ? (dst.right - dst.left) : (dst.bottom - dst.top);
+    double src_start = (axis == 0) ? src.left : src.top;
+    double src_size = (axis == 0) ? (src.right - src.left) : (src.bottom - src.top);
+    if (dst_size <= 0 || src_size <= 0) {
+      return false;
+    }
+
+    double scale = src_size / dst_size;
+    double origin = (0.5 - dst_start) * scale;
+    double step = scale;
+    if (reverse) {
+      origin = src_size - origin;
+      step = -scale;
+    }
+    source->origin[axis] = src_start + origin - 0.5;
+    source->step_x[axis] = driven_by_x ? step : 0.0;
+    source->step_y[axis] = driven_by_x ? 0.0 : step;
+  }
+
+  return true;
+}
+
+SWCompositor::SWCompositor(uint32_t num_threads) {
+  if (!num_threads) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = (cpus > 0) ? UINT32(cpus) : 1;
+  }
+
+  num_threads_ = num_threads;
+  scratch_.resize(num_threads_);
+  for (uint32_t i = 1; i < num_threads_; i++) {
+    workers_.push_back(std::thread(&SWCompositor::WorkerThread, this, i));
+  }
+}
+
+SWCompositor::~SWCompositor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    exit_ = true;
+  }
+  job_cv_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+bool SWCompositor::IsInputFormatSupported(LayerBufferFormat format) {
+  LayerBuffer buffer;
+  SWPlanes planes;
+  SWFetchPixel fetch = nullptr;
+  static const uint8_t dummy = 0;
+
+  buffer.format = format;
+  return GetPlanes(buffer, &dummy, &planes, &fetch);
+}
+
+bool SWCompositor::IsOutputFormatSupported(LayerBufferFormat format) {
+  return GetPackedLayout(format) != nullptr;
+}
+
+void SWCompositor::WorkerThread(uint32_t index) {
+  uint64_t job_id = 0;
+
+  while (true) {
+    const SWComposeJob *job = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      job_cv_.wait(lock, [&] { return exit_ || job_id_ != job_id; });
+      if (exit_) {
+        return;
+      }
+      job_id = job_id_;
+      job = job_;
+    }
+
+    ComposeBands(*job, index);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--pending_workers_ == 0) {
+      done_cv_.notify_one();
+    }
+  }
+}
+
+void SWCompositor::ComposeBands(const SWComposeJob &job, uint32_t index) {
+  uint8_t *accumulator = scratch_[index].data();
+  uint8_t *span = accumulator + job.width * 4;
+
+  // Bands are interleaved across threads so that uneven layer coverage evens out
+  for (uint32_t top = index * kBandHeight; top < job.height; top += num_threads_ * kBandHeight) {
+    uint32_t bottom = std::min(top + kBandHeight, job.height);
+    for (uint32_t y = top; y < bottom; y++) {
+      memset(accumulator, 0, job.width * 4);
+      for (const SWSource &source : job.sources) {
+        if (INT32(y) < source.dst_top || INT32(y) >= source.dst_bottom) {
+          continue;
+        }
+        int32_t count = source.dst_right - source.dst_left;
+        FetchSpan(source, source.dst_left, INT32(y), count, span);
+        PremultiplySpan(source.blending, source.plane_alpha, count, span);
+        BlendSpan(span, count, accumulator + 4 * source.dst_left);
+      }
+      WriteRow(job, y, accumulator);
+    }
+  }
+}
+
+DisplayError SWCompositor::Compose(const std::vector<Layer *> &layers,
+                                   const std::vector<uint8_t *> &bases,
+                                   const LayerBuffer &output, uint8_t *output_base) {
+  SWComposeJob job;
+
+  job.layout = GetPackedLayout(output.format);
+  if (!job.layout || GetBufferLayout(output.format) != kLinear || !output_base ||
+      bases.size() != layers.size()) {
+    DLOGE("Unsupported output format %s", GetFormatString(output.format));
+    return kErrorNotSupported;
+  }
+
+  job.width = output.unaligned_width ? output.unaligned_width : output.width;
+  job.height = output.unaligned_height ? output.unaligned_height : output.height;
+  job.stride = (output.planes[0].stride ? output.planes[0].stride : output.width) *
+               job.layout->bytes;
+  job.output = output_base + output.planes[0].offset;
+
+  job.sources.reserve(layers.size());
+  for (size_t i = 0; i < layers.size(); i++) {
+    SWSource source;
+    if (!SetupSource(*layers[i], bases[i], job.width, job.height, &source)) {
+      DLOGE("Layer %zu with format %s cannot be composed", i,
+            GetFormatString(layers[i]->input_buffer.format));
+      return kErrorNotSupported;
+    }
+    if (source.dst_left < source.dst_right && source.dst_top < source.dst_bottom) {
+      job.sources.push_back(source);
+    }
+  }
+
+  for (auto &scratch : scratch_) {
+    scratch.resize(job.width * 8);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job_ = &job;
+    job_id_++;
+    pending_workers_ = UINT32(workers_.size());
+  }
+  job_cv_.notify_all();
+
+  ComposeBands(job, 0);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [&] { return pending_workers_ == 0; });
+  job_ = nullptr;
+
+  return kErrorNone;
+}
+
+DisplayError SWCompositor::Compose(const std::vector<Layer *> &layers, LayerBuffer *output) {
+  std::vector<uint8_t *> bases(layers.size(), nullptr);
+  DisplayError error = kErrorNone;
+
+  void *output_base = mmap(NULL, output->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                           output->planes[0].fd, 0);
+  if (output_base == MAP_FAILED) {
+    DLOGE("Output buffer map failed. fd = %d, size = %d", output->planes[0].fd, output->size);
+    return kErrorMemory;
+  }
+
+  for (size_t i = 0; i < layers.size() && error == kErrorNone; i++) {
+    const LayerBuffer &buffer = layers[i]->input_buffer;
+    if (layers[i]->flags.solid_fill) {
+      continue;
+    }
+    if (buffer.flags.secure) {
+      DLOGE("Layer %zu is secure", i);
+      error = kErrorNotSupported;
+      break;
+    }
+    void *base = mmap(NULL, buffer.size, PROT_READ, MAP_SHARED, buffer.planes[0].fd, 0);
+    if (base == MAP_FAILED) {
+      DLOGE("Layer %zu map failed. fd = %d, size = %d", i, buffer.planes[0].fd, buffer.size);
+      error = kErrorMemory;
+      break;
+    }
+    bases[i] = reinterpret_cast<uint8_t *>(base);
+  }
+
+  if (error == kErrorNone) {
+    error = Compose(layers, bases, *output, reinterpret_cast<uint8_t *>(output_base));
+  }
+
+  for (size_t i = 0; i < layers.size(); i++) {
+    if (bases[i]) {
+      munmap(bases[i], layers[i]->input_buffer.size);
+    }
+  }
+  munmap(output_base, output->size);
+
+  return error;
+}
+
+}  // namespace sdm